@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+#include "snippets-index.h"
+#include "snippets-config.h"
+#include "snippets-template.h"
+#include "snippets-text.h"
+
+/*
+ * Runs the expansion hot path the engine takes on every tab press: the
+ * word before the cursor is read out of the buffer, the index is asked
+ * for the snippets of that trigger and the first one is rendered. Once
+ * the scratch strings and arrays have grown to size none of that should
+ * allocate, and the run fails when it does.
+ */
+
+#define BENCH_CONFIGS 2000
+#define BENCH_ROUNDS 100000
+#define BENCH_FILE_PATH "/tmp/bench.c"
+
+static void  add_configs  (SnippetsIndex *index,
+                           GPtrArray     *configs);
+
+static gboolean counting = FALSE;
+static guint allocations = 0;
+
+#ifdef __GLIBC__
+
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void*
+malloc (size_t size)
+{
+  if (counting)
+    allocations++;
+  return __libc_malloc (size);
+}
+
+void*
+calloc (size_t nmemb,
+        size_t size)
+{
+  if (counting)
+    allocations++;
+  return __libc_calloc (nmemb, size);
+}
+
+void*
+realloc (void   *ptr,
+         size_t  size)
+{
+  if (counting)
+    allocations++;
+  return __libc_realloc (ptr, size);
+}
+
+#endif
+
+int
+main (int   argc,
+      char *argv[])
+{
+  SnippetsIndex *index;
+  GPtrArray *configs;
+  SnippetsTemplateContext context;
+  GtkTextBuffer *buffer;
+  GtkTextIter start;
+  GtkTextIter end;
+  GPtrArray *found;
+  GArray *placeholders;
+  GString *word;
+  GString *scratch;
+  GString *output;
+  GTimer *timer;
+  guint i;
+
+  g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+#ifndef __GLIBC__
+  g_warning ("allocations are only counted against glibc\n");
+#endif
+
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+  g_type_init ();
+#endif
+
+  index = snippets_index_new ();
+  configs = g_ptr_array_new_with_free_func (g_object_unref);
+  add_configs (index, configs);
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, "int main (void)\n{\n  for", -1);
+
+  found = g_ptr_array_new ();
+  placeholders = g_array_new (FALSE, FALSE, sizeof (SnippetsPlaceholder));
+  word = g_string_sized_new (64);
+  scratch = g_string_sized_new (256);
+  output = g_string_sized_new (256);
+
+  context.file_path = BENCH_FILE_PATH;
+  context.matches = NULL;
+  context.selection = NULL;
+  context.cache = NULL;
+  context.commands = NULL;
+
+  timer = g_timer_new ();
+
+  for (i = 0; i <= BENCH_ROUNDS; i++)
+    {
+      SnippetsConfig *config;
+
+      /* the first round only grows the scratch space */
+      counting = i > 0;
+      if (i == 1)
+        g_timer_start (timer);
+
+      gtk_text_buffer_get_end_iter (buffer, &end);
+      start = end;
+      snippets_text_move_word_start (&start);
+      snippets_text_copy (&start, &end, word);
+
+      g_ptr_array_set_size (found, 0);
+      snippets_index_lookup_all (index, word->str, BENCH_FILE_PATH, found);
+      if (found->len == 0)
+        {
+          counting = FALSE;
+          g_printerr ("no snippet found for %s\n", word->str);
+          return 1;
+        }
+
+      config = g_ptr_array_index (found, 0);
+      g_array_set_size (placeholders, 0);
+      snippets_template_render_to (snippets_config_get_expansion (config, scratch),
+                                   &context, placeholders, output);
+    }
+
+  counting = FALSE;
+  g_timer_stop (timer);
+
+  g_print ("%d expansions in %.3f s, %u allocations\n", BENCH_ROUNDS,
+           g_timer_elapsed (timer, NULL), allocations);
+
+  g_timer_destroy (timer);
+  g_string_free (output, TRUE);
+  g_string_free (scratch, TRUE);
+  g_string_free (word, TRUE);
+  g_array_free (placeholders, TRUE);
+  g_ptr_array_free (found, TRUE);
+  g_object_unref (buffer);
+  g_object_unref (index);
+  g_ptr_array_free (configs, TRUE);
+
+  return allocations > 0 ? 1 : 0;
+}
+
+/*
+ * Fills the index with snippets spread over a handful of languages, the
+ * one that is looked up among them. The index does not hold a reference
+ * so the configs are kept alive in the array.
+ */
+static void
+add_configs (SnippetsIndex *index,
+             GPtrArray     *configs)
+{
+  const gchar *file_types[] = {".c,.h", ".py", ".java", ".js", ".rb"};
+  gchar *trigger;
+  gchar *text;
+  gint i;
+
+  for (i = 0; i < BENCH_CONFIGS; i++)
+    {
+      SnippetsConfig *config;
+
+      if (i == BENCH_CONFIGS / 2)
+        {
+          trigger = g_strdup ("for");
+          text = g_strdup ("for (${1:i} = 0; $1 < ${2:n}; $1++)\n  {\n    $0\n  }");
+        }
+      else
+        {
+          trigger = g_strdup_printf ("snippet%d", i);
+          text = g_strdup_printf ("${1:value%d} = ${2:other};$0", i);
+        }
+
+      config = snippets_config_new ();
+      snippets_config_set_file_types (config, file_types[i % G_N_ELEMENTS (file_types)]);
+      snippets_config_set_trigger (config, trigger);
+      snippets_config_set_text (config, text);
+      snippets_index_add (index, config);
+      g_ptr_array_add (configs, config);
+
+      g_free (trigger);
+      g_free (text);
+    }
+}
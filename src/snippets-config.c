@@ -16,8 +16,12 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+#include <gio/gio.h>
 #include "snippets-config.h"
 
+#define COMPRESS_THRESHOLD 16384
+
 static void snippets_config_class_init    (SnippetsConfigClass *klass);
 static void snippets_config_init          (SnippetsConfig      *config);
 static void snippets_config_finalize      (SnippetsConfig      *config);
@@ -29,6 +33,15 @@ static void snippets_config_set_property  (GObject             *object,
                                            guint                prop_id,
                                            const GValue        *value,
                                            GParamSpec          *pspec);
+static gpointer body_ref                  (const gchar         *text);
+static gpointer body_share                (gpointer             body);
+static void body_unref                    (gpointer             body);
+static GBytes* body_deflate               (const gchar         *text,
+                                           gsize                length);
+static void body_inflate                  (GBytes              *compressed,
+                                           gsize                length,
+                                           GString             *scratch);
+static guint64 new_id                     (void);
 
 #define SNIPPETS_CONFIG_GET_PRIVATE(obj) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_CONFIG_TYPE, SnippetsConfigPrivate))
@@ -38,9 +51,18 @@ typedef struct _SnippetsConfigPrivate SnippetsConfigPrivate;
 struct _SnippetsConfigPrivate
 {
   gchar *file_types;
+  SnippetsFileTypeSet *file_type_set;
   gchar *name;
   gchar *trigger;
-  gchar *text;
+  gpointer body;
+  gchar *contexts;
+  gboolean pattern;
+  gchar *expansion;
+  GPtrArray *extras;
+  SnippetsCounters counters;
+  guint64 id;
+  guint revision;
+  guint expansions;
 };
 
 enum
@@ -49,9 +71,33 @@ enum
   PROP_FILE_TYPES,
   PROP_NAME,
   PROP_TRIGGER,
-  PROP_TEXT
+  PROP_TEXT,
+  PROP_CONTEXTS,
+  PROP_PATTERN
 };
 
+/*
+ * The text of every config is kept once per distinct body and shared by
+ * reference, large libraries tend to repeat the same body under a
+ * number of file types. Bodies past the threshold are looked up by their
+ * digest rather than their text and kept deflated.
+ */
+typedef struct
+{
+  gchar  *key;
+  gchar  *digest;
+  gchar  *text;
+  GBytes *compressed;
+  gsize   length;
+  guint   ref_count;
+} Body;
+
+static GHashTable *bodies = NULL;
+static GHashTable *digests = NULL;
+static guint compressed_count = 0;
+static gsize compressed_saved = 0;
+G_LOCK_DEFINE_STATIC (bodies);
+
 G_DEFINE_TYPE (SnippetsConfig, snippets_config, G_TYPE_OBJECT)
      
 static void 
@@ -97,6 +143,22 @@ snippets_config_class_init (SnippetsConfigClass *klass)
                                                         "Text",
                                                         "",
                                                         G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, 
+                                   PROP_CONTEXTS,
+                                   g_param_spec_string ("contexts",
+                                                        "Contexts",
+                                                        "Contexts",
+                                                        "",
+                                                        G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, 
+                                   PROP_PATTERN,
+                                   g_param_spec_boolean ("pattern",
+                                                         "Pattern",
+                                                         "Pattern",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE));
 }
 
 static void
@@ -107,6 +169,8 @@ snippets_config_init (SnippetsConfig *config)
   priv->file_types = NULL;
   priv->name = NULL;
   priv->trigger = NULL;
+  priv->pattern = FALSE;
+  priv->id = new_id ();
 }
 
 static void
@@ -119,6 +183,11 @@ snippets_config_finalize (SnippetsConfig *config)
       g_free (priv->file_types);
       priv->file_types = NULL;
     }
+  if (priv->file_type_set)
+    {
+      snippets_file_types_free (priv->file_type_set);
+      priv->file_type_set = NULL;
+    }
   if (priv->name)
     {
       g_free (priv->name);
@@ -129,10 +198,25 @@ snippets_config_finalize (SnippetsConfig *config)
       g_free (priv->trigger);
       priv->trigger = NULL;
     }
-  if (priv->text)
+  if (priv->body)
     {
-      g_free (priv->text);
-      priv->text = NULL;
+      body_unref (priv->body);
+      priv->body = NULL;
+    }
+  if (priv->contexts)
+    {
+      g_free (priv->contexts);
+      priv->contexts = NULL;
+    }
+  if (priv->expansion)
+    {
+      g_free (priv->expansion);
+      priv->expansion = NULL;
+    }
+  if (priv->extras)
+    {
+      g_ptr_array_free (priv->extras, TRUE);
+      priv->extras = NULL;
     }
   G_OBJECT_CLASS (snippets_config_parent_class)->finalize (G_OBJECT (config));
 }
@@ -145,7 +229,7 @@ snippets_config_get_property (GObject    *object,
 {
   SnippetsConfig *config;
   SnippetsConfigPrivate *priv;
-  
+
   config = SNIPPETS_CONFIG (object);
   priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
 
@@ -161,7 +245,17 @@ snippets_config_get_property (GObject    *object,
       g_value_set_string (value, priv->trigger);
       break;
     case PROP_TEXT:
-      g_value_set_string (value, priv->text);
+      {
+        GString *scratch = g_string_new (NULL);
+        g_value_set_string (value, snippets_config_get_text (config, scratch));
+        g_string_free (scratch, TRUE);
+      }
+      break;
+    case PROP_CONTEXTS:
+      g_value_set_string (value, priv->contexts);
+      break;
+    case PROP_PATTERN:
+      g_value_set_boolean (value, priv->pattern);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -192,6 +286,12 @@ snippets_config_set_property (GObject      *object,
     case PROP_TEXT:
       snippets_config_set_text (config, g_value_get_string (value));
       break;
+    case PROP_CONTEXTS:
+      snippets_config_set_contexts (config, g_value_get_string (value));
+      break;
+    case PROP_PATTERN:
+      snippets_config_set_pattern (config, g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -204,6 +304,89 @@ snippets_config_new (void)
   return SNIPPETS_CONFIG (g_object_new (snippets_config_get_type (), NULL));
 }
 
+/*
+ * A copy of everything that is saved, the text is shared with the
+ * original rather than looked up again. The copy keeps the id and the
+ * revision of the original until it is changed.
+ */
+SnippetsConfig*
+snippets_config_copy (SnippetsConfig *config)
+{
+  SnippetsConfigPrivate *priv;
+  SnippetsConfigPrivate *copy_priv;
+  SnippetsConfig *copy;
+  guint i;
+
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+
+  copy = snippets_config_new ();
+  copy_priv = SNIPPETS_CONFIG_GET_PRIVATE (copy);
+
+  copy_priv->file_types = g_strdup (priv->file_types);
+  if (priv->file_type_set != NULL)
+    copy_priv->file_type_set = snippets_file_types_copy (priv->file_type_set);
+  copy_priv->name = g_strdup (priv->name);
+  copy_priv->trigger = g_strdup (priv->trigger);
+  copy_priv->contexts = g_strdup (priv->contexts);
+  copy_priv->pattern = priv->pattern;
+  copy_priv->counters = priv->counters;
+  copy_priv->id = priv->id;
+
+  if (priv->body != NULL)
+    copy_priv->body = body_share (priv->body);
+
+  for (i = 0; priv->extras != NULL && i + 1 < priv->extras->len; i += 2)
+    snippets_config_add_extra (copy, g_ptr_array_index (priv->extras, i), 
+                               g_ptr_array_index (priv->extras, i + 1));
+
+  copy_priv->revision = priv->revision;
+
+  return copy;
+}
+
+/*
+ * The id is saved with the snippet and stays the same for as long as
+ * the snippet exists, it also tells which config a copy was taken from.
+ * A new snippet gets a random id, so that snippets from different
+ * libraries hardly ever clash. The revision goes up with every change
+ * to what is saved.
+ */
+guint64
+snippets_config_get_id (SnippetsConfig *config)
+{
+  return SNIPPETS_CONFIG_GET_PRIVATE (config)->id;
+}
+
+/*
+ * Points at the id kept in the config, for tables keyed on the id that
+ * would rather not copy it. The id must not change while it is a key.
+ */
+const guint64*
+snippets_config_peek_id (SnippetsConfig *config)
+{
+  return &SNIPPETS_CONFIG_GET_PRIVATE (config)->id;
+}
+
+void
+snippets_config_set_id (SnippetsConfig *config,
+                        guint64         id)
+{
+  if (id != 0)
+    SNIPPETS_CONFIG_GET_PRIVATE (config)->id = id;
+}
+
+void
+snippets_config_renew_id (SnippetsConfig *config)
+{
+  SNIPPETS_CONFIG_GET_PRIVATE (config)->id = new_id ();
+}
+
+guint
+snippets_config_get_revision (SnippetsConfig *config)
+{
+  return SNIPPETS_CONFIG_GET_PRIVATE (config)->revision;
+}
+
 const gchar*
 snippets_config_get_file_types (SnippetsConfig *config)
 {
@@ -221,7 +404,27 @@ snippets_config_set_file_types (SnippetsConfig *config,
       g_free (priv->file_types);
       priv->file_types = NULL;
     }
+  if (priv->file_type_set)
+    {
+      snippets_file_types_free (priv->file_type_set);
+      priv->file_type_set = NULL;
+    }
   priv->file_types = g_strdup (file_types);
+  priv->file_type_set = snippets_file_types_intern (file_types);
+  priv->revision++;
+}
+
+/*
+ * The file types as bits, worked out whenever they are set.
+ */
+const SnippetsFileTypeSet*
+snippets_config_get_file_type_set (SnippetsConfig *config)
+{
+  SnippetsConfigPrivate *priv;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  if (priv->file_type_set == NULL)
+    priv->file_type_set = snippets_file_types_intern (NULL);
+  return priv->file_type_set;
 }
 
 const gchar*
@@ -242,6 +445,7 @@ snippets_config_set_name (SnippetsConfig *config,
       priv->name = NULL;
     }
   priv->name = g_strdup (name);
+  priv->revision++;
 }
 
 const gchar*
@@ -262,24 +466,400 @@ snippets_config_set_trigger (SnippetsConfig *config,
       priv->trigger = NULL;
     }
   priv->trigger = g_strdup (trigger);
+  priv->revision++;
 }
 
+/*
+ * A large body is only kept deflated, so its text is inflated into the
+ * scratch buffer of the caller and stays good until the buffer is used
+ * again. Anything else comes back as is and the scratch is left alone.
+ */
 const gchar*
-snippets_config_get_text (SnippetsConfig *config)
+snippets_config_get_text (SnippetsConfig *config,
+                          GString        *scratch)
 {
-  return SNIPPETS_CONFIG_GET_PRIVATE (config)->text;
+  Body *body;
+
+  body = SNIPPETS_CONFIG_GET_PRIVATE (config)->body;
+  if (body == NULL)
+    return NULL;
+
+  if (body->text != NULL)
+    return body->text;
+
+  body_inflate (body->compressed, body->length, scratch);
+  return scratch->str;
 }
 
 void
 snippets_config_set_text (SnippetsConfig *config,
                           const gchar    *text)
+{
+  SnippetsConfigPrivate *priv;
+  gpointer body = NULL;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  if (text != NULL)
+    body = body_ref (text);
+  if (priv->body)
+    {
+      body_unref (priv->body);
+      priv->body = NULL;
+    }
+  priv->body = body;
+  priv->revision++;
+}
+
+/*
+ * The SHA-256 of the text, shared by every config with the same text.
+ * Large bodies are looked up by it anyway, for the rest it is worked out
+ * the first time it is asked for.
+ */
+const gchar*
+snippets_config_get_digest (SnippetsConfig *config)
+{
+  Body *body;
+  const gchar *digest;
+
+  body = SNIPPETS_CONFIG_GET_PRIVATE (config)->body;
+  if (body == NULL)
+    return NULL;
+
+  G_LOCK (bodies);
+  if (body->digest == NULL)
+    body->digest = g_compute_checksum_for_string (G_CHECKSUM_SHA256, 
+                                                  body->text, body->length);
+  digest = body->digest;
+  G_UNLOCK (bodies);
+
+  return digest;
+}
+
+/*
+ * How often the snippet expanded and how much text that put in, kept
+ * for as long as the editor runs and carried over to copies.
+ */
+SnippetsCounters*
+snippets_config_get_counters (SnippetsConfig *config)
+{
+  return &SNIPPETS_CONFIG_GET_PRIVATE (config)->counters;
+}
+
+/*
+ * How many bodies are kept deflated and the bytes that saves over
+ * keeping their text.
+ */
+void
+snippets_config_get_compression (guint *count,
+                                 gsize *saved)
+{
+  G_LOCK (bodies);
+  *count = compressed_count;
+  *saved = compressed_saved;
+  G_UNLOCK (bodies);
+}
+
+static gpointer
+body_ref (const gchar *text)
+{
+  Body *body;
+  gchar *digest = NULL;
+  gsize length;
+
+  length = strlen (text);
+  if (length > COMPRESS_THRESHOLD)
+    digest = g_compute_checksum_for_string (G_CHECKSUM_SHA256, text, length);
+
+  G_LOCK (bodies);
+
+  if (bodies == NULL)
+    {
+      bodies = g_hash_table_new (g_str_hash, g_str_equal);
+      digests = g_hash_table_new (g_str_hash, g_str_equal);
+    }
+
+  if (digest != NULL)
+    body = g_hash_table_lookup (digests, digest);
+  else
+    body = g_hash_table_lookup (bodies, text);
+
+  if (body == NULL)
+    {
+      body = g_slice_new0 (Body);
+      body->length = length;
+
+      if (digest != NULL)
+        {
+          body->key = digest;
+          body->digest = digest;
+          body->compressed = body_deflate (text, length);
+          digest = NULL;
+        }
+
+      /* text that does not deflate well is kept as it is */
+      if (body->compressed != NULL && g_bytes_get_size (body->compressed) < length)
+        {
+          compressed_count++;
+          compressed_saved += length - g_bytes_get_size (body->compressed);
+        }
+      else
+        {
+          if (body->compressed != NULL)
+            g_bytes_unref (body->compressed);
+          body->compressed = NULL;
+          body->text = g_strdup (text);
+        }
+
+      if (body->key != NULL)
+        {
+          g_hash_table_insert (digests, body->key, body);
+        }
+      else
+        {
+          body->key = body->text;
+          g_hash_table_insert (bodies, body->key, body);
+        }
+    }
+  body->ref_count++;
+
+  G_UNLOCK (bodies);
+
+  g_free (digest);
+
+  return body;
+}
+
+static gpointer
+body_share (gpointer data)
+{
+  Body *body = data;
+  G_LOCK (bodies);
+  body->ref_count++;
+  G_UNLOCK (bodies);
+  return body;
+}
+
+static void
+body_unref (gpointer data)
+{
+  Body *body = data;
+
+  G_LOCK (bodies);
+
+  if (--body->ref_count == 0)
+    {
+      if (body->length > COMPRESS_THRESHOLD)
+        {
+          g_hash_table_remove (digests, body->key);
+          g_free (body->key);
+        }
+      else
+        {
+          g_hash_table_remove (bodies, body->key);
+          g_free (body->digest);
+        }
+
+      if (body->compressed != NULL)
+        {
+          compressed_count--;
+          compressed_saved -= body->length - g_bytes_get_size (body->compressed);
+          g_bytes_unref (body->compressed);
+        }
+
+      g_free (body->text);
+      g_slice_free (Body, body);
+    }
+
+  G_UNLOCK (bodies);
+}
+
+static GBytes*
+body_deflate (const gchar *text,
+              gsize        length)
+{
+  GZlibCompressor *compressor;
+  GOutputStream *memory;
+  GOutputStream *stream;
+  GBytes *bytes = NULL;
+
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1);
+  memory = g_memory_output_stream_new_resizable ();
+  stream = g_converter_output_stream_new (memory, G_CONVERTER (compressor));
+
+  if (g_output_stream_write_all (stream, text, length, NULL, NULL, NULL) &&
+      g_output_stream_close (stream, NULL, NULL))
+    bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (memory));
+
+  g_object_unref (stream);
+  g_object_unref (memory);
+  g_object_unref (compressor);
+
+  return bytes;
+}
+
+static void
+body_inflate (GBytes  *compressed,
+              gsize    length,
+              GString *scratch)
+{
+  GZlibDecompressor *decompressor;
+  GConverterResult result;
+  const gchar *input;
+  gsize input_length;
+  gsize total = 0;
+  gsize bytes_read;
+  gsize bytes_written;
+
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW);
+  input = g_bytes_get_data (compressed, &input_length);
+
+  /* the size is known up front, the room for the nul keeps the last call from running dry */
+  g_string_set_size (scratch, length);
+
+  do
+    {
+      result = g_converter_convert (G_CONVERTER (decompressor), 
+                                    input, input_length,
+                                    scratch->str + total, length + 1 - total,
+                                    G_CONVERTER_INPUT_AT_END, 
+                                    &bytes_read, &bytes_written, NULL);
+      input += bytes_read;
+      input_length -= bytes_read;
+      total += bytes_written;
+    }
+  while (result == G_CONVERTER_CONVERTED && total <= length);
+
+  if (result != G_CONVERTER_FINISHED || total != length)
+    {
+      g_warning ("could not inflate snippet text\n");
+      total = MIN (total, length);
+    }
+
+  g_string_set_size (scratch, total);
+
+  g_object_unref (decompressor);
+}
+
+/*
+ * A comma separated list of the source view context classes the snippet
+ * expands in, such as "comment", or is kept out of, such as "!string".
+ */
+const gchar*
+snippets_config_get_contexts (SnippetsConfig *config)
+{
+  return SNIPPETS_CONFIG_GET_PRIVATE (config)->contexts;
+}
+
+void
+snippets_config_set_contexts (SnippetsConfig *config,
+                              const gchar    *contexts)
 {
   SnippetsConfigPrivate *priv;
   priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
-  if (priv->text)
+  if (priv->contexts)
     {
-      g_free (priv->text);
-      priv->text = NULL;
+      g_free (priv->contexts);
+      priv->contexts = NULL;
     }
-  priv->text = g_strdup (text);
+  priv->contexts = g_strdup (contexts);
+  priv->revision++;
+}
+
+/*
+ * A pattern trigger is a regular expression matched against the text in
+ * front of the cursor, its groups can be used in the text as ${match:N}.
+ */
+gboolean
+snippets_config_get_pattern (SnippetsConfig *config)
+{
+  return SNIPPETS_CONFIG_GET_PRIVATE (config)->pattern;
+}
+
+void
+snippets_config_set_pattern (SnippetsConfig *config,
+                             gboolean        pattern)
+{
+  SnippetsConfigPrivate *priv;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  priv->pattern = pattern;
+  priv->revision++;
+}
+
+/*
+ * The text with the snippets it includes already put in place. It is
+ * worked out when the library is loaded and never saved, a snippet that
+ * includes nothing just expands to its text.
+ */
+const gchar*
+snippets_config_get_expansion (SnippetsConfig *config,
+                               GString        *scratch)
+{
+  SnippetsConfigPrivate *priv;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  if (priv->expansion != NULL)
+    return priv->expansion;
+  return snippets_config_get_text (config, scratch);
+}
+
+void
+snippets_config_set_expansion (SnippetsConfig *config,
+                               const gchar    *expansion)
+{
+  SnippetsConfigPrivate *priv;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  if (priv->expansion)
+    {
+      g_free (priv->expansion);
+      priv->expansion = NULL;
+    }
+  priv->expansion = g_strdup (expansion);
+  priv->expansions++;
+}
+
+/*
+ * Goes up whenever what the config expands to may have changed, either
+ * through its own text or through a snippet it includes.
+ */
+guint
+snippets_config_get_expansion_stamp (SnippetsConfig *config)
+{
+  SnippetsConfigPrivate *priv;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  return priv->revision + priv->expansions;
+}
+
+/*
+ * The attributes of a snippet that this version knows nothing about,
+ * names and values taking turns. They are kept so that saving a library
+ * written by a newer version does not lose them.
+ */
+const GPtrArray*
+snippets_config_get_extras (SnippetsConfig *config)
+{
+  return SNIPPETS_CONFIG_GET_PRIVATE (config)->extras;
+}
+
+void
+snippets_config_add_extra (SnippetsConfig *config,
+                           const gchar    *name,
+                           const gchar    *value)
+{
+  SnippetsConfigPrivate *priv;
+  priv = SNIPPETS_CONFIG_GET_PRIVATE (config);
+  if (priv->extras == NULL)
+    priv->extras = g_ptr_array_new_with_free_func (g_free);
+  g_ptr_array_add (priv->extras, g_strdup (name));
+  g_ptr_array_add (priv->extras, g_strdup (value));
+  priv->revision++;
+}
+
+static guint64
+new_id (void)
+{
+  guint64 id;
+
+  do
+    id = (guint64) g_random_int () << 32 | g_random_int ();
+  while (id == 0);
+
+  return id;
 }
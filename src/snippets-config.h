@@ -20,6 +20,7 @@
 #define	__SNIPPETS_CONFIG_H__
 
 #include <gtk/gtk.h>
+#include "snippets-file-types.h"
 
 G_BEGIN_DECLS
 
@@ -31,6 +32,7 @@ G_BEGIN_DECLS
 
 typedef struct _SnippetsConfig SnippetsConfig;
 typedef struct _SnippetsConfigClass SnippetsConfigClass;
+typedef struct _SnippetsCounters SnippetsCounters;
 
 struct _SnippetsConfig
 {
@@ -42,22 +44,58 @@ struct _SnippetsConfigClass
   GObjectClass parent_class;
 };
 
+struct _SnippetsCounters
+{
+  volatile gint  expansions;
+  volatile gint  misses;
+  volatile gsize inserted;
+};
+
 GType snippets_config_get_type (void) G_GNUC_CONST;
 
 SnippetsConfig*  snippets_config_new             (void);
+SnippetsConfig*  snippets_config_copy            (SnippetsConfig *config);
+
+guint64          snippets_config_get_id          (SnippetsConfig *config);
+const guint64*   snippets_config_peek_id         (SnippetsConfig *config);
+void             snippets_config_set_id          (SnippetsConfig *config,
+                                                  guint64         id);
+void             snippets_config_renew_id        (SnippetsConfig *config);
+guint            snippets_config_get_revision    (SnippetsConfig *config);
 
 const gchar*     snippets_config_get_file_types  (SnippetsConfig *config);
 void             snippets_config_set_file_types  (SnippetsConfig *config,
                                                   const gchar    *file_types);
+const SnippetsFileTypeSet* snippets_config_get_file_type_set (SnippetsConfig *config);
 const gchar*     snippets_config_get_name        (SnippetsConfig *config);
 void             snippets_config_set_name        (SnippetsConfig *config,
                                                   const gchar    *name);
 const gchar*     snippets_config_get_trigger     (SnippetsConfig *config);
 void             snippets_config_set_trigger     (SnippetsConfig *config,
                                                   const gchar    *trigger);
-const gchar*     snippets_config_get_text        (SnippetsConfig *config);
+const gchar*     snippets_config_get_text        (SnippetsConfig *config,
+                                                  GString        *scratch);
 void             snippets_config_set_text        (SnippetsConfig *config,
                                                   const gchar    *text);
+const gchar*     snippets_config_get_digest      (SnippetsConfig *config);
+const gchar*     snippets_config_get_contexts    (SnippetsConfig *config);
+void             snippets_config_set_contexts    (SnippetsConfig *config,
+                                                  const gchar    *contexts);
+gboolean         snippets_config_get_pattern     (SnippetsConfig *config);
+void             snippets_config_set_pattern     (SnippetsConfig *config,
+                                                  gboolean        pattern);
+const gchar*     snippets_config_get_expansion   (SnippetsConfig *config,
+                                                  GString        *scratch);
+void             snippets_config_set_expansion   (SnippetsConfig *config,
+                                                  const gchar    *expansion);
+guint            snippets_config_get_expansion_stamp (SnippetsConfig *config);
+const GPtrArray* snippets_config_get_extras      (SnippetsConfig *config);
+void             snippets_config_add_extra       (SnippetsConfig *config,
+                                                  const gchar    *name,
+                                                  const gchar    *value);
+SnippetsCounters* snippets_config_get_counters   (SnippetsConfig *config);
+void             snippets_config_get_compression (guint          *count,
+                                                  gsize          *saved);
 
 G_END_DECLS
 
@@ -18,6 +18,13 @@
 
 #include "snippets-dialog.h"
 #include "snippets-config.h"
+#include "snippets-model.h"
+#include "snippets-search.h"
+#include "snippets-index.h"
+
+#define SEARCH_CHUNK 500
+#define SEARCH_EXPAND_LIMIT 100
+#define SEARCH_REBUILD_LIMIT 2000
 
 static void snippets_dialog_class_init  (SnippetsDialogClass *klass);
 static void snippets_dialog_init        (SnippetsDialog      *dialog);
@@ -30,10 +37,22 @@ static void add_file_types_pane         (SnippetsDialog      *dialog,
 static void add_syntax_pane             (SnippetsDialog      *dialog,
                                          GtkWidget           *hpaned);                                         
 static void load_configs                (SnippetsDialog      *dialog);                                         
+static void fill_model                  (SnippetsDialog      *dialog,
+                                         GHashTable          *matches);
+static void search_action               (SnippetsDialog      *dialog);
+static void update_model                (SnippetsDialog      *dialog,
+                                         GHashTable          *matches);
+static gboolean index_search_action     (SnippetsDialog      *dialog);
+static SnippetsSearch* get_search       (SnippetsDialog      *dialog);
+static SnippetsIndex* get_index         (SnippetsDialog      *dialog);
+static void config_changed              (SnippetsDialog      *dialog,
+                                         SnippetsConfig      *config);
+static void show_conflicts              (SnippetsDialog      *dialog,
+                                         SnippetsConfig      *config);
 static void tree_add_action             (SnippetsDialog      *dialog);
 static void tree_remove_action          (SnippetsDialog      *dialog);
-static void tree_edited_action          (SnippetsDialog      *dialog, 
-                                         gchar               *tree_path, 
+static void tree_edited_action          (SnippetsDialog      *dialog, 
+                                         gchar               *tree_path, 
                                          gchar               *file_types);                                         
 static void create_popup_menu           (SnippetsDialog      *dialog);
 static gboolean show_popup_menu         (SnippetsDialog      *dialog, 
@@ -45,12 +64,14 @@ static void select_row_action           (GtkTreeSelection     *selection,
                                          SnippetsDialog       *dialog);                                         
 static void trigger_entry_action        (SnippetsDialog       *dialog,
                                          GParamSpec           *spec);                                         
+static void contexts_entry_action       (SnippetsDialog       *dialog,
+                                         GParamSpec           *spec);
+static void pattern_button_action       (SnippetsDialog       *dialog);
 static void text_view_action            (SnippetsDialog       *dialog,
                                          GParamSpec           *spec);                                         
-static gint sort_compare                (GtkTreeModel         *model, 
-                                         GtkTreeIter          *a,
-                                         GtkTreeIter          *b, 
-                                         gpointer              userdata);                                         
+static void commit_text                 (SnippetsDialog       *dialog);
+static void remove_config               (SnippetsDialog       *dialog,
+                                         SnippetsConfig       *config);
 
 #define SNIPPETS_DIALOG_GET_PRIVATE(obj) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_DIALOG_TYPE, SnippetsDialogPrivate))
@@ -62,26 +83,37 @@ struct _SnippetsDialogPrivate
   CodeSlayer         *codeslayer;
   CodeSlayerRegistry *registry;
   GtkWidget          *tree;
-  GtkTreeStore       *store;
+  SnippetsModel      *model;
+  GtkWidget          *search_entry;
+  SnippetsSearch     *search;
+  GHashTable         *matches;
+  GList              *search_next;
+  guint               search_id;
+  SnippetsIndex      *index;
   GList              **configs;
+  GHashTable         *links;
+  GList              *last_link;
+  GPtrArray          *changed;
+  GHashTable         *changes;
+  GArray             *removed;
   GtkWidget          *trigger_entry;
+  GtkWidget          *contexts_entry;
+  GtkWidget          *pattern_button;
+  GtkWidget          *conflicts_label;
   GtkWidget          *text_view;
+  SnippetsConfig     *text_config;
+  gboolean            text_dirty;
 
   gulong              text_buffer_id;
   gulong              trigger_entry_id;
+  gulong              contexts_entry_id;
+  gulong              pattern_button_id;
 
   GtkWidget          *menu;
   GtkWidget          *add_item;
   GtkWidget          *remove_item;
 };
 
-enum
-{
-  TEXT = 0,
-  CONFIGURATION,
-  COLUMNS
-};
-
 G_DEFINE_TYPE (SnippetsDialog, snippets_dialog, GTK_TYPE_DIALOG)
 
 enum
@@ -103,11 +135,28 @@ snippets_dialog_init (SnippetsDialog *dialog)
   gtk_window_set_title (GTK_WINDOW (dialog), _("Snippets Configuration"));
   gtk_window_set_skip_taskbar_hint (GTK_WINDOW (dialog), TRUE);
   gtk_window_set_skip_pager_hint (GTK_WINDOW (dialog), TRUE);
+  
+  g_signal_connect (G_OBJECT (dialog), "response",
+                    G_CALLBACK (commit_text), NULL);
 }
 
 static void
 snippets_dialog_finalize (SnippetsDialog *dialog)
 {
+  SnippetsDialogPrivate *priv;
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  g_object_unref (priv->model);
+  g_hash_table_destroy (priv->links);
+  g_ptr_array_free (priv->changed, TRUE);
+  g_hash_table_destroy (priv->changes);
+  g_array_free (priv->removed, TRUE);
+  if (priv->search_id != 0)
+    g_source_remove (priv->search_id);
+  g_object_unref (priv->search);
+  if (priv->matches != NULL)
+    g_hash_table_destroy (priv->matches);
+  if (priv->index != NULL)
+    g_object_unref (priv->index);
   G_OBJECT_CLASS (snippets_dialog_parent_class)-> finalize (G_OBJECT (dialog));
 }
 
@@ -123,6 +172,10 @@ snippets_dialog_new (CodeSlayer *codeslayer,
 
   priv->codeslayer = codeslayer;
   priv->configs = configs;
+  priv->links = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->changed = g_ptr_array_new ();
+  priv->changes = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->removed = g_array_new (FALSE, FALSE, sizeof (guint64));
   priv->registry = codeslayer_get_registry (codeslayer);
   
   add_content_area (SNIPPETS_DIALOG (dialog));
@@ -132,9 +185,34 @@ snippets_dialog_new (CodeSlayer *codeslayer,
   
   load_configs (SNIPPETS_DIALOG (dialog));
 
+  priv->search = snippets_search_new ();
+  priv->search_next = *configs;
+  priv->search_id = g_idle_add ((GSourceFunc) index_search_action, dialog);
+
   return dialog;
 }
 
+/*
+ * The snippets that were added or changed, in the order they were first
+ * touched in. Removed snippets are not in it, their ids are in the
+ * removed array instead. Both belong to the dialog.
+ */
+GPtrArray*
+snippets_dialog_get_changed (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  return priv->changed;
+}
+
+GArray*
+snippets_dialog_get_removed (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  return priv->removed;
+}
+
 static void
 registry_changed_action (SnippetsDialog *dialog)
 {
@@ -204,9 +282,9 @@ add_file_types_pane (SnippetsDialog *dialog,
   SnippetsDialogPrivate *priv;
   GtkWidget *vbox;
   GtkWidget *label;
+  GtkWidget *search_entry;
   GtkWidget *tree;
-  GtkTreeStore *store;
-  GtkTreeSortable *sortable;
+  SnippetsModel *model;
   GtkTreeViewColumn *column;
   GtkCellRenderer *renderer;
   GtkTreeSelection *selection;
@@ -222,25 +300,28 @@ add_file_types_pane (SnippetsDialog *dialog,
   label = gtk_label_new ("File Types");
   gtk_misc_set_alignment (GTK_MISC (label), 0, .5);
 
+  /* the search */
+
+  search_entry = gtk_search_entry_new ();
+  priv->search_entry = search_entry;
+  
+  g_signal_connect_swapped (G_OBJECT (search_entry), "changed",
+                            G_CALLBACK (search_action), dialog);
+
   /* the tree */
 
   tree = gtk_tree_view_new ();
   priv->tree = tree;
   
-  store = gtk_tree_store_new (COLUMNS, G_TYPE_STRING, G_TYPE_POINTER);
-  priv->store = store;
+  model = snippets_model_new ();
+  priv->model = model;
   
   gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (tree), FALSE);
-  gtk_tree_view_set_model (GTK_TREE_VIEW (tree), GTK_TREE_MODEL (store));
+  gtk_tree_view_set_model (GTK_TREE_VIEW (tree), GTK_TREE_MODEL (model));
   
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (tree));
   gtk_tree_selection_set_mode (selection, GTK_SELECTION_BROWSE);
 
-  sortable = GTK_TREE_SORTABLE (store);
-  gtk_tree_sortable_set_sort_func (sortable, TEXT, sort_compare,
-                                   GINT_TO_POINTER (TEXT), NULL);
-  gtk_tree_sortable_set_sort_column_id (sortable, TEXT, GTK_SORT_ASCENDING);
-                           
   column = gtk_tree_view_column_new ();
   renderer = gtk_cell_renderer_text_new ();
   g_object_set (renderer, "editable", TRUE, "editable-set", TRUE, NULL);
@@ -248,11 +329,11 @@ add_file_types_pane (SnippetsDialog *dialog,
   g_signal_connect_swapped (G_OBJECT (priv->tree), "button_press_event",
                             G_CALLBACK (show_popup_menu), dialog);
 
-  g_signal_connect_swapped (G_OBJECT (renderer), "edited",
+  g_signal_connect_swapped (G_OBJECT (renderer), "edited",
                             G_CALLBACK (tree_edited_action), dialog);
 
   gtk_tree_view_column_pack_start (column, renderer, FALSE);
-  gtk_tree_view_column_set_attributes (column, renderer, "text", TEXT, NULL);
+  gtk_tree_view_column_set_attributes (column, renderer, "text", SNIPPETS_MODEL_TEXT, NULL);
 
   gtk_tree_view_append_column (GTK_TREE_VIEW (tree), column);
 
@@ -279,6 +360,7 @@ add_file_types_pane (SnippetsDialog *dialog,
   /* pack everything in */  
 
   gtk_box_pack_start (GTK_BOX (vbox), label, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (vbox), search_entry, FALSE, FALSE, 0);
   gtk_box_pack_start (GTK_BOX (vbox), scrolled_window, TRUE, TRUE, 0);
   gtk_box_pack_start (GTK_BOX (vbox), hbutton, FALSE, FALSE, 0);
   gtk_paned_add1 (GTK_PANED (hpaned), vbox);
@@ -300,6 +382,10 @@ add_syntax_pane (SnippetsDialog *dialog,
   GtkWidget *grid;
   GtkWidget *trigger_label;
   GtkWidget *trigger_entry;
+  GtkWidget *contexts_label;
+  GtkWidget *contexts_entry;
+  GtkWidget *pattern_button;
+  GtkWidget *conflicts_label;
   GtkWidget *text_view;
   GtkTextBuffer *buffer;
   GtkWidget *scrolled_window;
@@ -324,6 +410,35 @@ add_syntax_pane (SnippetsDialog *dialog,
   gtk_grid_attach (GTK_GRID (grid), trigger_label, 0, 0, 1, 1);
   gtk_grid_attach_next_to (GTK_GRID (grid), trigger_entry, trigger_label, 
                            GTK_POS_RIGHT, 1, 1);
+
+  pattern_button = gtk_check_button_new_with_label (_("Pattern"));
+  priv->pattern_button = pattern_button;
+  gtk_widget_set_tooltip_text (pattern_button, _("The trigger is a regular expression, its groups are ${match:1} and so on"));
+  gtk_grid_attach_next_to (GTK_GRID (grid), pattern_button, trigger_entry, 
+                           GTK_POS_RIGHT, 1, 1);
+  
+  /* the contexts entry */  
+  
+  contexts_label = gtk_label_new (_("Contexts"));
+  contexts_entry =  gtk_entry_new ();
+  priv->contexts_entry = contexts_entry;
+  gtk_widget_set_tooltip_text (contexts_entry, _("Context classes to expand in, such as comment, or to stay out of, such as !string"));
+
+  gtk_misc_set_alignment (GTK_MISC (contexts_label), 1, .5);
+  gtk_misc_set_padding (GTK_MISC (contexts_label), 4, 0);
+  gtk_grid_attach (GTK_GRID (grid), contexts_label, 0, 1, 1, 1);
+  gtk_grid_attach_next_to (GTK_GRID (grid), contexts_entry, contexts_label, 
+                           GTK_POS_RIGHT, 1, 1);
+  
+  /* the conflicts label */  
+  
+  conflicts_label = gtk_label_new (NULL);
+  priv->conflicts_label = conflicts_label;
+  gtk_widget_set_tooltip_text (conflicts_label, _("Other snippets with the same trigger for some of the same files"));
+  
+  gtk_misc_set_alignment (GTK_MISC (conflicts_label), 0, .5);
+  gtk_label_set_line_wrap (GTK_LABEL (conflicts_label), TRUE);
+  gtk_grid_attach (GTK_GRID (grid), conflicts_label, 1, 2, 2, 1);
   
   /* the end entry */  
   
@@ -345,6 +460,12 @@ add_syntax_pane (SnippetsDialog *dialog,
   priv->trigger_entry_id = g_signal_connect_swapped (G_OBJECT (priv->trigger_entry), "notify::text",
                                                      G_CALLBACK (trigger_entry_action), dialog);
                             
+  priv->contexts_entry_id = g_signal_connect_swapped (G_OBJECT (priv->contexts_entry), "notify::text",
+                                                      G_CALLBACK (contexts_entry_action), dialog);
+                            
+  priv->pattern_button_id = g_signal_connect_swapped (G_OBJECT (priv->pattern_button), "toggled",
+                                                      G_CALLBACK (pattern_button_action), dialog);
+                            
   buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->text_view));
 
   priv->text_buffer_id = g_signal_connect_swapped (G_OBJECT (buffer), "changed",
@@ -355,51 +476,366 @@ static void
 load_configs (SnippetsDialog *dialog)
 {
   SnippetsDialogPrivate *priv;
-  GList *list;
   GtkTextBuffer *buffer;
-  GtkTreeIter parent;
-  const gchar *last_file_types = NULL;
+  GList *list;
 
   priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
   
   buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->text_view));
 
   g_signal_handler_block (priv->trigger_entry, priv->trigger_entry_id);
+  g_signal_handler_block (priv->contexts_entry, priv->contexts_entry_id);
+  g_signal_handler_block (priv->pattern_button, priv->pattern_button_id);
   g_signal_handler_block (buffer, priv->text_buffer_id);
 
-  list = *priv->configs;
-  while (list != NULL)
+  for (list = *priv->configs; list != NULL; list = g_list_next (list))
+    {
+      g_hash_table_insert (priv->links, list->data, list);
+      priv->last_link = list;
+    }
+
+  fill_model (dialog, NULL);
+
+  g_signal_handler_unblock (priv->trigger_entry, priv->trigger_entry_id);
+  g_signal_handler_unblock (priv->contexts_entry, priv->contexts_entry_id);
+  g_signal_handler_unblock (priv->pattern_button, priv->pattern_button_id);
+  g_signal_handler_unblock (buffer, priv->text_buffer_id);
+}
+
+/*
+ * Puts every config into the model, or only the ones in the matches
+ * when there is a search going on. Configs with the same file types
+ * share a group no matter where they are in the list, or how the
+ * file types are spelled.
+ */
+static void
+fill_model (SnippetsDialog *dialog,
+            GHashTable     *matches)
+{
+  SnippetsDialogPrivate *priv;
+  GHashTable *groups;
+  GList *list;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  groups = g_hash_table_new_full ((GHashFunc) snippets_file_types_hash, 
+                                  (GEqualFunc) snippets_file_types_equal, NULL, 
+                                  (GDestroyNotify) gtk_tree_iter_free);
+  
+  for (list = *priv->configs; list != NULL; list = g_list_next (list))
     {
       SnippetsConfig *config = list->data;
+      const SnippetsFileTypeSet *set;
       const gchar *file_types;
-      const gchar *name;
-      GtkTreeIter iter;
+      GtkTreeIter *parent;
+      
+      if (matches != NULL && g_hash_table_lookup (matches, config) == NULL)
+        continue;
       
       file_types = snippets_config_get_file_types (config);
+      if (file_types == NULL)
+        file_types = "";
       
-      if (last_file_types == NULL || g_strcmp0 (file_types, last_file_types) != 0)
+      set = snippets_config_get_file_type_set (config);
+      parent = g_hash_table_lookup (groups, set);
+      if (parent == NULL)
         {
-          gtk_tree_store_append (priv->store, &parent, NULL);
-          gtk_tree_store_set (priv->store, &parent, 
-                              TEXT, file_types,
-                              -1);
-                              
-          last_file_types = file_types;
+          GtkTreeIter iter;
+          snippets_model_append_group (priv->model, file_types, &iter);
+          parent = gtk_tree_iter_copy (&iter);
+          g_hash_table_insert (groups, (gpointer) set, parent);
         }
         
-      name = snippets_config_get_name (config);
+      snippets_model_append_config (priv->model, parent, config, NULL);
+    }
+    
+  g_hash_table_destroy (groups);
+}
+
+/*
+ * Only the rows that start or stop matching are touched, so typing on
+ * in a narrow search is cheap. When most of the tree comes and goes the
+ * model is taken off the tree and filled again instead. Small result
+ * sets are opened up so the matches can be seen straight away.
+ */
+static void
+search_action (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  GHashTable *matches = NULL;
+  const gchar *query;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  commit_text (dialog);
+  
+  query = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
+  if (codeslayer_utils_has_text (query))
+    matches = snippets_search_find (get_search (dialog), query);
+
+  update_model (dialog, matches);
+
+  if (priv->matches != NULL)
+    g_hash_table_destroy (priv->matches);
+  priv->matches = matches;
+
+  if (matches != NULL && g_hash_table_size (matches) <= SEARCH_EXPAND_LIMIT)
+    gtk_tree_view_expand_all (GTK_TREE_VIEW (priv->tree));
+}
+
+/*
+ * The rows to take out and put back come from the matches of the last
+ * search and of this one, so a keystroke costs as much as the two result
+ * sets and not the whole library. Only starting or clearing a search
+ * goes over every snippet. A group that loses its last row to the
+ * search goes with it, and is put back by the first of its snippets to
+ * match again.
+ */
+static void
+update_model (SnippetsDialog *dialog,
+              GHashTable     *matches)
+{
+  SnippetsDialogPrivate *priv;
+  GPtrArray *hidden;
+  GPtrArray *shown;
+  GHashTableIter iter;
+  gpointer config;
+  GList *list;
+  guint i;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  hidden = g_ptr_array_new ();
+  shown = g_ptr_array_new ();
+
+  if (priv->matches != NULL && matches != NULL)
+    {
+      g_hash_table_iter_init (&iter, priv->matches);
+      while (g_hash_table_iter_next (&iter, &config, NULL))
+        {
+          if (g_hash_table_lookup (matches, config) == NULL &&
+              snippets_model_find_config (priv->model, config, NULL))
+            g_ptr_array_add (hidden, config);
+        }
+
+      g_hash_table_iter_init (&iter, matches);
+      while (g_hash_table_iter_next (&iter, &config, NULL))
+        {
+          if (g_hash_table_lookup (priv->matches, config) == NULL &&
+              !snippets_model_find_config (priv->model, config, NULL))
+            g_ptr_array_add (shown, config);
+        }
+    }
+  else if (priv->matches != NULL || matches != NULL)
+    {
+      for (list = *priv->configs; list != NULL; list = g_list_next (list))
+        {
+          gboolean matched;
+          gboolean present;
+
+          config = list->data;
+          matched = matches == NULL || g_hash_table_lookup (matches, config) != NULL;
+          present = snippets_model_find_config (priv->model, config, NULL);
+
+          if (present && !matched)
+            g_ptr_array_add (hidden, config);
+          else if (!present && matched)
+            g_ptr_array_add (shown, config);
+        }
+    }
+
+  if (hidden->len + shown->len > SEARCH_REBUILD_LIMIT)
+    {
+      gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree), NULL);
+      snippets_model_clear (priv->model);
+      fill_model (dialog, matches);
+      gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree), GTK_TREE_MODEL (priv->model));
+      g_ptr_array_free (hidden, TRUE);
+      g_ptr_array_free (shown, TRUE);
+      return;
+    }
+
+  for (i = 0; i < hidden->len; i++)
+    {
+      GtkTreeIter row;
+      GtkTreeIter parent;
       
-      gtk_tree_store_append (priv->store, &iter, &parent);
-      gtk_tree_store_set (priv->store, &iter, 
-                          TEXT, name,
-                          CONFIGURATION, config,
-                          -1);
-                          
-      list = g_list_next (list);
+      snippets_model_find_config (priv->model, g_ptr_array_index (hidden, i), &row);
+      gtk_tree_model_iter_parent (GTK_TREE_MODEL (priv->model), &parent, &row);
+      snippets_model_remove (priv->model, &row);
+      
+      if (!gtk_tree_model_iter_has_child (GTK_TREE_MODEL (priv->model), &parent))
+        snippets_model_remove (priv->model, &parent);
     }
 
-  g_signal_handler_unblock (priv->trigger_entry, priv->trigger_entry_id);
-  g_signal_handler_unblock (buffer, priv->text_buffer_id);
+  for (i = 0; i < shown->len; i++)
+    {
+      const SnippetsFileTypeSet *set;
+      GtkTreeIter parent;
+      
+      config = g_ptr_array_index (shown, i);
+      set = snippets_config_get_file_type_set (config);
+      if (!snippets_model_find_group (priv->model, set, &parent))
+        {
+          const gchar *file_types = snippets_config_get_file_types (config);
+          snippets_model_append_group (priv->model, 
+                                       file_types != NULL ? file_types : "", 
+                                       &parent);
+        }
+      
+      snippets_model_append_config (priv->model, &parent, config, NULL);
+    }
+
+  g_ptr_array_free (hidden, TRUE);
+  g_ptr_array_free (shown, TRUE);
+}
+
+/*
+ * The search index is built a slice at a time while the dialog is idle,
+ * the first search finishes off whatever is left.
+ */
+static gboolean
+index_search_action (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  for (i = 0; i < SEARCH_CHUNK && priv->search_next != NULL; i++)
+    {
+      snippets_search_add (priv->search, priv->search_next->data);
+      priv->search_next = g_list_next (priv->search_next);
+    }
+  
+  if (priv->search_next != NULL)
+    return TRUE;
+    
+  priv->search_id = 0;
+  return FALSE;
+}
+
+static SnippetsSearch*
+get_search (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  if (priv->search_id != 0)
+    {
+      g_source_remove (priv->search_id);
+      priv->search_id = 0;
+    }
+    
+  while (priv->search_next != NULL)
+    {
+      snippets_search_add (priv->search, priv->search_next->data);
+      priv->search_next = g_list_next (priv->search_next);
+    }
+  
+  return priv->search;
+}
+
+/*
+ * The conflicts are worked out by an index of our own over the copies,
+ * a snippet is put back into it whenever something it is ranked by
+ * changes.
+ */
+static SnippetsIndex*
+get_index (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  GList *list;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  if (priv->index != NULL)
+    return priv->index;
+    
+  priv->index = snippets_index_new ();
+
+  for (list = *priv->configs; list != NULL; list = g_list_next (list))
+    snippets_index_add (priv->index, list->data);
+  
+  return priv->index;
+}
+
+/*
+ * The changed snippets are kept in the order they were first changed in,
+ * so that the engine only has to look at those when the dialog is done.
+ */
+static void
+config_changed (SnippetsDialog *dialog,
+                SnippetsConfig *config)
+{
+  SnippetsDialogPrivate *priv;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  if (!g_hash_table_contains (priv->changes, config))
+    {
+      g_hash_table_insert (priv->changes, config, GINT_TO_POINTER (FALSE));
+      g_ptr_array_add (priv->changed, config);
+    }
+  
+  if (priv->index == NULL)
+    return;
+    
+  snippets_index_remove (priv->index, config);
+  snippets_index_add (priv->index, config);
+}
+
+/*
+ * Lists what the snippet conflicts with, or how many conflicts there
+ * are in all when a group is selected.
+ */
+static void
+show_conflicts (SnippetsDialog *dialog,
+                SnippetsConfig *config)
+{
+  SnippetsDialogPrivate *priv;
+  GArray *conflicts;
+  GString *text;
+  guint i;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  conflicts = snippets_index_get_conflicts (get_index (dialog), config);
+  text = g_string_new (NULL);
+  
+  if (config == NULL && conflicts->len > 0)
+    g_string_printf (text, _("%u trigger conflicts in the library"), conflicts->len);
+
+  for (i = 0; config != NULL && i < conflicts->len; i++)
+    {
+      SnippetsConflict *conflict = &g_array_index (conflicts, SnippetsConflict, i);
+      SnippetsConfig *other;
+      const gchar *name;
+      const gchar *file_types;
+      
+      other = conflict->winner == config ? conflict->loser : conflict->winner;
+      name = snippets_config_get_name (other);
+      file_types = snippets_config_get_file_types (other);
+      
+      if (text->len > 0)
+        g_string_append_c (text, '\n');
+      
+      if (conflict->winner == config)
+        g_string_append_printf (text, _("Comes before %s for %s"), 
+                                name != NULL ? name : "", file_types != NULL ? file_types : "");
+      else if (conflict->shadowed)
+        g_string_append_printf (text, _("Shadowed by %s for %s"), 
+                                name != NULL ? name : "", file_types != NULL ? file_types : "");
+      else
+        g_string_append_printf (text, _("Comes after %s for %s"), 
+                                name != NULL ? name : "", file_types != NULL ? file_types : "");
+    }
+  
+  gtk_label_set_text (GTK_LABEL (priv->conflicts_label), text->str);
+  
+  g_string_free (text, TRUE);
+  g_array_free (conflicts, TRUE);
 }
 
 static void
@@ -412,11 +848,10 @@ tree_add_action (SnippetsDialog *dialog)
 
   priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
 
-  gtk_tree_store_append (priv->store, &iter, NULL);
-  gtk_tree_store_set (priv->store, &iter, TEXT, "", -1);
+  snippets_model_append_group (priv->model, "", &iter);
   
   column = gtk_tree_view_get_column (GTK_TREE_VIEW (priv->tree), 0);
-  child_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->store), 
+  child_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->model), 
                                         &iter);
   gtk_tree_view_set_cursor (GTK_TREE_VIEW (priv->tree), child_path, 
                             column, TRUE);
@@ -438,31 +873,49 @@ tree_remove_action (SnippetsDialog *dialog)
   if (gtk_tree_selection_get_selected (selection, &model, &parent))
     {
       GtkTreeIter iter;
-    
-      while (gtk_tree_model_iter_children (model, &iter, &parent))
+      GList *configs = NULL;
+      
+      if (gtk_tree_model_iter_parent (model, &iter, &parent))
+        {
+          remove_snippet_action (dialog);
+          return;
+        }
+      
+      /*
+       * A search may hide some of the group, so its snippets are taken
+       * from the library by their file types rather than from the rows.
+       */
+      if (gtk_tree_model_iter_children (model, &iter, &parent))
         {
+          const SnippetsFileTypeSet *set;
           SnippetsConfig *config;
-        
+          GList *list;
+
           gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
-                              CONFIGURATION, &config, -1);
-          
-          if (config != NULL)
+                              SNIPPETS_MODEL_CONFIGURATION, &config, -1);
+          set = snippets_config_get_file_type_set (config);
+
+          for (list = *priv->configs; list != NULL; list = g_list_next (list))
             {
-              *priv->configs = g_list_remove (*priv->configs, config);
-              g_object_unref (config);
+              if (snippets_file_types_equal (snippets_config_get_file_type_set (list->data), set))
+                configs = g_list_prepend (configs, list->data);
             }
-          
-          gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
         }
 
-      gtk_tree_store_remove (GTK_TREE_STORE (model), &parent);
+      snippets_model_remove (priv->model, &parent);
+      
+      while (configs != NULL)
+        {
+          remove_config (dialog, configs->data);
+          configs = g_list_delete_link (configs, configs);
+        }
     }
 }
 
-static void 
-tree_edited_action (SnippetsDialog *dialog, 
-                    gchar          *path, 
-                    gchar          *text)
+static void 
+tree_edited_action (SnippetsDialog *dialog, 
+                    gchar          *path, 
+                    gchar          *text)
 {
   SnippetsDialogPrivate *priv;
   GtkTreeSelection *selection;
@@ -471,40 +924,44 @@ tree_edited_action (SnippetsDialog *dialog,
 
   priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
   
-  if (!codeslayer_utils_has_text (text))
-    return;
+  if (!codeslayer_utils_has_text (text))
+    return;
   
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree));
   if (gtk_tree_selection_get_selected (selection, &model, &iter))
     {
       SnippetsConfig *config;
-            
+    
+      snippets_model_set_text (priv->model, &iter, text);
+      
       gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
-                          CONFIGURATION, &config, -1);
-            
-      gtk_tree_store_set (GTK_TREE_STORE (model), &iter, TEXT, text, -1);        
+                          SNIPPETS_MODEL_CONFIGURATION, &config, -1);
+      
+      if (config != NULL)
+        snippets_search_update (priv->search, config);
       
-      /* the parent */
-      if (config == NULL)
+      if (config != NULL)
+        {
+          config_changed (dialog, config);
+        }
+      else
         {
           GtkTreeIter child;
           
-          if (!gtk_tree_model_iter_children (model, &child, &iter))
-            return;
-
-          do
+          if (gtk_tree_model_iter_children (model, &child, &iter))
             {
-              SnippetsConfig *config;
-              gtk_tree_model_get (GTK_TREE_MODEL (model), &child, 
-                                  CONFIGURATION, &config, -1);
-              snippets_config_set_file_types (config, text);
+              do
+                {
+                  SnippetsConfig *child_config;
+                  gtk_tree_model_get (GTK_TREE_MODEL (model), &child, 
+                                      SNIPPETS_MODEL_CONFIGURATION, &child_config, -1);
+                  config_changed (dialog, child_config);
+                }
+              while (gtk_tree_model_iter_next (model, &child));
             }
-          while (gtk_tree_model_iter_next (model, &child));
-        }
-      else
-        {
-          snippets_config_set_name (config, text);
         }
+      
+      show_conflicts (dialog, config);
     }
 }
 
@@ -521,7 +978,12 @@ select_row_action (GtkTreeSelection *selection,
   
   buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->text_view));
   
+  commit_text (dialog);
+  priv->text_config = NULL;
+  
   g_signal_handler_block (priv->trigger_entry, priv->trigger_entry_id);
+  g_signal_handler_block (priv->contexts_entry, priv->contexts_entry_id);
+  g_signal_handler_block (priv->pattern_button, priv->pattern_button_id);
   g_signal_handler_block (buffer, priv->text_buffer_id);
 
   if (gtk_tree_selection_get_selected (selection, &model, &iter))
@@ -531,7 +993,7 @@ select_row_action (GtkTreeSelection *selection,
       gboolean toplevel;
     
       gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
-                          CONFIGURATION, &config, -1);
+                          SNIPPETS_MODEL_CONFIGURATION, &config, -1);
       
       buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->text_view));
       
@@ -539,30 +1001,45 @@ select_row_action (GtkTreeSelection *selection,
         
       if (!toplevel)
         {
+          GString *scratch;
           const gchar *text;
           const gchar *trigger; 
+          const gchar *contexts; 
           
-          text = snippets_config_get_text (config);
+          scratch = g_string_new (NULL);
+          text = snippets_config_get_text (config, scratch);
           trigger = snippets_config_get_trigger (config);
+          contexts = snippets_config_get_contexts (config);
           
-          if (codeslayer_utils_has_text (text))
-            gtk_text_buffer_set_text (buffer, text, -1);
+          gtk_text_buffer_set_text (buffer, text != NULL ? text : "", -1);
+          g_string_free (scratch, TRUE);
+          gtk_entry_set_text (GTK_ENTRY (priv->trigger_entry), trigger != NULL ? trigger : "");
+          gtk_entry_set_text (GTK_ENTRY (priv->contexts_entry), contexts != NULL ? contexts : "");
+          gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (priv->pattern_button), 
+                                        snippets_config_get_pattern (config));
           
-          if (codeslayer_utils_has_text (trigger))     
-            gtk_entry_set_text (GTK_ENTRY (priv->trigger_entry), trigger);
+          priv->text_config = config;
         }
       else
         {
           gtk_text_buffer_set_text (buffer, "", -1);
           gtk_entry_set_text (GTK_ENTRY (priv->trigger_entry), "");
+          gtk_entry_set_text (GTK_ENTRY (priv->contexts_entry), "");
+          gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (priv->pattern_button), FALSE);
         }
         
       gtk_widget_set_sensitive (GTK_WIDGET (priv->text_view), !toplevel);
       gtk_widget_set_sensitive (GTK_WIDGET (priv->trigger_entry), !toplevel);
+      gtk_widget_set_sensitive (GTK_WIDGET (priv->contexts_entry), !toplevel);
+      gtk_widget_set_sensitive (GTK_WIDGET (priv->pattern_button), !toplevel);
     }
     
   g_signal_handler_unblock (priv->trigger_entry, priv->trigger_entry_id);
+  g_signal_handler_unblock (priv->contexts_entry, priv->contexts_entry_id);
+  g_signal_handler_unblock (priv->pattern_button, priv->pattern_button_id);
   g_signal_handler_unblock (buffer, priv->text_buffer_id);
+  
+  show_conflicts (dialog, priv->text_config);
 }
 
 static void
@@ -582,26 +1059,58 @@ trigger_entry_action (SnippetsDialog *dialog,
       SnippetsConfig *config;
     
       gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
-                          CONFIGURATION, &config, -1);
+                          SNIPPETS_MODEL_CONFIGURATION, &config, -1);
       
       if (config != NULL)
         {
           const gchar *text;
           text = gtk_entry_get_text (GTK_ENTRY (priv->trigger_entry));
           snippets_config_set_trigger (config, text);
+          snippets_search_update (priv->search, config);
+          config_changed (dialog, config);
+          show_conflicts (dialog, config);
         }    
     }
 }
 
 static void
-text_view_action (SnippetsDialog *dialog,
-                  GParamSpec     *spec)
+contexts_entry_action (SnippetsDialog *dialog,
+                       GParamSpec     *spec)
 {
   SnippetsDialogPrivate *priv;
   GtkTreeSelection *selection;
   GtkTreeModel *model;
   GtkTreeIter iter;
+
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
   
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree));
+  if (gtk_tree_selection_get_selected (selection, &model, &iter))
+    {
+      SnippetsConfig *config;
+    
+      gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
+                          SNIPPETS_MODEL_CONFIGURATION, &config, -1);
+      
+      if (config != NULL)
+        {
+          const gchar *contexts;
+          contexts = gtk_entry_get_text (GTK_ENTRY (priv->contexts_entry));
+          snippets_config_set_contexts (config, contexts);
+          config_changed (dialog, config);
+          show_conflicts (dialog, config);
+        }    
+    }
+}
+
+static void
+pattern_button_action (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+
   priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
   
   selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree));
@@ -610,26 +1119,106 @@ text_view_action (SnippetsDialog *dialog,
       SnippetsConfig *config;
     
       gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
-                          CONFIGURATION, &config, -1);
+                          SNIPPETS_MODEL_CONFIGURATION, &config, -1);
       
       if (config != NULL)
         {
-          GtkTextBuffer *buffer;
-          GtkTextIter start;
-          GtkTextIter end;
-          gchar *text;
-          
-          buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->text_view));
-          gtk_text_buffer_get_bounds (buffer, &start, &end);
-          text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
-          
-          snippets_config_set_text (config, text);
-          
-          g_free (text);
-        }
+          gboolean active;
+          active = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->pattern_button));
+          snippets_config_set_pattern (config, active);
+          config_changed (dialog, config);
+          show_conflicts (dialog, config);
+        }    
     }
 }
 
+/*
+ * The buffer is only copied back into the config when we move off the
+ * snippet or close the dialog, so typing in a large body stays cheap.
+ */
+static void
+text_view_action (SnippetsDialog *dialog,
+                  GParamSpec     *spec)
+{
+  SnippetsDialogPrivate *priv;
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  priv->text_dirty = priv->text_config != NULL;
+}
+
+static void
+commit_text (SnippetsDialog *dialog)
+{
+  SnippetsDialogPrivate *priv;
+  GtkTextBuffer *buffer;
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+  
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  if (!priv->text_dirty || priv->text_config == NULL)
+    return;
+    
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->text_view));
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+  
+  snippets_config_set_text (priv->text_config, text);
+  priv->text_dirty = FALSE;
+  
+  snippets_search_update (priv->search, priv->text_config);
+  config_changed (dialog, priv->text_config);
+  
+  g_free (text);
+}
+
+static void
+remove_config (SnippetsDialog *dialog,
+               SnippetsConfig *config)
+{
+  SnippetsDialogPrivate *priv;
+  GList *link;
+  
+  priv = SNIPPETS_DIALOG_GET_PRIVATE (dialog);
+  
+  if (priv->text_config == config)
+    {
+      priv->text_config = NULL;
+      priv->text_dirty = FALSE;
+    }
+    
+  snippets_search_remove (priv->search, config);
+
+  if (priv->matches != NULL)
+    g_hash_table_remove (priv->matches, config);
+    
+  if (priv->index != NULL)
+    snippets_index_remove (priv->index, config);
+    
+  /* a snippet added since the dialog opened was never known outside it */
+  if (!GPOINTER_TO_INT (g_hash_table_lookup (priv->changes, config)))
+    {
+      guint64 id = snippets_config_get_id (config);
+      g_array_append_val (priv->removed, id);
+    }
+    
+  if (g_hash_table_remove (priv->changes, config))
+    g_ptr_array_remove (priv->changed, config);
+    
+  link = g_hash_table_lookup (priv->links, config);
+  if (link != NULL)
+    {
+      if (link == priv->search_next)
+        priv->search_next = link->next;
+      if (link == priv->last_link)
+        priv->last_link = link->prev;
+      *priv->configs = g_list_delete_link (*priv->configs, link);
+      g_hash_table_remove (priv->links, config);
+    }
+  
+  g_object_unref (config);
+}
+
 static void
 add_snippet_action (SnippetsDialog *dialog)
 {
@@ -656,23 +1245,36 @@ add_snippet_action (SnippetsDialog *dialog)
       snippets_config_set_text (config, "");
       
       gtk_tree_model_get (GTK_TREE_MODEL (model), &parent, 
-                          TEXT, &file_types, -1);
+                          SNIPPETS_MODEL_TEXT, &file_types, -1);
                           
       snippets_config_set_file_types (config, file_types);
       g_free (file_types);
 
-      *priv->configs = g_list_append (*priv->configs, config);
+      if (priv->last_link != NULL)
+        priv->last_link = g_list_append (priv->last_link, config)->next;
+      else
+        priv->last_link = *priv->configs = g_list_append (NULL, config);
+      g_hash_table_insert (priv->links, config, priv->last_link);
+      
+      g_hash_table_insert (priv->changes, config, GINT_TO_POINTER (TRUE));
+      g_ptr_array_add (priv->changed, config);
       
-      gtk_tree_store_append (priv->store, &iter, &parent);
-      gtk_tree_store_set (priv->store, &iter, 
-                          TEXT, "",
-                          CONFIGURATION, config, -1);
+      snippets_search_add (priv->search, config);
+      
+      /* it is shown under the search too, until the next one leaves it out */
+      if (priv->matches != NULL)
+        g_hash_table_insert (priv->matches, config, config);
+      
+      if (priv->index != NULL)
+        snippets_index_add (priv->index, config);
+      
+      snippets_model_append_config (priv->model, &parent, config, &iter);
                           
-      tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->store), &parent);
+      tree_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->model), &parent);
       gtk_tree_view_expand_row (GTK_TREE_VIEW (priv->tree), tree_path, FALSE);
 
       column = gtk_tree_view_get_column (GTK_TREE_VIEW (priv->tree), 0);
-      child_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->store), &iter);
+      child_path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->model), &iter);
       gtk_tree_view_set_cursor (GTK_TREE_VIEW (priv->tree), child_path, column, TRUE);
   
       gtk_tree_path_free (tree_path);
@@ -696,12 +1298,11 @@ remove_snippet_action (SnippetsDialog *dialog)
       SnippetsConfig *config;
     
       gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 
-                          CONFIGURATION, &config, -1);
+                          SNIPPETS_MODEL_CONFIGURATION, &config, -1);
       
-      *priv->configs = g_list_remove (*priv->configs, config);
-      g_object_unref (config);
+      snippets_model_remove (priv->model, &iter);
       
-      gtk_tree_store_remove (GTK_TREE_STORE (model), &iter);
+      remove_config (dialog, config);
     }
 }
 
@@ -815,34 +1416,3 @@ get_showable_popup_items (SnippetsDialog *dialog)
     
   return results;
 }                 
-
-static gint
-sort_compare (GtkTreeModel *model, 
-              GtkTreeIter  *a,
-              GtkTreeIter  *b, 
-              gpointer      userdata)
-{
-  gint sortcol;
-  gint ret = 0;
-
-  sortcol = GPOINTER_TO_INT (userdata);
-  
-  switch (sortcol)
-    {
-    case TEXT:
-      {
-        gchar *text1, *text2;
-
-        gtk_tree_model_get (model, a, TEXT, &text1, -1);
-        gtk_tree_model_get (model, b, TEXT, &text2, -1);
-
-        ret = g_strcmp0 (text1, text2);
-
-        g_free (text1);
-        g_free (text2);
-      }
-      break;
-    }
-
-  return ret;
-}
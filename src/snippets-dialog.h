@@ -46,8 +46,10 @@ struct _SnippetsDialogClass
 
 GType snippets_dialog_get_type (void) G_GNUC_CONST;
      
-GtkWidget*  snippets_dialog_new  (CodeSlayer *codeslayer, 
-                                  GList      **configurations);
+GtkWidget*  snippets_dialog_new          (CodeSlayer     *codeslayer, 
+                                          GList          **configurations);
+GPtrArray*  snippets_dialog_get_changed  (SnippetsDialog *dialog);
+GArray*     snippets_dialog_get_removed  (SnippetsDialog *dialog);
 
 G_END_DECLS
 
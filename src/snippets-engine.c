@@ -16,30 +16,110 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <string.h>
+#include <glib/gstdio.h>
 #include <gdk/gdkkeysyms.h>
 #include <codeslayer/codeslayer-utils.h>
-#include <stdio.h>
-#include <libxml/parser.h>
-#include <libxml/tree.h>
 #include "snippets-engine.h"
 #include "snippets-dialog.h"
 #include "snippets-config.h"
+#include "snippets-io.h"
+#include "snippets-includes.h"
+#include "snippets-index.h"
+#include "snippets-menu.h"
+#include "snippets-preview.h"
+#include "snippets-saver.h"
+#include "snippets-stats.h"
+#include "snippets-provider.h"
+#include "snippets-session.h"
+#include "snippets-shell.h"
+#include "snippets-template.h"
+#include "snippets-text.h"
 
 static void snippets_engine_class_init  (SnippetsEngineClass *klass);
 static void snippets_engine_init        (SnippetsEngine      *engine);
 static void snippets_engine_finalize    (SnippetsEngine      *engine);
 
 static void save_configs                (SnippetsEngine      *engine);
-static void load_configs                (xmlNode             *a_node,
-                                         GList               **configs);
 static gchar* get_config_file_path      (SnippetsEngine      *engine);
+static gchar* get_settings_file_path    (SnippetsEngine      *engine);
+static void load_settings               (SnippetsEngine      *engine);
+static void save_settings               (SnippetsEngine      *engine);
+static void rebuild_index               (SnippetsEngine      *engine);
+static gboolean apply_configs           (SnippetsEngine      *engine,
+                                         GList               *copies,
+                                         GPtrArray           *changed,
+                                         GArray              *removed);
+static void forget_config               (SnippetsEngine      *engine,
+                                         SnippetsConfig      *config);
+static void add_id                      (SnippetsEngine      *engine,
+                                         SnippetsConfig      *config);
+static void report_conflicts            (SnippetsEngine      *engine);
 static GList* get_configs_deep_copy     (SnippetsEngine      *engine);
 static void editor_added_action         (SnippetsEngine       *engine, 
                                          CodeSlayerEditor     *editor);
+static void editor_removed_action       (SnippetsEngine       *engine, 
+                                         GObject              *editor);
+static void disconnect_editor           (CodeSlayerEditor     *editor,
+                                         gpointer              handler_id,
+                                         SnippetsEngine       *engine);
 static gboolean key_press_action        (CodeSlayerEditor     *editor,
                                          GdkEventKey          *event, 
                                          SnippetsEngine       *engine);
-static void move_iter_word_start        (GtkTextIter          *iter);
+static void expand_selection_action     (SnippetsEngine       *engine);
+static void expand_selection            (SnippetsEngine       *engine,
+                                         SnippetsConfig       *config);
+static void clear_selection             (SnippetsEngine       *engine);
+static void import_snippets_action      (SnippetsEngine       *engine);
+static void import_configs              (GList                *configs,
+                                         SnippetsEngine       *engine);
+static void export_snippets_action      (SnippetsEngine       *engine);
+static void export_statistics_action    (SnippetsEngine       *engine);
+static gchar* choose_library_file       (GtkFileChooserAction  action);
+static void fuzzy_triggers_action       (SnippetsEngine       *engine,
+                                         gboolean              fuzzy_triggers);
+static void shell_commands_action       (SnippetsEngine       *engine,
+                                         gboolean              shell_commands);
+static void config_activated_action     (SnippetsEngine       *engine,
+                                         SnippetsConfig       *config);
+static void preview_activated_action    (SnippetsEngine       *engine,
+                                         SnippetsConfig       *config);
+static GPtrArray* find_configs          (SnippetsEngine       *engine, 
+                                         const gchar          *word, 
+                                         const gchar          *file_path,
+                                         GtkTextBuffer        *buffer,
+                                         GtkTextIter          *iter);
+static void record_misses               (SnippetsEngine       *engine,
+                                         const gchar          *word,
+                                         const gchar          *file_path);
+static gboolean in_context              (SnippetsEngine       *engine,
+                                         SnippetsConfig       *config,
+                                         GtkTextBuffer        *buffer,
+                                         GtkTextIter          *iter);
+static void expand_at_cursor            (SnippetsEngine       *engine,
+                                         GtkTextView          *text_view,
+                                         SnippetsConfig       *config,
+                                         const gchar          *file_path);
+static gboolean expand_pattern          (SnippetsEngine       *engine,
+                                         GtkTextView          *text_view,
+                                         const gchar          *file_path);
+static void expand_range                (SnippetsEngine       *engine,
+                                         GtkTextBuffer        *buffer,
+                                         GtkTextIter          *start,
+                                         GtkTextIter          *end,
+                                         SnippetsConfig       *config,
+                                         SnippetsTemplateContext *context);
+static void expand_config               (SnippetsEngine       *engine,
+                                         GtkTextBuffer        *buffer, 
+                                         GtkTextIter          *start,
+                                         GtkTextIter          *end,
+                                         SnippetsConfig       *config,
+                                         SnippetsTemplateContext *context);
+static gboolean has_tab_stops           (GArray               *placeholders);
+static void clear_session               (SnippetsEngine       *engine);
+static void select_placeholder          (GtkTextBuffer        *buffer,
+                                         gint                  offset,
+                                         GArray               *placeholders);
 
 #define SNIPPETS_ENGINE_GET_PRIVATE(obj) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_ENGINE_TYPE, SnippetsEnginePrivate))
@@ -48,9 +128,40 @@ typedef struct _SnippetsEnginePrivate SnippetsEnginePrivate;
 
 struct _SnippetsEnginePrivate
 {
-  CodeSlayer *codeslayer;
-  GList      *configs;
-  gulong      editor_added_id;
+  CodeSlayer       *codeslayer;
+  GtkWidget        *menu;
+  GtkWidget        *preview;
+  SnippetsProvider *provider;
+  SnippetsShell    *shell;
+  SnippetsSaver    *saver;
+  SnippetsStats    *stats;
+  SnippetsSession  *session;
+  GtkTextMark      *selection_start;
+  GtkTextMark      *selection_end;
+  GList            *configs;
+  GHashTable       *ids;
+  SnippetsIndex    *index;
+  SnippetsIncludes *includes;
+  GString          *scratch;
+  GString          *word;
+  GString          *line;
+  GString          *context_class;
+  GString          *output;
+  GString          *lines;
+  GPtrArray        *found;
+  GArray           *placeholders;
+  GArray           *commands;
+  GArray           *line_commands;
+  gboolean          fuzzy_triggers;
+  gboolean          shell_commands;
+  GHashTable       *editors;
+  gulong            editor_added_id;
+  gulong            expand_selection_id;
+  gulong            import_snippets_id;
+  gulong            export_snippets_id;
+  gulong            export_statistics_id;
+  gulong            fuzzy_triggers_id;
+  gulong            shell_commands_id;
 };
 
 G_DEFINE_TYPE (SnippetsEngine, snippets_engine, G_TYPE_OBJECT)
@@ -69,6 +180,28 @@ snippets_engine_init (SnippetsEngine *engine)
   SnippetsEnginePrivate *priv;
   priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
   priv->configs = NULL;
+  priv->ids = g_hash_table_new (g_int64_hash, g_int64_equal);
+  priv->index = snippets_index_new ();
+  priv->includes = snippets_includes_new ();
+  priv->shell = snippets_shell_new ();
+  priv->saver = snippets_saver_new ();
+  priv->stats = snippets_stats_new ();
+  priv->session = NULL;
+  priv->selection_start = NULL;
+  priv->selection_end = NULL;
+  priv->scratch = g_string_new (NULL);
+  priv->word = g_string_new (NULL);
+  priv->line = g_string_new (NULL);
+  priv->context_class = g_string_new (NULL);
+  priv->output = g_string_new (NULL);
+  priv->lines = g_string_new (NULL);
+  priv->found = g_ptr_array_new ();
+  priv->placeholders = g_array_new (FALSE, FALSE, sizeof (SnippetsPlaceholder));
+  priv->commands = g_array_new (FALSE, FALSE, sizeof (SnippetsCommand));
+  priv->line_commands = g_array_new (FALSE, FALSE, sizeof (SnippetsCommand));
+  priv->fuzzy_triggers = FALSE;
+  priv->shell_commands = FALSE;
+  priv->editors = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 static void
@@ -76,20 +209,56 @@ snippets_engine_finalize (SnippetsEngine *engine)
 {
   SnippetsEnginePrivate *priv;
   priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  /* nothing that was saved may be lost when the plugin goes away */
+  snippets_saver_flush (priv->saver);
+  g_object_unref (priv->saver);
+  g_object_unref (priv->stats);
+  
   if (priv->configs != NULL)
     {
       g_list_foreach (priv->configs, (GFunc) g_object_unref, NULL);
       g_list_free (priv->configs);
       priv->configs = NULL;    
     }
+    
+  g_hash_table_destroy (priv->ids);
+  g_object_unref (priv->index);
+  g_object_unref (priv->includes);
+  clear_session (engine);
+  clear_selection (engine);
+  g_object_unref (priv->shell);
+  g_string_free (priv->scratch, TRUE);
+  g_string_free (priv->word, TRUE);
+  g_string_free (priv->line, TRUE);
+  g_string_free (priv->context_class, TRUE);
+  g_string_free (priv->output, TRUE);
+  g_string_free (priv->lines, TRUE);
+  g_ptr_array_free (priv->found, TRUE);
+  g_array_free (priv->placeholders, TRUE);
+  g_array_free (priv->commands, TRUE);
+  g_array_free (priv->line_commands, TRUE);
 
   g_signal_handler_disconnect (priv->codeslayer, priv->editor_added_id);
+  g_signal_handler_disconnect (priv->menu, priv->expand_selection_id);
+  g_signal_handler_disconnect (priv->menu, priv->import_snippets_id);
+  g_signal_handler_disconnect (priv->menu, priv->export_snippets_id);
+  g_signal_handler_disconnect (priv->menu, priv->export_statistics_id);
+  g_signal_handler_disconnect (priv->menu, priv->fuzzy_triggers_id);
+  g_signal_handler_disconnect (priv->menu, priv->shell_commands_id);
+
+  g_hash_table_foreach (priv->editors, (GHFunc) disconnect_editor, engine);
+  g_hash_table_destroy (priv->editors);
+
+  gtk_widget_destroy (priv->preview);
+  g_object_unref (priv->provider);
 
   G_OBJECT_CLASS (snippets_engine_parent_class)->finalize (G_OBJECT(engine));
 }
 
 SnippetsEngine*
-snippets_engine_new (CodeSlayer *codeslayer)
+snippets_engine_new (CodeSlayer *codeslayer, 
+                     GtkWidget  *menu)
 {
   SnippetsEnginePrivate *priv;
   SnippetsEngine *engine;
@@ -100,6 +269,16 @@ snippets_engine_new (CodeSlayer *codeslayer)
   priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
 
   priv->codeslayer = codeslayer;
+  priv->menu = menu;
+  
+  priv->preview = snippets_preview_new ();
+  g_signal_connect_swapped (G_OBJECT (priv->preview), "config-activated",
+                            G_CALLBACK (preview_activated_action), SNIPPETS_ENGINE (engine));
+  
+  priv->provider = snippets_provider_new (codeslayer);
+  snippets_provider_set_index (priv->provider, priv->index);
+  g_signal_connect_swapped (G_OBJECT (priv->provider), "config-activated",
+                            G_CALLBACK (config_activated_action), SNIPPETS_ENGINE (engine));
   
   editors = codeslayer_get_all_editors (codeslayer);
   
@@ -114,9 +293,26 @@ snippets_engine_new (CodeSlayer *codeslayer)
     
   g_list_free (editors);
   
-  priv->editor_added_id = g_signal_connect_swapped (G_OBJECT (codeslayer), "editor-added",
+  priv->editor_added_id = g_signal_connect_swapped (G_OBJECT (codeslayer), "editor-added",
                                                     G_CALLBACK (editor_added_action), SNIPPETS_ENGINE (engine));
 
+  priv->expand_selection_id = g_signal_connect_swapped (G_OBJECT (menu), "expand-selection",
+                                                        G_CALLBACK (expand_selection_action), SNIPPETS_ENGINE (engine));
+
+  priv->import_snippets_id = g_signal_connect_swapped (G_OBJECT (menu), "import-snippets",
+                                                       G_CALLBACK (import_snippets_action), SNIPPETS_ENGINE (engine));
+
+  priv->export_snippets_id = g_signal_connect_swapped (G_OBJECT (menu), "export-snippets",
+                                                       G_CALLBACK (export_snippets_action), SNIPPETS_ENGINE (engine));
+  priv->export_statistics_id = g_signal_connect_swapped (G_OBJECT (menu), "export-statistics",
+                                                         G_CALLBACK (export_statistics_action), SNIPPETS_ENGINE (engine));
+
+  priv->fuzzy_triggers_id = g_signal_connect_swapped (G_OBJECT (menu), "fuzzy-triggers",
+                                                      G_CALLBACK (fuzzy_triggers_action), SNIPPETS_ENGINE (engine));
+
+  priv->shell_commands_id = g_signal_connect_swapped (G_OBJECT (menu), "shell-commands",
+                                                      G_CALLBACK (shell_commands_action), SNIPPETS_ENGINE (engine));
+
   return engine;
 }
 
@@ -124,31 +320,43 @@ void
 snippets_engine_load_configs (SnippetsEngine *engine)
 {
   SnippetsEnginePrivate *priv;
+  GError *error = NULL;
   gchar *file_path;
-  xmlDoc *doc = NULL;
-  xmlNode *root_element = NULL;
+  guint count;
+  gsize saved;
   
   priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  load_settings (engine);
 
   file_path = get_config_file_path (engine);
   if (file_path == NULL) 
     return;
 
-  doc = xmlReadFile (file_path, NULL, 0);
-
-  if (doc == NULL) 
+  priv->configs = snippets_io_load (file_path, &error);
+  
+  if (error != NULL)
     {
-      g_warning ("could not parse snippets file %s\n", file_path);
-      xmlCleanupParser();
-      return;
+      g_warning ("could not load snippets file %s: %s\n", file_path, error->message);
+      g_error_free (error);
+      
+      /* the next save would write over whatever could not be read */
+      if (g_file_test (file_path, G_FILE_TEST_EXISTS))
+        {
+          gchar *broken_path = g_strconcat (file_path, ".broken", NULL);
+          if (g_rename (file_path, broken_path) == 0)
+            g_warning ("kept the unreadable snippets file as %s\n", broken_path);
+          g_free (broken_path);
+        }
     }
 
-  root_element = xmlDocGetRootElement (doc);
-
-  load_configs (root_element, &priv->configs);
+  snippets_config_get_compression (&count, &saved);
+  if (count > 0)
+    g_debug ("%u large snippets kept deflated, saving %" G_GSIZE_FORMAT " bytes", 
+             count, saved);
 
-  xmlFreeDoc (doc);
-  xmlCleanupParser ();
+  rebuild_index (engine);
+  report_conflicts (engine);
   g_free (file_path);
 }
 
@@ -169,11 +377,10 @@ snippets_engine_open_dialog (SnippetsEngine *engine)
     
   if (response == GTK_RESPONSE_OK)
     {
-      g_list_foreach (priv->configs, (GFunc) g_object_unref, NULL);
-      g_list_free (priv->configs);      
-      priv->configs = copies;
-      
-      save_configs (engine);
+      if (apply_configs (engine, copies, 
+                         snippets_dialog_get_changed (SNIPPETS_DIALOG (dialog)),
+                         snippets_dialog_get_removed (SNIPPETS_DIALOG (dialog))))
+        save_configs (engine);
     }
   else
     {
@@ -184,106 +391,312 @@ snippets_engine_open_dialog (SnippetsEngine *engine)
   gtk_widget_destroy (dialog);
 }
 
+/*
+ * The saver writes a copy of the configs on a thread of its own, the
+ * dialog can go away at once.
+ */
 static void
-load_configs (xmlNode *a_node, 
-              GList   **configs)
+save_configs (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  gchar *file_path;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  file_path = get_config_file_path (engine);
+  snippets_saver_save (priv->saver, file_path, priv->configs);
+  g_free (file_path);
+  
+  report_conflicts (engine);
+}
+
+static gchar*
+get_config_file_path (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  gchar *folder_path;
+  gchar *file_path;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+
+  folder_path = codeslayer_get_plugins_config_folder_path (priv->codeslayer);  
+  file_path = g_build_filename (folder_path, "snippets.xml", NULL);
+  g_free (folder_path);
+  
+  return file_path;
+}
+
+static gchar*
+get_settings_file_path (SnippetsEngine *engine)
 {
-  xmlNode *cur_node = NULL;
+  SnippetsEnginePrivate *priv;
+  gchar *folder_path;
+  gchar *file_path;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+
+  folder_path = codeslayer_get_plugins_config_folder_path (priv->codeslayer);  
+  file_path = g_build_filename (folder_path, "snippets.conf", NULL);
+  g_free (folder_path);
+  
+  return file_path;
+}
 
-  for (cur_node = a_node; cur_node; cur_node = cur_node->next) 
+static void
+load_settings (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  GKeyFile *key_file;
+  gchar *file_path;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  file_path = get_settings_file_path (engine);
+  key_file = g_key_file_new ();
+  
+  if (g_key_file_load_from_file (key_file, file_path, G_KEY_FILE_NONE, NULL))
     {
-      if (cur_node->type == XML_ELEMENT_NODE)
-        {
-          if (g_strcmp0 ((gchar*)cur_node->name, "snippet") == 0)
-            {
-              SnippetsConfig *config;
-              xmlChar *file_types;
-              xmlChar *name;
-              xmlChar *text;
-              xmlChar *trigger;
-              
-              config = snippets_config_new ();
-            
-              file_types = xmlGetProp (cur_node, (const xmlChar*)"file_types");
-              name = xmlGetProp (cur_node, (const xmlChar*)"name");
-              trigger = xmlGetProp (cur_node, (const xmlChar*)"trigger");
-              text = xmlNodeGetContent (cur_node);
-              
-              snippets_config_set_file_types (config, (gchar*)file_types);
-              snippets_config_set_name (config, (gchar*)name);
-              snippets_config_set_text (config, (gchar*)text);
-              snippets_config_set_trigger (config, (gchar*)trigger);
-              
-              xmlFree (file_types);
-              xmlFree (name);
-              xmlFree (trigger);
-              xmlFree (text);
-              
-              *configs = g_list_append (*configs, config);
-            }
-        }
-      load_configs (cur_node->children, configs);
+      priv->fuzzy_triggers = g_key_file_get_boolean (key_file, "snippets", 
+                                                     "fuzzy_triggers", NULL);
+      priv->shell_commands = g_key_file_get_boolean (key_file, "snippets", 
+                                                     "shell_commands", NULL);
     }
+  
+  snippets_menu_set_fuzzy_triggers (SNIPPETS_MENU (priv->menu), priv->fuzzy_triggers);
+  snippets_menu_set_shell_commands (SNIPPETS_MENU (priv->menu), priv->shell_commands);
+                                                   
+  g_key_file_free (key_file);
+  g_free (file_path);
 }
 
 static void
-save_configs (SnippetsEngine *engine)
+save_settings (SnippetsEngine *engine)
 {
   SnippetsEnginePrivate *priv;
-  GList *list;
-  xmlDocPtr doc;
-  xmlNodePtr root_node;
+  GKeyFile *key_file;
   gchar *file_path;
+  gchar *data;
+  gsize length;
   
   priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
   
-  file_path = get_config_file_path (engine);
+  file_path = get_settings_file_path (engine);
+  key_file = g_key_file_new ();
+  
+  g_key_file_load_from_file (key_file, file_path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+  g_key_file_set_boolean (key_file, "snippets", "fuzzy_triggers", priv->fuzzy_triggers);
+  g_key_file_set_boolean (key_file, "snippets", "shell_commands", priv->shell_commands);
+  
+  data = g_key_file_to_data (key_file, &length, NULL);
+  g_file_set_contents (file_path, data, length, NULL);
+  
+  g_free (data);
+  g_key_file_free (key_file);
+  g_free (file_path);
+}
+
+static void
+rebuild_index (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  GList *list;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  g_object_unref (priv->index);
+  priv->index = snippets_index_new ();
   
-  doc = xmlNewDoc (BAD_CAST "1.0");
+  g_object_unref (priv->includes);
+  priv->includes = snippets_includes_new ();
   
-  root_node = xmlNewNode (NULL, BAD_CAST "snippets");
-  xmlDocSetRootElement (doc, root_node);
+  snippets_preview_clear_cache (SNIPPETS_PREVIEW (priv->preview));
+  snippets_provider_set_index (priv->provider, priv->index);
+  
+  g_hash_table_remove_all (priv->ids);
+  
+  for (list = priv->configs; list != NULL; list = g_list_next (list))
+    {
+      add_id (engine, list->data);
+      snippets_index_add (priv->index, list->data);
+      snippets_includes_add (priv->includes, list->data);
+    }
+}
+
+/*
+ * The dialog tells which of its copies were added or changed and the ids
+ * of the snippets it removed. Only those go through the index and the
+ * includes and only their renderings and proposals are dropped, the rest
+ * of the originals are kept and the copies let go of. Returns whether
+ * anything changed.
+ */
+static gboolean
+apply_configs (SnippetsEngine *engine,
+               GList          *copies,
+               GPtrArray      *changed,
+               GArray         *removed)
+{
+  SnippetsEnginePrivate *priv;
+  GHashTable *replacements;
+  GList *added = NULL;
+  GList *list;
+  guint i;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  if (changed->len == 0 && removed->len == 0)
+    {
+      g_list_free_full (copies, g_object_unref);
+      return FALSE;
+    }
+  
+  /* maps an original to what takes its place, NULL when it was removed */
+  replacements = g_hash_table_new_full (g_direct_hash, g_direct_equal, 
+                                        g_object_unref, NULL);
+  
+  for (i = 0; i < removed->len; i++)
+    {
+      SnippetsConfig *original;
+      
+      original = g_hash_table_lookup (priv->ids, &g_array_index (removed, guint64, i));
+      if (original == NULL)
+        continue;
+      
+      forget_config (engine, original);
+      g_hash_table_insert (replacements, original, NULL);
+    }
+    
+  for (i = 0; i < changed->len; i++)
+    {
+      SnippetsConfig *copy = g_ptr_array_index (changed, i);
+      SnippetsConfig *original;
+      guint64 id;
+      
+      g_object_ref (copy);
+      
+      id = snippets_config_get_id (copy);
+      original = g_hash_table_lookup (priv->ids, &id);
+      
+      if (original != NULL)
+        {
+          forget_config (engine, original);
+          g_hash_table_insert (replacements, original, copy);
+        }
+      else
+        {
+          added = g_list_prepend (added, copy);
+        }
+      
+      add_id (engine, copy);
+      snippets_index_add (priv->index, copy);
+      snippets_includes_add (priv->includes, copy);
+      snippets_provider_forget (priv->provider, snippets_config_get_trigger (copy));
+    }
+    
+  g_list_free_full (copies, g_object_unref);
   
   list = priv->configs;
   while (list != NULL)
     {
-      SnippetsConfig *config = list->data;
-      xmlNodePtr node, cdata;
-      const gchar *text;
+      GList *next = list->next;
+      gpointer replacement;
       
-      node = xmlNewChild (root_node, NULL, BAD_CAST "snippet", NULL);
-      xmlNewProp(node, BAD_CAST "file_types", BAD_CAST snippets_config_get_file_types (config));
-      xmlNewProp(node, BAD_CAST "name", BAD_CAST snippets_config_get_name (config));
-      xmlNewProp(node, BAD_CAST "trigger", BAD_CAST snippets_config_get_trigger (config));
-      
-      text = snippets_config_get_text (config);
-      cdata = xmlNewCDataBlock (doc, (const xmlChar*)text, g_utf8_strlen (text, -1));
-      xmlAddChild (node, cdata);      
-
-      list = g_list_next (list);
+      if (g_hash_table_lookup_extended (replacements, list->data, NULL, &replacement))
+        {
+          if (replacement != NULL)
+            list->data = replacement;
+          else
+            priv->configs = g_list_delete_link (priv->configs, list);
+        }
+        
+      list = next;
     }
   
-  xmlSaveFormatFileEnc(file_path, doc, "UTF-8", 1);
+  priv->configs = g_list_concat (priv->configs, g_list_reverse (added));
+  
+  g_hash_table_destroy (replacements);
+  
+  return TRUE;
+}
 
-  xmlFreeDoc(doc);
-  xmlCleanupParser();
-  g_free (file_path);
+/*
+ * Takes a config out of everything that looks it up, the caller still
+ * holds it.
+ */
+static void
+forget_config (SnippetsEngine *engine,
+               SnippetsConfig *config)
+{
+  SnippetsEnginePrivate *priv;
+  guint64 id;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  id = snippets_config_get_id (config);
+  
+  snippets_index_remove (priv->index, config);
+  snippets_includes_remove (priv->includes, config);
+  g_hash_table_remove (priv->ids, &id);
+  
+  snippets_preview_forget (SNIPPETS_PREVIEW (priv->preview), config);
+  snippets_provider_forget (priv->provider, snippets_config_get_trigger (config));
 }
 
-static gchar*
-get_config_file_path (SnippetsEngine *engine)
+/*
+ * Maps the id of the config to the config, the key is the id inside the
+ * config itself. An id that is already taken, say by a snippet imported
+ * twice, is given up for a new one before it becomes a key.
+ */
+static void
+add_id (SnippetsEngine *engine,
+        SnippetsConfig *config)
 {
   SnippetsEnginePrivate *priv;
-  gchar *folder_path;
-  gchar *file_path;
+  guint64 id;
   
   priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  id = snippets_config_get_id (config);
+  
+  while (g_hash_table_contains (priv->ids, &id))
+    {
+      snippets_config_renew_id (config);
+      id = snippets_config_get_id (config);
+    }
+    
+  g_hash_table_insert (priv->ids, (gpointer) snippets_config_peek_id (config), config);
+}
 
-  folder_path = codeslayer_get_plugins_config_folder_path (priv->codeslayer);  
-  file_path = g_build_filename (folder_path, "snippets.xml", NULL);
-  g_free (folder_path);
+/*
+ * The index already knows which triggers are taken more than once, so
+ * this stays cheap for a large library.
+ */
+static void
+report_conflicts (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  GArray *conflicts;
+  guint i;
   
-  return file_path;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  conflicts = snippets_index_get_conflicts (priv->index, NULL);
+  
+  for (i = 0; i < conflicts->len; i++)
+    {
+      SnippetsConflict *conflict = &g_array_index (conflicts, SnippetsConflict, i);
+      const gchar *trigger = snippets_config_get_trigger (conflict->winner);
+      
+      if (conflict->shadowed)
+        g_warning ("snippet trigger %s for %s is shadowed by the one for %s\n", trigger,
+                   snippets_config_get_file_types (conflict->loser),
+                   snippets_config_get_file_types (conflict->winner));
+      else
+        g_warning ("snippet trigger %s for %s comes after the one for %s\n", trigger,
+                   snippets_config_get_file_types (conflict->loser),
+                   snippets_config_get_file_types (conflict->winner));
+    }
+  
+  g_array_free (conflicts, TRUE);
 }
 
 static GList*
@@ -299,58 +712,98 @@ get_configs_deep_copy (SnippetsEngine *engine)
 
   while (list != NULL)
     {
-      SnippetsConfig *config = list->data;
-      SnippetsConfig *copy;
-      const gchar *file_types;
-      const gchar *name;
-      const gchar *trigger;
-      const gchar *text;
-
-      file_types = snippets_config_get_file_types (config);
-      name = snippets_config_get_name (config);
-      trigger = snippets_config_get_trigger (config);
-      text = snippets_config_get_text (config);
-      
-      copy = snippets_config_new ();
-      snippets_config_set_file_types (copy, file_types);
-      snippets_config_set_name (copy, name);
-      snippets_config_set_trigger (copy, trigger);
-      snippets_config_set_text (copy, text);
-      results = g_list_prepend (results, copy);
-      
+      results = g_list_prepend (results, snippets_config_copy (list->data));
       list = g_list_next (list);
     }
     
-  return results;    
+  return g_list_reverse (results);    
 }
 
 static void 
 editor_added_action (SnippetsEngine   *engine, 
                      CodeSlayerEditor *editor)
 {  
-  g_signal_connect (G_OBJECT (editor), "key-press-event",
-                    G_CALLBACK (key_press_action), engine);  
+  SnippetsEnginePrivate *priv;
+  gulong handler_id;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  if (g_hash_table_lookup (priv->editors, editor) != NULL)
+    return;
+
+  handler_id = g_signal_connect (G_OBJECT (editor), "key-press-event",
+                                 G_CALLBACK (key_press_action), engine);
+                                 
+  gtk_source_completion_add_provider (gtk_source_view_get_completion (GTK_SOURCE_VIEW (editor)),
+                                      GTK_SOURCE_COMPLETION_PROVIDER (priv->provider), NULL);
+                                 
+  g_hash_table_insert (priv->editors, editor, GUINT_TO_POINTER (handler_id));
+
+  /* the editor takes its handlers with it, we only need to forget about it */
+  g_object_weak_ref (G_OBJECT (editor), (GWeakNotify) editor_removed_action, engine);
+}
+
+static void 
+editor_removed_action (SnippetsEngine *engine, 
+                       GObject        *editor)
+{
+  SnippetsEnginePrivate *priv;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  g_hash_table_remove (priv->editors, editor);
+}
+
+static void 
+disconnect_editor (CodeSlayerEditor *editor,
+                   gpointer          handler_id,
+                   SnippetsEngine   *engine)
+{
+  SnippetsEnginePrivate *priv;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  g_signal_handler_disconnect (editor, GPOINTER_TO_UINT (handler_id));
+  gtk_source_completion_remove_provider (gtk_source_view_get_completion (GTK_SOURCE_VIEW (editor)),
+                                         GTK_SOURCE_COMPLETION_PROVIDER (priv->provider), NULL);
+  g_object_weak_unref (G_OBJECT (editor), (GWeakNotify) editor_removed_action, engine);
 }
 
+/*
+ * When more than one snippet answers to the trigger the preview is put up
+ * so the right one can be picked, the preview then gets the keys first.
+ * The word, the matches and the rendering all go through buffers kept on
+ * the engine, so a plain expansion does not allocate once they grew.
+ */
 static gboolean
 key_press_action (CodeSlayerEditor *editor,
                   GdkEventKey      *event, 
                   SnippetsEngine   *engine)
 {
+  SnippetsEnginePrivate *priv;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+
+  if (snippets_preview_key_press (SNIPPETS_PREVIEW (priv->preview), event))
+    return TRUE;
+    
+  /* the preview is down, whatever lines it was showing for are done with */
+  clear_selection (engine);
+    
+  if (priv->session != NULL && !snippets_session_is_active (priv->session))
+    clear_session (engine);
+    
+  if (priv->session != NULL && 
+      snippets_session_key_press (priv->session, 
+                                  gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor)), event))
+    return TRUE;
+
   if (event->keyval == GDK_KEY_Tab)
     {
-      SnippetsEnginePrivate *priv;
       CodeSlayerDocument *document;
       const gchar *file_path;
       GtkTextBuffer *buffer;
       GtkTextMark *insert_mark;
       GtkTextIter iter;
       GtkTextIter start;
-      gchar *word;
-      GList *list;
+      GPtrArray *configs;
       
-      priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
-
       document = codeslayer_get_active_editor_document (priv->codeslayer);
       file_path = codeslayer_document_get_file_path (document);
 
@@ -360,65 +813,822 @@ key_press_action (CodeSlayerEditor *editor,
       gtk_text_buffer_get_iter_at_mark (buffer, &iter, insert_mark);
       
       start = iter;
-      move_iter_word_start (&start);
+      snippets_text_move_word_start (&start);
       
-      word = gtk_text_iter_get_text (&start, &iter);
+      snippets_text_copy (&start, &iter, priv->word);
+      configs = find_configs (engine, priv->word->str, file_path, buffer, &start);
       
-      if (!codeslayer_utils_has_text (word))
-        return FALSE;
+      if (configs->len == 0 && priv->fuzzy_triggers)
+        {
+          SnippetsConfig *config;
+          config = snippets_index_lookup_fuzzy (priv->index, priv->word->str, file_path);
+          if (config != NULL && in_context (engine, config, buffer, &start))
+            g_ptr_array_add (configs, config);
+        }
+        
+      if (configs->len == 0)
+        {
+          if (expand_pattern (engine, GTK_TEXT_VIEW (editor), file_path))
+            return TRUE;
+          record_misses (engine, priv->word->str, file_path);
+          return FALSE;
+        }
 
-      list = priv->configs;
-      while (list != NULL)
+      if (configs->len > 1)
         {
-          SnippetsConfig *config = list->data;
-          const gchar *file_types;
-          const gchar *trigger;
-          GList *elements;
-          
-          file_types = snippets_config_get_file_types (config);
-          
-          elements = codeslayer_utils_string_to_list (file_types);
-          
-          if (!codeslayer_utils_contains_element_with_suffix (elements, file_path))
-            {
-              g_list_foreach (elements, (GFunc) g_free, NULL);
-              g_list_free (elements);
-              list = g_list_next (list);
-              continue;
-            }
+          SnippetsTemplateContext context;
+          GList *list = NULL;
+          guint i;
           
-          trigger = snippets_config_get_trigger (config);
-          if (g_strcmp0 (word, trigger) == 0)
-            {
-              const gchar *text;
-              text = snippets_config_get_text (config);
-
-              gtk_text_buffer_begin_user_action (buffer);
-              gtk_text_buffer_delete (buffer, &start, &iter);
-              gtk_text_buffer_insert (buffer, &start, text, -1);
-              gtk_text_buffer_end_user_action (buffer);
-              return TRUE;
-            }
-
-          list = g_list_next (list);
+          for (i = configs->len; i > 0; i--)
+            list = g_list_prepend (list, g_ptr_array_index (configs, i - 1));
+            
+          context.file_path = file_path;
+          context.matches = NULL;
+          context.selection = NULL;
+          snippets_preview_show (SNIPPETS_PREVIEW (priv->preview), 
+                                 GTK_TEXT_VIEW (editor), list, &context);
+          g_list_free (list);
+        }
+      else
+        {
+          expand_at_cursor (engine, GTK_TEXT_VIEW (editor), 
+                            g_ptr_array_index (configs, 0), file_path);
         }
+
+      return TRUE;
     }
   
   return FALSE;
 }
 
+/*
+ * The snippets for the file that use ${selection} are offered in the
+ * preview, or all of the snippets for the file when none of them do. The
+ * lines are kept as marks while the preview is up, see expand_selection.
+ */
 static void
-move_iter_word_start (GtkTextIter *iter)
+expand_selection_action (SnippetsEngine *engine)
 {
-  gunichar ctext;
-  gtk_text_iter_backward_char (iter);
-  ctext = gtk_text_iter_get_char (iter);
+  SnippetsEnginePrivate *priv;
+  CodeSlayerEditor *editor;
+  CodeSlayerDocument *document;
+  const SnippetsFileTypeSet *set;
+  const gchar *file_path;
+  GtkTextBuffer *buffer;
+  SnippetsTemplateContext context;
+  GtkTextIter start;
+  GtkTextIter end;
+  GList *applicable = NULL;
+  GList *selecting = NULL;
+  GList *list;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  editor = codeslayer_get_active_editor (priv->codeslayer);
+  if (editor == NULL)
+    return;
+
+  document = codeslayer_get_active_editor_document (priv->codeslayer);
+  file_path = codeslayer_document_get_file_path (document);
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor));
   
-  while (g_ascii_isalnum (ctext) || ctext == '_')
+  if (!gtk_text_buffer_get_selection_bounds (buffer, &start, &end))
+    return;
+    
+  set = snippets_index_get_file_types (priv->index, file_path);
+    
+  for (list = priv->configs; list != NULL; list = g_list_next (list))
+    {
+      SnippetsConfig *config = list->data;
+      
+      if (!snippets_file_types_intersect (snippets_config_get_file_type_set (config), set))
+        continue;
+        
+      applicable = g_list_prepend (applicable, config);
+      if (strstr (snippets_config_get_expansion (config, priv->scratch), "${selection}") != NULL)
+        selecting = g_list_prepend (selecting, config);
+    }
+    
+  if (selecting != NULL)
     {
-      gtk_text_iter_backward_char (iter);
-      ctext = gtk_text_iter_get_char (iter);
+      g_list_free (applicable);
+      applicable = selecting;
     }
     
-  gtk_text_iter_forward_char (iter);    
+  if (applicable == NULL)
+    return;
+    
+  applicable = g_list_reverse (applicable);
+  
+  clear_selection (engine);
+  priv->selection_start = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, &start, TRUE));
+  priv->selection_end = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE));
+  
+  context.file_path = file_path;
+  context.matches = NULL;
+  context.selection = NULL;
+  snippets_preview_show (SNIPPETS_PREVIEW (priv->preview), 
+                         GTK_TEXT_VIEW (editor), applicable, &context);
+  g_list_free (applicable);
 }
+
+/*
+ * The snippet is rendered once for each of the selected lines with the
+ * line as ${selection}, and the whole lines are then replaced with one
+ * insert. Tab stops are left as their defaults, there is no session
+ * that could walk them across several lines.
+ */
+static void
+expand_selection (SnippetsEngine *engine,
+                  SnippetsConfig *config)
+{
+  SnippetsEnginePrivate *priv;
+  CodeSlayerDocument *document;
+  SnippetsTemplateContext context;
+  const gchar *expansion;
+  GtkTextBuffer *buffer;
+  GtkTextIter start;
+  GtkTextIter end;
+  GString *output;
+  GArray *commands;
+  glong length = 0;
+  gint first_line;
+  gint last_line;
+  gint line;
+  gint offset;
+  guint i;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  /* the editor may have been closed while the preview was up */
+  buffer = gtk_text_mark_get_buffer (priv->selection_start);
+  if (buffer == NULL)
+    {
+      clear_selection (engine);
+      return;
+    }
+    
+  gtk_text_buffer_get_iter_at_mark (buffer, &start, priv->selection_start);
+  gtk_text_buffer_get_iter_at_mark (buffer, &end, priv->selection_end);
+  clear_selection (engine);
+  
+  first_line = gtk_text_iter_get_line (&start);
+  last_line = gtk_text_iter_get_line (&end);
+  
+  /* a selection ending at the start of a line does not include that line */
+  if (last_line > first_line && gtk_text_iter_starts_line (&end))
+    last_line--;
+    
+  gtk_text_buffer_get_iter_at_line (buffer, &start, first_line);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, last_line);
+  if (!gtk_text_iter_ends_line (&end))
+    gtk_text_iter_forward_to_line_end (&end);
+  
+  document = codeslayer_get_active_editor_document (priv->codeslayer);
+  
+  context.file_path = codeslayer_document_get_file_path (document);
+  context.matches = NULL;
+  context.cache = snippets_shell_get_cache (priv->shell);
+  context.commands = priv->shell_commands ? priv->commands : NULL;
+  
+  expansion = snippets_config_get_expansion (config, priv->scratch);
+  output = priv->lines;
+  commands = priv->line_commands;
+  g_string_truncate (output, 0);
+  g_array_set_size (commands, 0);
+  
+  for (line = first_line; line <= last_line; line++)
+    {
+      GtkTextIter line_start;
+      GtkTextIter line_end;
+      
+      gtk_text_buffer_get_iter_at_line (buffer, &line_start, line);
+      line_end = line_start;
+      if (!gtk_text_iter_ends_line (&line_end))
+        gtk_text_iter_forward_to_line_end (&line_end);
+        
+      snippets_text_copy (&line_start, &line_end, priv->line);
+      context.selection = priv->line->str;
+      
+      /* the command offsets come back in characters of this line alone */
+      g_array_set_size (priv->commands, 0);
+      snippets_template_render_to (expansion, &context, priv->placeholders, priv->output);
+      
+      if (line > first_line)
+        {
+          g_string_append_c (output, '\n');
+          length++;
+        }
+      
+      for (i = 0; i < priv->commands->len; i++)
+        {
+          SnippetsCommand command = g_array_index (priv->commands, SnippetsCommand, i);
+          command.offset += length;
+          g_array_append_val (commands, command);
+        }
+      
+      /* a running count, so each line is only counted the once */
+      g_string_append_len (output, priv->output->str, priv->output->len);
+      length += g_utf8_strlen (priv->output->str, priv->output->len);
+    }
+  
+  clear_session (engine);
+  gtk_text_buffer_begin_user_action (buffer);
+  
+  gtk_text_buffer_delete (buffer, &start, &end);
+  offset = gtk_text_iter_get_offset (&start);
+  gtk_text_buffer_insert (buffer, &start, output->str, output->len);
+  snippets_stats_record_expansion (priv->stats, config, context.file_path, output->len);
+  
+  for (i = 0; i < commands->len; i++)
+    {
+      SnippetsCommand *command;
+      GtkTextIter iter;
+      
+      command = &g_array_index (commands, SnippetsCommand, i);
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset + command->offset);
+      snippets_shell_run (priv->shell, buffer, &iter, command, context.file_path);
+      g_free (command->command);
+    }
+  
+  gtk_text_buffer_end_user_action (buffer);
+  
+  g_array_set_size (priv->commands, 0);
+  g_array_set_size (commands, 0);
+}
+
+static void
+clear_selection (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  if (priv->selection_start != NULL)
+    {
+      GtkTextBuffer *buffer = gtk_text_mark_get_buffer (priv->selection_start);
+      if (buffer != NULL)
+        {
+          gtk_text_buffer_delete_mark (buffer, priv->selection_start);
+          gtk_text_buffer_delete_mark (buffer, priv->selection_end);
+        }
+      g_object_unref (priv->selection_start);
+      g_object_unref (priv->selection_end);
+      priv->selection_start = NULL;
+      priv->selection_end = NULL;
+    }
+}
+
+static void
+import_snippets_action (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  gchar *file_path;
+  guint count;
+  GError *error = NULL;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  file_path = choose_library_file (GTK_FILE_CHOOSER_ACTION_OPEN);
+  if (file_path == NULL)
+    return;
+    
+  count = snippets_io_import (file_path, (GFunc) import_configs, engine, &error);
+  
+  if (error != NULL)
+    {
+      g_warning ("could not import snippets file %s: %s\n", file_path, error->message);
+      g_error_free (error);
+    }
+
+  if (count > 0)
+    {
+      snippets_preview_clear_cache (SNIPPETS_PREVIEW (priv->preview));
+      snippets_provider_set_index (priv->provider, priv->index);
+      save_configs (engine);
+    }
+    
+  g_free (file_path);
+}
+
+/*
+ * Takes in a chunk of the snippets being imported as it is read.
+ */
+static void
+import_configs (GList          *configs,
+                SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  GList *list;
+
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+
+  for (list = configs; list != NULL; list = g_list_next (list))
+    {
+      add_id (engine, list->data);
+      snippets_index_add (priv->index, list->data);
+      snippets_includes_add (priv->includes, list->data);
+    }
+
+  priv->configs = g_list_concat (priv->configs, configs);
+}
+
+static void
+export_snippets_action (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  gchar *file_path;
+  GError *error = NULL;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  file_path = choose_library_file (GTK_FILE_CHOOSER_ACTION_SAVE);
+  if (file_path == NULL)
+    return;
+    
+  if (!snippets_io_export (file_path, priv->configs, &error))
+    {
+      g_warning ("could not export snippets file %s: %s\n", file_path, error->message);
+      g_error_free (error);
+    }
+    
+  g_free (file_path);
+}
+
+/*
+ * The statistics go next to the library, each export replaces the last.
+ */
+static void
+export_statistics_action (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  gchar *folder_path;
+  gchar *file_path;
+  GError *error = NULL;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  folder_path = codeslayer_get_plugins_config_folder_path (priv->codeslayer);  
+  file_path = g_build_filename (folder_path, "snippets-stats.csv", NULL);
+  
+  if (!snippets_stats_export (priv->stats, priv->configs, file_path, &error))
+    {
+      g_warning ("could not export snippets statistics %s: %s\n", file_path, error->message);
+      g_clear_error (&error);
+    }
+    
+  g_free (file_path);
+  
+  file_path = g_build_filename (folder_path, "snippets-compression.csv", NULL);
+  
+  if (!snippets_stats_export_compression (file_path, &error))
+    {
+      g_warning ("could not export snippets compression %s: %s\n", file_path, error->message);
+      g_error_free (error);
+    }
+    
+  g_free (folder_path);
+  g_free (file_path);
+}
+
+static gchar*
+choose_library_file (GtkFileChooserAction action)
+{
+  GtkWidget *dialog;
+  GtkFileFilter *filter;
+  gchar *file_path = NULL;
+  
+  dialog = gtk_file_chooser_dialog_new (action == GTK_FILE_CHOOSER_ACTION_OPEN ? 
+                                        _("Import Snippets") : _("Export Snippets"), 
+                                        NULL, action,
+                                        GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                        action == GTK_FILE_CHOOSER_ACTION_OPEN ? 
+                                        GTK_STOCK_OPEN : GTK_STOCK_SAVE, GTK_RESPONSE_OK,
+                                        NULL);
+                                        
+  gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (dialog), TRUE);
+
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("Snippets (*.jsonl, *.snippets, *.code-snippets, *.json, *.tmSnippet)"));
+  gtk_file_filter_add_pattern (filter, "*.jsonl");
+  gtk_file_filter_add_pattern (filter, "*.snippets");
+  gtk_file_filter_add_pattern (filter, "*.code-snippets");
+  gtk_file_filter_add_pattern (filter, "*.json");
+  gtk_file_filter_add_pattern (filter, "*.tmSnippet");
+  gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_OK)
+    file_path = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+    
+  gtk_widget_destroy (dialog);
+  
+  return file_path;
+}
+
+/*
+ * The snippets for the trigger that may expand at the iter. The context
+ * classes are only looked at once a trigger has matched, so ordinary
+ * typing never pays for them. The snippets found are left in an array
+ * kept on the engine, it is only good until the next lookup.
+ */
+static GPtrArray*
+find_configs (SnippetsEngine *engine, 
+              const gchar    *word, 
+              const gchar    *file_path,
+              GtkTextBuffer  *buffer,
+              GtkTextIter    *iter)
+{
+  SnippetsEnginePrivate *priv;
+  guint i = 0;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  g_ptr_array_set_size (priv->found, 0);
+  snippets_index_lookup_all (priv->index, word, file_path, priv->found);
+  
+  while (i < priv->found->len)
+    {
+      SnippetsConfig *config = g_ptr_array_index (priv->found, i);
+      
+      if (in_context (engine, config, buffer, iter))
+        {
+          i++;
+          continue;
+        }
+        
+      g_ptr_array_remove_index (priv->found, i);
+    }
+  
+  return priv->found;
+}
+
+/*
+ * Only a word that is the trigger of some snippet counts as a miss, for
+ * each snippet under it and once for the file type. Any other word is
+ * just a tab.
+ */
+static void
+record_misses (SnippetsEngine *engine,
+               const gchar    *word,
+               const gchar    *file_path)
+{
+  SnippetsEnginePrivate *priv;
+  guint i;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  g_ptr_array_set_size (priv->found, 0);
+  snippets_index_lookup_trigger (priv->index, word, priv->found);
+  
+  if (priv->found->len == 0)
+    return;
+  
+  for (i = 0; i < priv->found->len; i++)
+    snippets_stats_record_miss (priv->stats, g_ptr_array_index (priv->found, i), file_path);
+    
+  snippets_stats_record_miss (priv->stats, NULL, file_path);
+  g_ptr_array_set_size (priv->found, 0);
+}
+
+/*
+ * A snippet with contexts such as "comment" only expands inside one of
+ * them, and one with "!string" never expands inside a string.
+ */
+static gboolean
+in_context (SnippetsEngine *engine,
+            SnippetsConfig *config,
+            GtkTextBuffer  *buffer,
+            GtkTextIter    *iter)
+{
+  SnippetsEnginePrivate *priv;
+  const gchar *contexts;
+  GtkTextIter line_start;
+  gboolean required = FALSE;
+  gboolean included = FALSE;
+  gboolean excluded = FALSE;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  contexts = snippets_config_get_contexts (config);
+  if (!codeslayer_utils_has_text (contexts))
+    return TRUE;
+    
+  line_start = *iter;
+  gtk_text_iter_set_line_offset (&line_start, 0);
+  gtk_source_buffer_ensure_highlight (GTK_SOURCE_BUFFER (buffer), &line_start, iter);
+  
+  /* each class is copied out of the list into a buffer that is kept around */
+  while (!excluded)
+    {
+      const gchar *end = strchr (contexts, ',');
+      const gchar *next;
+      const gchar *context_class;
+      
+      if (end == NULL)
+        end = contexts + strlen (contexts);
+      next = end;
+      
+      while (contexts < end && g_ascii_isspace (*contexts))
+        contexts++;
+      while (end > contexts && g_ascii_isspace (end[-1]))
+        end--;
+        
+      g_string_truncate (priv->context_class, 0);
+      g_string_append_len (priv->context_class, contexts, end - contexts);
+      context_class = priv->context_class->str;
+      
+      if (*context_class == '!')
+        {
+          excluded = gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (buffer), 
+                                                               iter, context_class + 1);
+        }
+      else if (*context_class != '\0')
+        {
+          required = TRUE;
+          if (gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (buffer), 
+                                                        iter, context_class))
+            included = TRUE;
+        }
+        
+      if (*next == '\0')
+        break;
+        
+      contexts = next + 1;
+    }
+  
+  return !excluded && (included || !required);
+}
+
+static void
+fuzzy_triggers_action (SnippetsEngine *engine,
+                       gboolean        fuzzy_triggers)
+{
+  SnippetsEnginePrivate *priv;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  priv->fuzzy_triggers = fuzzy_triggers;
+  save_settings (engine);
+}
+
+/*
+ * Any snippet can name a command, including ones imported from elsewhere,
+ * so nothing is run until it is turned on. Until then the commands are
+ * left in the text as they were written.
+ */
+static void
+shell_commands_action (SnippetsEngine *engine,
+                       gboolean        shell_commands)
+{
+  SnippetsEnginePrivate *priv;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  priv->shell_commands = shell_commands;
+  save_settings (engine);
+}
+
+static void
+config_activated_action (SnippetsEngine *engine,
+                         SnippetsConfig *config)
+{
+  SnippetsEnginePrivate *priv;
+  CodeSlayerEditor *editor;
+  CodeSlayerDocument *document;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  editor = codeslayer_get_active_editor (priv->codeslayer);
+  if (editor == NULL)
+    return;
+
+  document = codeslayer_get_active_editor_document (priv->codeslayer);
+  expand_at_cursor (engine, GTK_TEXT_VIEW (editor), config, 
+                    codeslayer_document_get_file_path (document));
+}
+
+/*
+ * The preview is either choosing between snippets that share a trigger or
+ * choosing the snippet for the selected lines.
+ */
+static void
+preview_activated_action (SnippetsEngine *engine,
+                          SnippetsConfig *config)
+{
+  SnippetsEnginePrivate *priv;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  if (priv->selection_start != NULL)
+    expand_selection (engine, config);
+  else
+    config_activated_action (engine, config);
+}
+
+static void
+expand_at_cursor (SnippetsEngine *engine,
+                  GtkTextView    *text_view,
+                  SnippetsConfig *config,
+                  const gchar    *file_path)
+{
+  SnippetsTemplateContext context;
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GtkTextIter start;
+  
+  buffer = gtk_text_view_get_buffer (text_view);
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+      
+  start = iter;
+  snippets_text_move_word_start (&start);
+  
+  context.file_path = file_path;
+  context.matches = NULL;
+  context.selection = NULL;
+  
+  expand_range (engine, buffer, &start, &iter, config, &context);
+}
+
+/*
+ * Only tried when no literal trigger matched, the text from the start of
+ * the line up to the cursor is run through all the patterns at once.
+ */
+static gboolean
+expand_pattern (SnippetsEngine *engine,
+                GtkTextView    *text_view,
+                const gchar    *file_path)
+{
+  SnippetsEnginePrivate *priv;
+  SnippetsTemplateContext context;
+  SnippetsConfig *config;
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GtkTextIter start;
+  gchar **matches = NULL;
+  gint match_start;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  buffer = gtk_text_view_get_buffer (text_view);
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+  
+  start = iter;
+  gtk_text_iter_set_line_offset (&start, 0);
+  
+  snippets_text_copy (&start, &iter, priv->line);
+  config = snippets_index_lookup_pattern (priv->index, priv->line->str, file_path, 
+                                          &match_start, &matches);
+  
+  if (config != NULL)
+    gtk_text_iter_forward_chars (&start, g_utf8_pointer_to_offset (priv->line->str, 
+                                                                   priv->line->str + match_start));
+  
+  if (config == NULL || !in_context (engine, config, buffer, &start))
+    {
+      g_strfreev (matches);
+      return FALSE;
+    }
+    
+  context.file_path = file_path;
+  context.matches = matches;
+  context.selection = NULL;
+  
+  expand_range (engine, buffer, &start, &iter, config, &context);
+  
+  g_strfreev (matches);
+  
+  return TRUE;
+}
+
+static void
+expand_range (SnippetsEngine          *engine,
+              GtkTextBuffer           *buffer,
+              GtkTextIter             *start,
+              GtkTextIter             *end,
+              SnippetsConfig          *config,
+              SnippetsTemplateContext *context)
+{
+  SnippetsEnginePrivate *priv;
+  gint offset;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  offset = gtk_text_iter_get_offset (start);
+
+  clear_session (engine);
+  gtk_text_buffer_begin_user_action (buffer);
+  expand_config (engine, buffer, start, end, config, context);
+  
+  /* the session keeps the user action open until the last tab stop */
+  if (has_tab_stops (priv->placeholders))
+    {
+      priv->session = snippets_session_new (buffer, offset, priv->placeholders);
+    }
+  else
+    {
+      select_placeholder (buffer, offset, priv->placeholders);
+      gtk_text_buffer_end_user_action (buffer);
+    }
+}
+
+/*
+ * The snippet goes in at once. Any commands in it are started after that
+ * and fill in their output where they stood whenever they are done.
+ */
+static void
+expand_config (SnippetsEngine          *engine,
+               GtkTextBuffer           *buffer, 
+               GtkTextIter             *start,
+               GtkTextIter             *end,
+               SnippetsConfig          *config,
+               SnippetsTemplateContext *context)
+{
+  SnippetsEnginePrivate *priv;
+  gint offset;
+  guint i;
+  
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  
+  g_array_set_size (priv->commands, 0);
+  context->cache = snippets_shell_get_cache (priv->shell);
+  context->commands = priv->shell_commands ? priv->commands : NULL;
+
+  snippets_template_render_to (snippets_config_get_expansion (config, priv->scratch), 
+                               context, priv->placeholders, priv->output);
+  gtk_text_buffer_delete (buffer, start, end);
+  offset = gtk_text_iter_get_offset (start);
+  gtk_text_buffer_insert (buffer, start, priv->output->str, priv->output->len);
+  snippets_stats_record_expansion (priv->stats, config, context->file_path, priv->output->len);
+  
+  for (i = 0; i < priv->commands->len; i++)
+    {
+      SnippetsCommand *command;
+      GtkTextIter iter;
+      
+      command = &g_array_index (priv->commands, SnippetsCommand, i);
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, offset + command->offset);
+      snippets_shell_run (priv->shell, buffer, &iter, command, context->file_path);
+      g_free (command->command);
+    }
+    
+  g_array_set_size (priv->commands, 0);
+  context->commands = NULL;
+}
+
+static gboolean
+has_tab_stops (GArray *placeholders)
+{
+  guint i;
+  
+  for (i = 0; i < placeholders->len; i++)
+    {
+      if (g_array_index (placeholders, SnippetsPlaceholder, i).index > 0)
+        return TRUE;
+    }
+    
+  return FALSE;
+}
+
+static void
+clear_session (SnippetsEngine *engine)
+{
+  SnippetsEnginePrivate *priv;
+  priv = SNIPPETS_ENGINE_GET_PRIVATE (engine);
+  if (priv->session != NULL)
+    {
+      g_object_unref (priv->session);
+      priv->session = NULL;
+    }
+}
+
+/*
+ * Select the first tab stop of the expansion, or put the cursor on $0.
+ */
+static void
+select_placeholder (GtkTextBuffer *buffer,
+                    gint           offset,
+                    GArray        *placeholders)
+{
+  SnippetsPlaceholder *first = NULL;
+  GtkTextIter start;
+  GtkTextIter end;
+  guint i;
+  
+  for (i = 0; i < placeholders->len; i++)
+    {
+      SnippetsPlaceholder *placeholder;
+      placeholder = &g_array_index (placeholders, SnippetsPlaceholder, i);
+      
+      if (first == NULL || 
+          (placeholder->index > 0 && (first->index == 0 || placeholder->index < first->index)))
+        first = placeholder;
+    }
+    
+  if (first == NULL)
+    return;
+    
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, offset + first->offset);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, offset + first->offset + first->length);
+  gtk_text_buffer_select_range (buffer, &end, &start);
+}
+
+/*
+ * The same text gtk_text_iter_get_text gives, only into a buffer that is
+ * kept from one key press to the next.
+ */
\ No newline at end of file
@@ -45,7 +45,8 @@ struct _SnippetsEngineClass
 
 GType snippets_engine_get_type (void) G_GNUC_CONST;
 
-SnippetsEngine*  snippets_engine_new           (CodeSlayer     *codeslayer);
+SnippetsEngine*  snippets_engine_new           (CodeSlayer     *codeslayer, 
+                                                GtkWidget      *menu);
                                         
 void             snippets_engine_load_configs  (SnippetsEngine *engine);
 
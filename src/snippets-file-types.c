@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-file-types.h"
+
+/*
+ * The numbers are handed out for as long as the editor runs and only
+ * ever grow. The generation goes up with each new one, so anything that
+ * keeps the set of a document knows when to work it out again. This is
+ * only touched from the main loop.
+ */
+
+static SnippetsFileTypeSet* set_new  (guint        n_bits);
+static void set_bit                  (SnippetsFileTypeSet *set,
+                                      guint        bit);
+
+static GHashTable *numbers = NULL;
+static GPtrArray *names = NULL;
+static guint generation = 0;
+
+/*
+ * The set for a comma separated list of file types, any file type not
+ * seen before is numbered on the way.
+ */
+SnippetsFileTypeSet*
+snippets_file_types_intern (const gchar *file_types)
+{
+  SnippetsFileTypeSet *set;
+  GArray *bits;
+  guint i;
+
+  if (numbers == NULL)
+    {
+      numbers = g_hash_table_new (g_str_hash, g_str_equal);
+      names = g_ptr_array_new ();
+    }
+
+  bits = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  while (file_types != NULL)
+    {
+      const gchar *start = file_types;
+      const gchar *end = strchr (file_types, ',');
+      gpointer number;
+      gchar *name;
+
+      if (end == NULL)
+        end = file_types + strlen (file_types);
+      file_types = *end == ',' ? end + 1 : NULL;
+
+      while (start < end && g_ascii_isspace (*start))
+        start++;
+      while (end > start && g_ascii_isspace (end[-1]))
+        end--;
+
+      if (end == start)
+        continue;
+
+      name = g_strndup (start, end - start);
+
+      number = g_hash_table_lookup (numbers, name);
+      if (number == NULL)
+        {
+          g_ptr_array_add (names, name);
+          number = GUINT_TO_POINTER (names->len);
+          g_hash_table_insert (numbers, name, number);
+          generation++;
+        }
+      else
+        {
+          g_free (name);
+        }
+
+      i = GPOINTER_TO_UINT (number) - 1;
+      g_array_append_val (bits, i);
+    }
+
+  set = set_new (names->len);
+  for (i = 0; i < bits->len; i++)
+    set_bit (set, g_array_index (bits, guint, i));
+
+  g_array_free (bits, TRUE);
+
+  return set;
+}
+
+/*
+ * The set of every file type the path ends in, so "a.tar.gz" gets both
+ * ".gz" and ".tar.gz" if the library names them.
+ */
+SnippetsFileTypeSet*
+snippets_file_types_match (const gchar *file_path)
+{
+  SnippetsFileTypeSet *set;
+  gsize path_length;
+  guint i;
+
+  set = set_new (names != NULL ? names->len : 0);
+
+  if (file_path == NULL || names == NULL)
+    return set;
+
+  path_length = strlen (file_path);
+
+  for (i = 0; i < names->len; i++)
+    {
+      const gchar *name = g_ptr_array_index (names, i);
+      gsize length = strlen (name);
+
+      if (length <= path_length && 
+          strcmp (file_path + path_length - length, name) == 0)
+        set_bit (set, i);
+    }
+
+  return set;
+}
+
+SnippetsFileTypeSet*
+snippets_file_types_copy (const SnippetsFileTypeSet *set)
+{
+  SnippetsFileTypeSet *copy;
+  copy = g_slice_new (SnippetsFileTypeSet);
+  copy->n_words = set->n_words;
+  copy->words = g_new (guint64, set->n_words);
+  memcpy (copy->words, set->words, set->n_words * sizeof (guint64));
+  return copy;
+}
+
+void
+snippets_file_types_free (SnippetsFileTypeSet *set)
+{
+  if (set == NULL)
+    return;
+  g_free (set->words);
+  g_slice_free (SnippetsFileTypeSet, set);
+}
+
+/*
+ * Sets made before more file types were numbered are just shorter, the
+ * bits they lack are all clear.
+ */
+gboolean
+snippets_file_types_intersect (const SnippetsFileTypeSet *a,
+                               const SnippetsFileTypeSet *b)
+{
+  guint n_words;
+  guint i;
+
+  n_words = MIN (a->n_words, b->n_words);
+
+  for (i = 0; i < n_words; i++)
+    {
+      if ((a->words[i] & b->words[i]) != 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Whether every bit of b is also in a.
+ */
+gboolean
+snippets_file_types_contains (const SnippetsFileTypeSet *a,
+                              const SnippetsFileTypeSet *b)
+{
+  guint i;
+
+  for (i = 0; i < b->n_words; i++)
+    {
+      guint64 word_a = i < a->n_words ? a->words[i] : 0;
+      if ((b->words[i] & ~word_a) != 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+guint
+snippets_file_types_count (const SnippetsFileTypeSet *set)
+{
+  guint count = 0;
+  guint i;
+
+  for (i = 0; i < set->n_words; i++)
+    {
+      guint64 word = set->words[i];
+      while (word != 0)
+        {
+          word &= word - 1;
+          count++;
+        }
+    }
+
+  return count;
+}
+
+gboolean
+snippets_file_types_equal (const SnippetsFileTypeSet *a,
+                           const SnippetsFileTypeSet *b)
+{
+  guint n_words;
+  guint i;
+
+  n_words = MAX (a->n_words, b->n_words);
+
+  for (i = 0; i < n_words; i++)
+    {
+      guint64 word_a = i < a->n_words ? a->words[i] : 0;
+      guint64 word_b = i < b->n_words ? b->words[i] : 0;
+      if (word_a != word_b)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+guint
+snippets_file_types_hash (const SnippetsFileTypeSet *set)
+{
+  guint64 hash = 0;
+  guint n_words;
+  guint i;
+
+  /* clear words at the end must not count, as with equal */
+  n_words = set->n_words;
+  while (n_words > 0 && set->words[n_words - 1] == 0)
+    n_words--;
+
+  for (i = 0; i < n_words; i++)
+    hash = hash * 31 + set->words[i];
+
+  return (guint) (hash ^ (hash >> 32));
+}
+
+guint
+snippets_file_types_get_generation (void)
+{
+  return generation;
+}
+
+static SnippetsFileTypeSet*
+set_new (guint n_bits)
+{
+  SnippetsFileTypeSet *set;
+  set = g_slice_new (SnippetsFileTypeSet);
+  set->n_words = (n_bits + 63) / 64;
+  set->words = g_new0 (guint64, MAX (set->n_words, 1));
+  return set;
+}
+
+static void
+set_bit (SnippetsFileTypeSet *set,
+         guint                bit)
+{
+  set->words[bit / 64] |= G_GUINT64_CONSTANT (1) << (bit % 64);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_FILE_TYPES_H__
+#define	__SNIPPETS_FILE_TYPES_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Every file type named by a snippet, such as ".c" or "Makefile", is
+ * given a number the first time it is seen. A list of file types then
+ * becomes a set of bits, and so does a document: the bits of all the
+ * file types its path ends in. A snippet applies to the document when
+ * the two sets share a bit.
+ */
+
+typedef struct _SnippetsFileTypeSet SnippetsFileTypeSet;
+
+struct _SnippetsFileTypeSet
+{
+  guint    n_words;
+  guint64 *words;
+};
+
+SnippetsFileTypeSet*  snippets_file_types_intern          (const gchar               *file_types);
+SnippetsFileTypeSet*  snippets_file_types_match           (const gchar               *file_path);
+SnippetsFileTypeSet*  snippets_file_types_copy            (const SnippetsFileTypeSet *set);
+void                  snippets_file_types_free            (SnippetsFileTypeSet       *set);
+gboolean              snippets_file_types_intersect       (const SnippetsFileTypeSet *a,
+                                                           const SnippetsFileTypeSet *b);
+gboolean              snippets_file_types_contains        (const SnippetsFileTypeSet *a,
+                                                           const SnippetsFileTypeSet *b);
+guint                 snippets_file_types_count           (const SnippetsFileTypeSet *set);
+gboolean              snippets_file_types_equal           (const SnippetsFileTypeSet *a,
+                                                           const SnippetsFileTypeSet *b);
+guint                 snippets_file_types_hash            (const SnippetsFileTypeSet *set);
+guint                 snippets_file_types_get_generation  (void);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_FILE_TYPES_H__ */
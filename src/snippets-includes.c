@@ -0,0 +1,644 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <codeslayer/codeslayer-utils.h>
+#include "snippets-includes.h"
+
+/*
+ * A snippet can pull in another one by name with ${include:name}. The
+ * includes are put in place here, as the library is loaded, so that
+ * expanding a snippet stays a single insert of text that is ready to go.
+ * For every name we also keep the snippets that include it, so when a
+ * snippet changes only the ones built from it are worked out again. An
+ * include that would loop back on itself is left as it is, and the loop
+ * is reported the first time it is found.
+ *
+ * The tab stops of an included snippet are numbered on from the ones
+ * of the snippet it goes into, so $1 of the include comes after the
+ * last tab stop of the outer snippet, and its $0 becomes an ordinary
+ * tab stop after its own. Only the $0 of the outer snippet ends it.
+ */
+
+#define INCLUDE_PREFIX "${include:"
+
+typedef struct
+{
+  gchar     *name;
+  GPtrArray *includes;
+} Node;
+
+static void snippets_includes_class_init  (SnippetsIncludesClass *klass);
+static void snippets_includes_init        (SnippetsIncludes      *includes);
+static void snippets_includes_finalize    (SnippetsIncludes      *includes);
+
+static void flatten                       (SnippetsIncludes      *includes,
+                                           SnippetsConfig        *config);
+static void append_text                   (SnippetsIncludes      *includes,
+                                           const gchar           *text,
+                                           GString               *output,
+                                           GPtrArray             *path,
+                                           gint                   shift,
+                                           gint                   zero,
+                                           gint                  *next);
+static void append_tab_stops              (GString               *output,
+                                           const gchar           *text,
+                                           gsize                  length,
+                                           gint                   shift,
+                                           gint                   zero);
+static gint get_last_tab_stop             (const gchar           *text);
+static void report_cycle                  (SnippetsIncludes      *includes,
+                                           GPtrArray             *path,
+                                           SnippetsConfig        *target);
+static void refresh                       (SnippetsIncludes      *includes,
+                                           const gchar           *name,
+                                           GHashTable            *done);
+static SnippetsConfig* resolve            (SnippetsIncludes      *includes,
+                                           const gchar           *name);
+static const gchar* find_include          (const gchar           *text,
+                                           const gchar          **name,
+                                           const gchar          **end);
+static GPtrArray* get_includes            (const gchar           *text);
+static void list_append                   (GHashTable            *table,
+                                           const gchar           *key,
+                                           SnippetsConfig        *config);
+static void list_remove                   (GHashTable            *table,
+                                           const gchar           *key,
+                                           SnippetsConfig        *config);
+static void node_free                     (Node                  *node);
+
+#define SNIPPETS_INCLUDES_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_INCLUDES_TYPE, SnippetsIncludesPrivate))
+
+typedef struct _SnippetsIncludesPrivate SnippetsIncludesPrivate;
+
+struct _SnippetsIncludesPrivate
+{
+  GHashTable *nodes;
+  GHashTable *names;
+  GHashTable *dependents;
+  GHashTable *cycles;
+  GString    *scratch;
+};
+
+G_DEFINE_TYPE (SnippetsIncludes, snippets_includes, G_TYPE_OBJECT)
+
+static void
+snippets_includes_class_init (SnippetsIncludesClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_includes_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsIncludesPrivate));
+}
+
+static void
+snippets_includes_init (SnippetsIncludes *includes)
+{
+  SnippetsIncludesPrivate *priv;
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+  priv->nodes = g_hash_table_new_full (g_direct_hash, g_direct_equal, 
+                                       NULL, (GDestroyNotify) node_free);
+  priv->names = g_hash_table_new_full (g_str_hash, g_str_equal, 
+                                       g_free, (GDestroyNotify) g_list_free);
+  priv->dependents = g_hash_table_new_full (g_str_hash, g_str_equal, 
+                                            g_free, (GDestroyNotify) g_list_free);
+  priv->cycles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  priv->scratch = g_string_new (NULL);
+}
+
+static void
+snippets_includes_finalize (SnippetsIncludes *includes)
+{
+  SnippetsIncludesPrivate *priv;
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+  g_hash_table_destroy (priv->nodes);
+  g_hash_table_destroy (priv->names);
+  g_hash_table_destroy (priv->dependents);
+  g_hash_table_destroy (priv->cycles);
+  g_string_free (priv->scratch, TRUE);
+  G_OBJECT_CLASS (snippets_includes_parent_class)->finalize (G_OBJECT (includes));
+}
+
+SnippetsIncludes*
+snippets_includes_new (void)
+{
+  return SNIPPETS_INCLUDES (g_object_new (snippets_includes_get_type (), NULL));
+}
+
+void
+snippets_includes_add (SnippetsIncludes *includes,
+                       SnippetsConfig   *config)
+{
+  SnippetsIncludesPrivate *priv;
+  GHashTable *done;
+  Node *node;
+  guint i;
+
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+
+  if (g_hash_table_lookup (priv->nodes, config) != NULL)
+    return;
+
+  node = g_slice_new (Node);
+  node->name = g_strdup (snippets_config_get_name (config));
+  node->includes = get_includes (snippets_config_get_text (config, priv->scratch));
+  g_hash_table_insert (priv->nodes, config, node);
+
+  for (i = 0; i < node->includes->len; i++)
+    list_append (priv->dependents, g_ptr_array_index (node->includes, i), config);
+
+  flatten (includes, config);
+
+  if (!codeslayer_utils_has_text (node->name))
+    return;
+
+  /* the first snippet in the library wins when names collide */
+  list_append (priv->names, node->name, config);
+
+  if (resolve (includes, node->name) == config)
+    {
+      done = g_hash_table_new (g_direct_hash, g_direct_equal);
+      g_hash_table_insert (done, config, config);
+      refresh (includes, node->name, done);
+      g_hash_table_destroy (done);
+    }
+}
+
+void
+snippets_includes_remove (SnippetsIncludes *includes,
+                          SnippetsConfig   *config)
+{
+  SnippetsIncludesPrivate *priv;
+  gboolean resolved;
+  Node *node;
+  gchar *name;
+  guint i;
+
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+
+  node = g_hash_table_lookup (priv->nodes, config);
+  if (node == NULL)
+    return;
+
+  for (i = 0; i < node->includes->len; i++)
+    list_remove (priv->dependents, g_ptr_array_index (node->includes, i), config);
+
+  name = node->name;
+  node->name = NULL;
+  g_hash_table_remove (priv->nodes, config);
+
+  snippets_config_set_expansion (config, NULL);
+
+  if (codeslayer_utils_has_text (name))
+    {
+      resolved = resolve (includes, name) == config;
+      list_remove (priv->names, name, config);
+
+      if (resolved)
+        {
+          GHashTable *done;
+          done = g_hash_table_new (g_direct_hash, g_direct_equal);
+          refresh (includes, name, done);
+          g_hash_table_destroy (done);
+        }
+    }
+
+  g_free (name);
+}
+
+/*
+ * Called once the name or text of the snippet changed, which works out
+ * the snippet again along with whatever includes it.
+ */
+void
+snippets_includes_update (SnippetsIncludes *includes,
+                          SnippetsConfig   *config)
+{
+  snippets_includes_remove (includes, config);
+  snippets_includes_add (includes, config);
+}
+
+static void
+flatten (SnippetsIncludes *includes,
+         SnippetsConfig   *config)
+{
+  SnippetsIncludesPrivate *priv;
+  GPtrArray *path;
+  GString *output;
+  const gchar *text;
+  Node *node;
+  gint next;
+
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+
+  node = g_hash_table_lookup (priv->nodes, config);
+
+  if (node->includes->len == 0)
+    {
+      snippets_config_set_expansion (config, NULL);
+      return;
+    }
+
+  output = g_string_new (NULL);
+  path = g_ptr_array_new ();
+  g_ptr_array_add (path, config);
+
+  text = snippets_config_get_text (config, priv->scratch);
+  next = get_last_tab_stop (text);
+  append_text (includes, text, output, path, 0, -1, &next);
+  snippets_config_set_expansion (config, output->str);
+
+  g_ptr_array_free (path, TRUE);
+  g_string_free (output, TRUE);
+}
+
+/*
+ * The path holds the snippets being included into one another, the one
+ * worked out first. The tab stops of the text are moved up by the shift
+ * and its $0 becomes zero, unless that is -1. The next free tab stop is
+ * kept in next, the includes are numbered from there.
+ */
+static void
+append_text (SnippetsIncludes *includes,
+             const gchar      *text,
+             GString          *output,
+             GPtrArray        *path,
+             gint              shift,
+             gint              zero,
+             gint             *next)
+{
+  const gchar *include;
+  const gchar *name;
+  const gchar *end;
+
+  if (text == NULL)
+    return;
+
+  while ((include = find_include (text, &name, &end)) != NULL)
+    {
+      SnippetsConfig *target;
+      gchar *key;
+      guint i;
+
+      append_tab_stops (output, text, include - text, shift, zero);
+
+      key = g_strndup (name, end - name);
+      target = resolve (includes, key);
+
+      for (i = 0; target != NULL && i < path->len; i++)
+        {
+          if (g_ptr_array_index (path, i) == target)
+            break;
+        }
+
+      if (target != NULL && i == path->len)
+        {
+          /* the text of the outer snippet may still live in a scratch */
+          GString *scratch = g_string_new (NULL);
+          const gchar *target_text;
+          gint target_shift;
+
+          target_text = snippets_config_get_text (target, scratch);
+          target_shift = *next;
+          *next += get_last_tab_stop (target_text) + 1;
+
+          g_ptr_array_add (path, target);
+          append_text (includes, target_text, output, path, target_shift, *next, next);
+          g_ptr_array_set_size (path, path->len - 1);
+          g_string_free (scratch, TRUE);
+        }
+      else
+        {
+          if (target != NULL)
+            report_cycle (includes, path, target);
+          g_string_append_len (output, include, end + 1 - include);
+        }
+
+      g_free (key);
+      text = end + 1;
+    }
+
+  append_tab_stops (output, text, strlen (text), shift, zero);
+}
+
+/*
+ * Copies the text, numbering its tab stops as append_text works out.
+ * The defaults are copied along and the tab stops in them numbered too.
+ */
+static void
+append_tab_stops (GString     *output,
+                  const gchar *text,
+                  gsize        length,
+                  gint         shift,
+                  gint         zero)
+{
+  const gchar *end = text + length;
+
+  if (shift == 0 && zero < 0)
+    {
+      g_string_append_len (output, text, length);
+      return;
+    }
+
+  while (text < end)
+    {
+      const gchar *digits = text + 1;
+      gint index = 0;
+
+      if (*text == '\\' && digits < end && *digits == '$')
+        {
+          g_string_append_len (output, text, 2);
+          text += 2;
+          continue;
+        }
+
+      if (*text == '$' && digits < end && *digits == '{')
+        digits++;
+
+      if (*text != '$' || digits >= end || !g_ascii_isdigit (*digits))
+        {
+          g_string_append_c (output, *text);
+          text++;
+          continue;
+        }
+
+      g_string_append_len (output, text, digits - text);
+      while (digits < end && g_ascii_isdigit (*digits))
+        index = index * 10 + (*digits++ - '0');
+
+      if (index == 0)
+        g_string_append_printf (output, "%d", zero >= 0 ? zero : 0);
+      else
+        g_string_append_printf (output, "%d", index + shift);
+
+      text = digits;
+    }
+}
+
+/*
+ * The highest tab stop written in the text itself, leaving out the
+ * ones its includes bring in.
+ */
+static gint
+get_last_tab_stop (const gchar *text)
+{
+  gint last = 0;
+
+  if (text == NULL)
+    return 0;
+
+  while (*text != '\0')
+    {
+      const gchar *digits = text + 1;
+      gint index = 0;
+
+      if (*text == '\\' && *digits == '$')
+        {
+          text += 2;
+          continue;
+        }
+
+      if (*text == '$' && *digits == '{')
+        digits++;
+
+      if (*text != '$' || !g_ascii_isdigit (*digits))
+        {
+          text++;
+          continue;
+        }
+
+      while (g_ascii_isdigit (*digits))
+        index = index * 10 + (*digits++ - '0');
+
+      last = MAX (last, index);
+      text = digits;
+    }
+
+  return last;
+}
+
+/*
+ * Warns about a loop of includes the first time it is found. Working it
+ * out again from another snippet on the loop, or on the next refresh,
+ * finds the same loop, so it is written from the name that sorts first.
+ */
+static void
+report_cycle (SnippetsIncludes *includes,
+              GPtrArray        *path,
+              SnippetsConfig   *target)
+{
+  SnippetsIncludesPrivate *priv;
+  GString *cycle;
+  guint start;
+  guint first;
+  guint length;
+  guint i;
+
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+
+  start = 0;
+  while (g_ptr_array_index (path, start) != target)
+    start++;
+
+  length = path->len - start;
+  first = start;
+
+  for (i = start + 1; i < path->len; i++)
+    {
+      Node *node = g_hash_table_lookup (priv->nodes, g_ptr_array_index (path, i));
+      Node *first_node = g_hash_table_lookup (priv->nodes, g_ptr_array_index (path, first));
+      if (g_strcmp0 (node->name, first_node->name) < 0)
+        first = i;
+    }
+
+  cycle = g_string_new (NULL);
+
+  for (i = 0; i <= length; i++)
+    {
+      SnippetsConfig *config = g_ptr_array_index (path, start + (first - start + i) % length);
+      Node *node = g_hash_table_lookup (priv->nodes, config);
+      if (i > 0)
+        g_string_append (cycle, " -> ");
+      g_string_append (cycle, node->name);
+    }
+
+  if (g_hash_table_contains (priv->cycles, cycle->str))
+    {
+      g_string_free (cycle, TRUE);
+      return;
+    }
+
+  if (length == 1)
+    g_warning ("snippet %s includes itself", 
+               ((Node*) g_hash_table_lookup (priv->nodes, target))->name);
+  else
+    g_warning ("snippets include each other in a loop: %s", cycle->str);
+
+  g_hash_table_add (priv->cycles, g_string_free (cycle, FALSE));
+}
+
+/*
+ * Work out again every snippet that includes the name, then the ones
+ * that include those. Each snippet is only visited once.
+ */
+static void
+refresh (SnippetsIncludes *includes,
+         const gchar      *name,
+         GHashTable       *done)
+{
+  SnippetsIncludesPrivate *priv;
+  GList *list;
+
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+
+  for (list = g_hash_table_lookup (priv->dependents, name); list != NULL; list = g_list_next (list))
+    {
+      SnippetsConfig *config = list->data;
+      Node *node;
+
+      if (g_hash_table_lookup (done, config) != NULL)
+        continue;
+
+      g_hash_table_insert (done, config, config);
+      flatten (includes, config);
+
+      node = g_hash_table_lookup (priv->nodes, config);
+      if (codeslayer_utils_has_text (node->name) && resolve (includes, node->name) == config)
+        refresh (includes, node->name, done);
+    }
+}
+
+static SnippetsConfig*
+resolve (SnippetsIncludes *includes,
+         const gchar      *name)
+{
+  SnippetsIncludesPrivate *priv;
+  GList *list;
+
+  priv = SNIPPETS_INCLUDES_GET_PRIVATE (includes);
+
+  list = g_hash_table_lookup (priv->names, name);
+  return list != NULL ? list->data : NULL;
+}
+
+/*
+ * The next ${include:name} in the text, skipping the ones escaped as
+ * \${include:name} since those are meant to be kept as they are.
+ */
+static const gchar*
+find_include (const gchar  *text,
+              const gchar **name,
+              const gchar **end)
+{
+  const gchar *include = text;
+
+  while ((include = strstr (include, INCLUDE_PREFIX)) != NULL)
+    {
+      if (include == text || include[-1] != '\\')
+        {
+          *name = include + strlen (INCLUDE_PREFIX);
+          *end = strchr (*name, '}');
+          if (*end == NULL)
+            return NULL;
+          if (*end > *name)
+            return include;
+        }
+      include++;
+    }
+
+  return NULL;
+}
+
+static GPtrArray*
+get_includes (const gchar *text)
+{
+  GPtrArray *names;
+  const gchar *name;
+  const gchar *end;
+
+  names = g_ptr_array_new_with_free_func (g_free);
+
+  if (text == NULL)
+    return names;
+
+  while (find_include (text, &name, &end) != NULL)
+    {
+      gchar *key;
+      guint i;
+
+      key = g_strndup (name, end - name);
+
+      for (i = 0; i < names->len; i++)
+        {
+          if (strcmp (g_ptr_array_index (names, i), key) == 0)
+            break;
+        }
+
+      if (i == names->len)
+        g_ptr_array_add (names, key);
+      else
+        g_free (key);
+
+      text = end + 1;
+    }
+
+  return names;
+}
+
+static void
+list_append (GHashTable     *table,
+             const gchar    *key,
+             SnippetsConfig *config)
+{
+  GList *list;
+
+  list = g_hash_table_lookup (table, key);
+
+  if (list == NULL)
+    g_hash_table_insert (table, g_strdup (key), g_list_append (NULL, config));
+  else
+    list = g_list_append (list, config);
+}
+
+static void
+list_remove (GHashTable     *table,
+             const gchar    *key,
+             SnippetsConfig *config)
+{
+  gpointer stored_key;
+  gpointer list;
+
+  if (!g_hash_table_lookup_extended (table, key, &stored_key, &list))
+    return;
+
+  g_hash_table_steal (table, key);
+  list = g_list_remove (list, config);
+
+  if (list != NULL)
+    g_hash_table_insert (table, stored_key, list);
+  else
+    g_free (stored_key);
+}
+
+static void
+node_free (Node *node)
+{
+  g_free (node->name);
+  g_ptr_array_free (node->includes, TRUE);
+  g_slice_free (Node, node);
+}
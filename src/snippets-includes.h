@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __SNIPPETS_INCLUDES_H__
+#define	__SNIPPETS_INCLUDES_H__
+
+#include <gtk/gtk.h>
+#include "snippets-config.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_INCLUDES_TYPE            (snippets_includes_get_type ())
+#define SNIPPETS_INCLUDES(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_INCLUDES_TYPE, SnippetsIncludes))
+#define SNIPPETS_INCLUDES_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_INCLUDES_TYPE, SnippetsIncludesClass))
+#define IS_SNIPPETS_INCLUDES(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_INCLUDES_TYPE))
+#define IS_SNIPPETS_INCLUDES_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_INCLUDES_TYPE))
+
+typedef struct _SnippetsIncludes SnippetsIncludes;
+typedef struct _SnippetsIncludesClass SnippetsIncludesClass;
+
+struct _SnippetsIncludes
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsIncludesClass
+{
+  GObjectClass parent_class;
+};
+
+GType snippets_includes_get_type (void) G_GNUC_CONST;
+
+SnippetsIncludes*  snippets_includes_new     (void);
+
+void               snippets_includes_add     (SnippetsIncludes *includes,
+                                              SnippetsConfig   *config);
+void               snippets_includes_remove  (SnippetsIncludes *includes,
+                                              SnippetsConfig   *config);
+void               snippets_includes_update  (SnippetsIncludes *includes,
+                                              SnippetsConfig   *config);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_INCLUDES_H__ */
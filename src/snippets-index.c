@@ -0,0 +1,1315 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <codeslayer/codeslayer-utils.h>
+#include "snippets-file-types.h"
+#include "snippets-index.h"
+
+/*
+ * Triggers are kept in a hash table for the exact lookup done on every Tab.
+ * Every distinct trigger also gets a small integer id and its trigrams are
+ * recorded in posting lists, so that a mistyped word can be matched against
+ * only the triggers that share some of its trigrams. The triggers are also
+ * kept in order so that completion can find the ones starting with a prefix.
+ *
+ * Pattern triggers are compiled on their own once when added, which checks
+ * them and counts their groups. For each file they are then joined into a
+ * single alternation anchored at the cursor, so one match covers them all.
+ *
+ * Snippets that share a trigger are kept in order of priority rather than
+ * in library order, and the triggers with more than one snippet are
+ * remembered as they are added, so the conflicts can be listed without
+ * going over the whole library.
+ */
+
+#define FUZZY_MIN_LENGTH 3
+#define FUZZY_MAX_LENGTH 64
+#define FUZZY_CANDIDATES 16
+#define RANK_WINDOW 8
+
+typedef struct
+{
+  gchar         *trigger;
+  GList         *configs;
+  guint          id;
+  GSequenceIter *position;
+} Entry;
+
+typedef struct
+{
+  Entry *entry;
+  guint  count;
+} Candidate;
+
+typedef struct
+{
+  SnippetsConfig *config;
+  gint            n_groups;
+} Pattern;
+
+typedef struct
+{
+  GRegex    *regex;
+  GPtrArray *patterns;
+  GArray    *groups;
+} Alternation;
+
+static void snippets_index_class_init  (SnippetsIndexClass *klass);
+static void snippets_index_init        (SnippetsIndex      *index);
+static void snippets_index_finalize    (SnippetsIndex      *index);
+
+static void add_postings               (SnippetsIndex      *index,
+                                        Entry              *entry);
+static void remove_postings            (SnippetsIndex      *index,
+                                        Entry              *entry);
+static void get_trigrams               (const gchar        *text,
+                                        GArray             *trigrams);
+static gint compare_trigrams           (gconstpointer       a,
+                                        gconstpointer       b);
+static guint get_distance              (const gchar        *a,
+                                        const gchar        *b);
+static const SnippetsFileTypeSet* get_document (SnippetsIndex *index,
+                                                const gchar   *file_path);
+static SnippetsConfig* get_applicable  (Entry              *entry,
+                                        const SnippetsFileTypeSet *document);
+static gboolean is_applicable          (SnippetsConfig     *config,
+                                        const SnippetsFileTypeSet *document);
+static gint compare_entries            (Entry              *a,
+                                        Entry              *b);
+static gint compare_prefix             (Entry              *a,
+                                        Entry              *b,
+                                        Entry              *probe);
+static gint compare_ranks              (SnippetsConfig    **a,
+                                        SnippetsConfig    **b);
+static gint compare_priority           (SnippetsConfig     *a,
+                                        SnippetsConfig     *b);
+static void add_conflicts              (Entry              *entry,
+                                        SnippetsConfig     *config,
+                                        GArray             *conflicts);
+static gboolean is_conflict            (SnippetsConfig     *winner,
+                                        SnippetsConfig     *loser,
+                                        gboolean           *shadowed);
+static gint compare_conflicts          (SnippetsConflict   *a,
+                                        SnippetsConflict   *b);
+static void entry_free                 (Entry              *entry);
+static gboolean add_pattern            (SnippetsIndex      *index,
+                                        SnippetsConfig     *config);
+static gboolean remove_pattern         (SnippetsIndex      *index,
+                                        SnippetsConfig     *config);
+static gboolean has_group_reference    (const gchar        *pattern);
+static Alternation* get_alternation    (SnippetsIndex      *index,
+                                        const gchar        *file_path);
+static void alternation_free           (Alternation        *alternation);
+static gint compare_patterns           (Pattern            *pattern,
+                                        SnippetsConfig     *config);
+
+#define SNIPPETS_INDEX_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_INDEX_TYPE, SnippetsIndexPrivate))
+
+typedef struct _SnippetsIndexPrivate SnippetsIndexPrivate;
+
+struct _SnippetsIndexPrivate
+{
+  GHashTable *triggers;
+  GHashTable *configs;
+  GHashTable *collisions;
+  GPtrArray  *entries;
+  GArray     *free_ids;
+  GHashTable *postings;
+  GSequence  *sorted;
+  GArray     *trigrams;
+  GArray     *counts;
+  GArray     *touched;
+  GList      *patterns;
+  GHashTable *alternations;
+  GHashTable *documents;
+  guint       generation;
+};
+
+G_DEFINE_TYPE (SnippetsIndex, snippets_index, G_TYPE_OBJECT)
+
+static void
+snippets_index_class_init (SnippetsIndexClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_index_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsIndexPrivate));
+}
+
+static void
+snippets_index_init (SnippetsIndex *index)
+{
+  SnippetsIndexPrivate *priv;
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+  priv->triggers = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->configs = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->collisions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->entries = g_ptr_array_new ();
+  priv->free_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->postings = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, (GDestroyNotify) g_array_unref);
+  priv->sorted = g_sequence_new (NULL);
+  priv->trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+  priv->counts = g_array_new (FALSE, TRUE, sizeof (guint16));
+  priv->touched = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->patterns = NULL;
+  priv->alternations = g_hash_table_new_full ((GHashFunc) snippets_file_types_hash, 
+                                              (GEqualFunc) snippets_file_types_equal, 
+                                              (GDestroyNotify) snippets_file_types_free, 
+                                              (GDestroyNotify) alternation_free);
+  priv->documents = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, 
+                                           (GDestroyNotify) snippets_file_types_free);
+  priv->generation = snippets_file_types_get_generation ();
+}
+
+static void
+snippets_index_finalize (SnippetsIndex *index)
+{
+  SnippetsIndexPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  for (i = 0; i < priv->entries->len; i++)
+    {
+      Entry *entry = g_ptr_array_index (priv->entries, i);
+      if (entry != NULL)
+        entry_free (entry);
+    }
+
+  g_hash_table_destroy (priv->triggers);
+  g_hash_table_destroy (priv->configs);
+  g_hash_table_destroy (priv->collisions);
+  g_ptr_array_free (priv->entries, TRUE);
+  g_array_free (priv->free_ids, TRUE);
+  g_hash_table_destroy (priv->postings);
+  g_sequence_free (priv->sorted);
+  g_array_free (priv->trigrams, TRUE);
+  g_array_free (priv->counts, TRUE);
+  g_array_free (priv->touched, TRUE);
+  
+  while (priv->patterns != NULL)
+    {
+      g_slice_free (Pattern, priv->patterns->data);
+      priv->patterns = g_list_delete_link (priv->patterns, priv->patterns);
+    }
+  g_hash_table_destroy (priv->alternations);
+  g_hash_table_destroy (priv->documents);
+
+  G_OBJECT_CLASS (snippets_index_parent_class)->finalize (G_OBJECT (index));
+}
+
+SnippetsIndex*
+snippets_index_new (void)
+{
+  return SNIPPETS_INDEX (g_object_new (snippets_index_get_type (), NULL));
+}
+
+void
+snippets_index_add (SnippetsIndex  *index,
+                    SnippetsConfig *config)
+{
+  SnippetsIndexPrivate *priv;
+  const gchar *trigger;
+  Entry *entry;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  trigger = snippets_config_get_trigger (config);
+  if (!codeslayer_utils_has_text (trigger) ||
+      g_hash_table_lookup (priv->configs, config) != NULL)
+    return;
+    
+  if (snippets_config_get_pattern (config))
+    {
+      add_pattern (index, config);
+      return;
+    }
+
+  entry = g_hash_table_lookup (priv->triggers, trigger);
+
+  if (entry == NULL)
+    {
+      entry = g_slice_new0 (Entry);
+      entry->trigger = g_strdup (trigger);
+
+      if (priv->free_ids->len > 0)
+        {
+          entry->id = g_array_index (priv->free_ids, guint, priv->free_ids->len - 1);
+          g_array_set_size (priv->free_ids, priv->free_ids->len - 1);
+          g_ptr_array_index (priv->entries, entry->id) = entry;
+        }
+      else
+        {
+          entry->id = priv->entries->len;
+          g_ptr_array_add (priv->entries, entry);
+        }
+
+      g_hash_table_insert (priv->triggers, entry->trigger, entry);
+      entry->position = g_sequence_insert_sorted (priv->sorted, entry, 
+                                                  (GCompareDataFunc) compare_entries, NULL);
+      add_postings (index, entry);
+    }
+
+  entry->configs = g_list_insert_sorted (entry->configs, config, 
+                                         (GCompareFunc) compare_priority);
+  g_hash_table_insert (priv->configs, config, entry);
+
+  if (entry->configs->next != NULL)
+    g_hash_table_insert (priv->collisions, entry, entry);
+}
+
+void
+snippets_index_remove (SnippetsIndex  *index,
+                       SnippetsConfig *config)
+{
+  SnippetsIndexPrivate *priv;
+  Entry *entry;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+  
+  if (remove_pattern (index, config))
+    return;
+
+  entry = g_hash_table_lookup (priv->configs, config);
+  if (entry == NULL)
+    return;
+
+  g_hash_table_remove (priv->configs, config);
+  entry->configs = g_list_remove (entry->configs, config);
+
+  if (entry->configs == NULL || entry->configs->next == NULL)
+    g_hash_table_remove (priv->collisions, entry);
+
+  if (entry->configs != NULL)
+    return;
+
+  remove_postings (index, entry);
+  g_sequence_remove (entry->position);
+  g_hash_table_remove (priv->triggers, entry->trigger);
+  g_ptr_array_index (priv->entries, entry->id) = NULL;
+  g_array_append_val (priv->free_ids, entry->id);
+  entry_free (entry);
+}
+
+SnippetsConfig*
+snippets_index_lookup (SnippetsIndex *index,
+                       const gchar   *trigger,
+                       const gchar   *file_path)
+{
+  SnippetsIndexPrivate *priv;
+  Entry *entry;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  if (!codeslayer_utils_has_text (trigger))
+    return NULL;
+
+  entry = g_hash_table_lookup (priv->triggers, trigger);
+  if (entry == NULL)
+    return NULL;
+
+  return get_applicable (entry, get_document (index, file_path));
+}
+
+/*
+ * Every snippet under the trigger whatever file types it is for, so that
+ * a trigger typed where it does not apply can be told from a plain word.
+ */
+void
+snippets_index_lookup_trigger (SnippetsIndex *index,
+                               const gchar   *trigger,
+                               GPtrArray     *results)
+{
+  SnippetsIndexPrivate *priv;
+  GList *list;
+  Entry *entry;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  if (!codeslayer_utils_has_text (trigger))
+    return;
+
+  entry = g_hash_table_lookup (priv->triggers, trigger);
+  if (entry == NULL)
+    return;
+
+  for (list = entry->configs; list != NULL; list = g_list_next (list))
+    g_ptr_array_add (results, list->data);
+}
+
+/*
+ * Every snippet under the trigger that applies to the file, in order of
+ * priority, added to the results. The array belongs to the caller so that
+ * it can be used again from one lookup to the next.
+ */
+void
+snippets_index_lookup_all (SnippetsIndex *index,
+                           const gchar   *trigger,
+                           const gchar   *file_path,
+                           GPtrArray     *results)
+{
+  SnippetsIndexPrivate *priv;
+  const SnippetsFileTypeSet *document;
+  GList *list;
+  Entry *entry;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  if (!codeslayer_utils_has_text (trigger))
+    return;
+
+  entry = g_hash_table_lookup (priv->triggers, trigger);
+  if (entry == NULL)
+    return;
+
+  document = get_document (index, file_path);
+
+  for (list = entry->configs; list != NULL; list = g_list_next (list))
+    {
+      if (is_applicable (list->data, document))
+        g_ptr_array_add (results, list->data);
+    }
+}
+
+/*
+ * The snippets for the file whose trigger starts with the prefix, at most
+ * limit of them. An exact match is always taken, the rest are gathered in
+ * trigger order from a window a few times the limit and then ranked, so
+ * the shortest triggers come out on top rather than the first ones in the
+ * alphabet.
+ */
+GList*
+snippets_index_lookup_prefix (SnippetsIndex *index,
+                              const gchar   *prefix,
+                              const gchar   *file_path,
+                              guint          limit)
+{
+  SnippetsIndexPrivate *priv;
+  const SnippetsFileTypeSet *document;
+  GPtrArray *results;
+  GSequenceIter *position;
+  GList *list = NULL;
+  Entry *exact;
+  Entry probe;
+  gsize length;
+  guint window;
+  guint i;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  if (!codeslayer_utils_has_text (prefix) || limit == 0)
+    return NULL;
+
+  probe.trigger = (gchar*) prefix;
+  length = strlen (prefix);
+  document = get_document (index, file_path);
+  window = limit * RANK_WINDOW;
+
+  results = g_ptr_array_new ();
+
+  exact = g_hash_table_lookup (priv->triggers, prefix);
+  if (exact != NULL)
+    {
+      GList *configs;
+      for (configs = exact->configs; configs != NULL; configs = g_list_next (configs))
+        {
+          if (is_applicable (configs->data, document))
+            g_ptr_array_add (results, configs->data);
+        }
+    }
+
+  position = g_sequence_search (priv->sorted, &probe, 
+                                (GCompareDataFunc) compare_prefix, &probe);
+
+  while (!g_sequence_iter_is_end (position) && results->len < window)
+    {
+      Entry *entry = g_sequence_get (position);
+      GList *configs;
+
+      if (strncmp (entry->trigger, prefix, length) != 0)
+        break;
+
+      for (configs = entry->configs; 
+           entry != exact && configs != NULL && results->len < window; 
+           configs = g_list_next (configs))
+        {
+          if (is_applicable (configs->data, document))
+            g_ptr_array_add (results, configs->data);
+        }
+
+      position = g_sequence_iter_next (position);
+    }
+
+  /* stable, so snippets sharing a trigger keep their priority */
+  g_ptr_array_sort (results, (GCompareFunc) compare_ranks);
+
+  for (i = MIN (results->len, limit); i > 0; i--)
+    list = g_list_prepend (list, g_ptr_array_index (results, i - 1));
+
+  g_ptr_array_free (results, TRUE);
+
+  return list;
+}
+
+/*
+ * The pattern snippet for the file that matches the text right in front
+ * of the cursor. The byte offset where the match starts is handed back
+ * along with the groups, the whole match first, to be freed with
+ * g_strfreev. A group that took no part in the match is empty.
+ */
+SnippetsConfig*
+snippets_index_lookup_pattern (SnippetsIndex  *index,
+                               const gchar    *text,
+                               const gchar    *file_path,
+                               gint           *match_start,
+                               gchar        ***groups)
+{
+  SnippetsIndexPrivate *priv;
+  Alternation *alternation;
+  GMatchInfo *match_info;
+  SnippetsConfig *result = NULL;
+  gint start;
+  gint end;
+  guint i;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+  
+  if (priv->patterns == NULL || file_path == NULL)
+    return NULL;
+  
+  alternation = get_alternation (index, file_path);
+  if (alternation->regex == NULL)
+    return NULL;
+    
+  /* an empty match would have every Tab expand something */
+  if (!g_regex_match (alternation->regex, text, 0, &match_info) ||
+      (g_match_info_fetch_pos (match_info, 0, &start, &end) && start == end))
+    {
+      g_match_info_free (match_info);
+      return NULL;
+    }
+    
+  /* the alternative that matched is the one whose own group took part */
+  for (i = 0; i < alternation->patterns->len && result == NULL; i++)
+    {
+      Pattern *pattern = g_ptr_array_index (alternation->patterns, i);
+      gint group = g_array_index (alternation->groups, gint, i);
+      
+      if (!g_match_info_fetch_pos (match_info, group, &start, &end) || start == -1)
+        continue;
+      
+      result = pattern->config;
+      
+      if (match_start != NULL)
+        *match_start = start;
+        
+      if (groups != NULL)
+        {
+          gint j;
+          
+          *groups = g_new0 (gchar*, pattern->n_groups + 2);
+
+          for (j = 0; j <= pattern->n_groups; j++)
+            {
+              (*groups)[j] = g_match_info_fetch (match_info, group + j);
+              if ((*groups)[j] == NULL)
+                (*groups)[j] = g_strdup ("");
+            }
+        }
+    }
+    
+  g_match_info_free (match_info);
+  
+  return result;
+}
+
+/*
+ * Rank the triggers that share trigrams with the word, then settle on the
+ * closest by edit distance. A candidate is only returned when it is closer
+ * than every other one, a tie means we cannot tell what was meant.
+ */
+SnippetsConfig*
+snippets_index_lookup_fuzzy (SnippetsIndex *index,
+                             const gchar   *word,
+                             const gchar   *file_path)
+{
+  SnippetsIndexPrivate *priv;
+  const SnippetsFileTypeSet *document;
+  Candidate candidates[FUZZY_CANDIDATES];
+  SnippetsConfig *result = NULL;
+  guint n_candidates = 0;
+  guint best_distance = G_MAXUINT;
+  guint second_distance = G_MAXUINT;
+  guint max_distance;
+  gsize length;
+  guint i;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  length = strlen (word);
+  if (length < FUZZY_MIN_LENGTH || length > FUZZY_MAX_LENGTH)
+    return NULL;
+
+  if (priv->counts->len < priv->entries->len)
+    g_array_set_size (priv->counts, priv->entries->len);
+
+  get_trigrams (word, priv->trigrams);
+
+  for (i = 0; i < priv->trigrams->len; i++)
+    {
+      GArray *posting;
+      guint32 trigram;
+      guint j;
+
+      trigram = g_array_index (priv->trigrams, guint32, i);
+      posting = g_hash_table_lookup (priv->postings, GUINT_TO_POINTER (trigram));
+      if (posting == NULL)
+        continue;
+
+      for (j = 0; j < posting->len; j++)
+        {
+          guint id = g_array_index (posting, guint, j);
+          guint16 *count = &g_array_index (priv->counts, guint16, id);
+          if (*count == 0)
+            g_array_append_val (priv->touched, id);
+          (*count)++;
+        }
+    }
+
+  /* keep the triggers sharing the most trigrams, and reset the counts */
+  for (i = 0; i < priv->touched->len; i++)
+    {
+      guint id = g_array_index (priv->touched, guint, i);
+      guint16 *count = &g_array_index (priv->counts, guint16, id);
+      guint position = n_candidates;
+
+      while (position > 0 && candidates[position - 1].count < *count)
+        position--;
+
+      if (position < FUZZY_CANDIDATES)
+        {
+          guint last = MIN (n_candidates, FUZZY_CANDIDATES - 1);
+          memmove (&candidates[position + 1], &candidates[position],
+                   (last - position) * sizeof (Candidate));
+          candidates[position].entry = g_ptr_array_index (priv->entries, id);
+          candidates[position].count = *count;
+          n_candidates = MIN (n_candidates + 1, FUZZY_CANDIDATES);
+        }
+
+      *count = 0;
+    }
+
+  g_array_set_size (priv->touched, 0);
+
+  document = get_document (index, file_path);
+
+  for (i = 0; i < n_candidates; i++)
+    {
+      SnippetsConfig *config;
+      guint distance;
+
+      config = get_applicable (candidates[i].entry, document);
+      if (config == NULL)
+        continue;
+
+      distance = get_distance (word, candidates[i].entry->trigger);
+
+      if (distance < best_distance)
+        {
+          second_distance = best_distance;
+          best_distance = distance;
+          result = config;
+        }
+      else if (distance < second_distance)
+        {
+          second_distance = distance;
+        }
+    }
+
+  max_distance = length <= 4 ? 1 : length <= 8 ? 2 : 3;
+
+  if (best_distance > max_distance || best_distance == second_distance)
+    return NULL;
+
+  return result;
+}
+
+/*
+ * The conflicts of one snippet, or of the whole library when config is
+ * NULL. The winner of each conflict is the snippet that comes first for
+ * the trigger.
+ */
+GArray*
+snippets_index_get_conflicts (SnippetsIndex  *index,
+                              SnippetsConfig *config)
+{
+  SnippetsIndexPrivate *priv;
+  GArray *conflicts;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  conflicts = g_array_new (FALSE, FALSE, sizeof (SnippetsConflict));
+
+  if (config != NULL)
+    {
+      Entry *entry = g_hash_table_lookup (priv->configs, config);
+      if (entry != NULL && entry->configs->next != NULL)
+        add_conflicts (entry, config, conflicts);
+    }
+  else
+    {
+      GHashTableIter iter;
+      gpointer entry;
+
+      g_hash_table_iter_init (&iter, priv->collisions);
+      while (g_hash_table_iter_next (&iter, &entry, NULL))
+        add_conflicts (entry, NULL, conflicts);
+
+      g_array_sort (conflicts, (GCompareFunc) compare_conflicts);
+    }
+
+  return conflicts;
+}
+
+/*
+ * The file types a document matches. The set belongs to the index and
+ * is only good until the next file type is interned.
+ */
+const SnippetsFileTypeSet*
+snippets_index_get_file_types (SnippetsIndex *index,
+                               const gchar   *file_path)
+{
+  return get_document (index, file_path);
+}
+
+static void
+add_postings (SnippetsIndex *index,
+              Entry         *entry)
+{
+  SnippetsIndexPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  get_trigrams (entry->trigger, priv->trigrams);
+
+  for (i = 0; i < priv->trigrams->len; i++)
+    {
+      GArray *posting;
+      guint32 trigram;
+
+      trigram = g_array_index (priv->trigrams, guint32, i);
+      posting = g_hash_table_lookup (priv->postings, GUINT_TO_POINTER (trigram));
+
+      if (posting == NULL)
+        {
+          posting = g_array_new (FALSE, FALSE, sizeof (guint));
+          g_hash_table_insert (priv->postings, GUINT_TO_POINTER (trigram), posting);
+        }
+
+      g_array_append_val (posting, entry->id);
+    }
+}
+
+static void
+remove_postings (SnippetsIndex *index,
+                 Entry         *entry)
+{
+  SnippetsIndexPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  get_trigrams (entry->trigger, priv->trigrams);
+
+  for (i = 0; i < priv->trigrams->len; i++)
+    {
+      GArray *posting;
+      guint32 trigram;
+      guint j;
+
+      trigram = g_array_index (priv->trigrams, guint32, i);
+      posting = g_hash_table_lookup (priv->postings, GUINT_TO_POINTER (trigram));
+      if (posting == NULL)
+        continue;
+
+      for (j = 0; j < posting->len; j++)
+        {
+          if (g_array_index (posting, guint, j) == entry->id)
+            {
+              g_array_remove_index_fast (posting, j);
+              break;
+            }
+        }
+
+      if (posting->len == 0)
+        g_hash_table_remove (priv->postings, GUINT_TO_POINTER (trigram));
+    }
+}
+
+/*
+ * The text is padded with a space on each side so that short triggers
+ * still produce trigrams and the ends of a word weigh a little more.
+ */
+static void
+get_trigrams (const gchar *text,
+              GArray      *trigrams)
+{
+  gsize length;
+  gsize i;
+
+  g_array_set_size (trigrams, 0);
+
+  length = strlen (text);
+
+  for (i = 0; i < length; i++)
+    {
+      guchar a, b, c;
+      guint32 trigram;
+
+      a = i == 0 ? ' ' : g_ascii_tolower (text[i - 1]);
+      b = g_ascii_tolower (text[i]);
+      c = i + 1 == length ? ' ' : g_ascii_tolower (text[i + 1]);
+
+      trigram = (a << 16) | (b << 8) | c;
+      g_array_append_val (trigrams, trigram);
+    }
+
+  if (trigrams->len > 1)
+    {
+      guint unique = 1;
+
+      g_array_sort (trigrams, compare_trigrams);
+
+      for (i = 1; i < trigrams->len; i++)
+        {
+          if (g_array_index (trigrams, guint32, i) != g_array_index (trigrams, guint32, unique - 1))
+            g_array_index (trigrams, guint32, unique++) = g_array_index (trigrams, guint32, i);
+        }
+
+      g_array_set_size (trigrams, unique);
+    }
+}
+
+static gint
+compare_trigrams (gconstpointer a,
+                  gconstpointer b)
+{
+  guint32 trigram_a = *(const guint32*) a;
+  guint32 trigram_b = *(const guint32*) b;
+  return trigram_a < trigram_b ? -1 : trigram_a > trigram_b;
+}
+
+static guint
+get_distance (const gchar *a,
+              const gchar *b)
+{
+  guint row[FUZZY_MAX_LENGTH + 1];
+  gsize length_a;
+  gsize length_b;
+  gsize i, j;
+
+  length_a = strlen (a);
+  length_b = strlen (b);
+
+  if (length_b > FUZZY_MAX_LENGTH)
+    return G_MAXUINT;
+
+  for (j = 0; j <= length_b; j++)
+    row[j] = j;
+
+  for (i = 1; i <= length_a; i++)
+    {
+      guint diagonal = row[0];
+      row[0] = i;
+
+      for (j = 1; j <= length_b; j++)
+        {
+          guint above = row[j];
+          guint cost = a[i - 1] == b[j - 1] ? 0 : 1;
+          row[j] = MIN (MIN (row[j] + 1, row[j - 1] + 1), diagonal + cost);
+          diagonal = above;
+        }
+    }
+
+  return row[length_b];
+}
+
+/*
+ * A document is matched against every interned file type once, after that
+ * each snippet is one bitset intersection. The cache only goes stale when
+ * a file type the index has never seen is interned.
+ */
+static const SnippetsFileTypeSet*
+get_document (SnippetsIndex *index,
+              const gchar   *file_path)
+{
+  SnippetsIndexPrivate *priv;
+  SnippetsFileTypeSet *document;
+  guint generation;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  if (file_path == NULL)
+    file_path = "";
+
+  generation = snippets_file_types_get_generation ();
+  if (priv->generation != generation)
+    {
+      g_hash_table_remove_all (priv->documents);
+      priv->generation = generation;
+    }
+
+  document = g_hash_table_lookup (priv->documents, file_path);
+  if (document == NULL)
+    {
+      document = snippets_file_types_match (file_path);
+      g_hash_table_insert (priv->documents, g_strdup (file_path), document);
+    }
+
+  return document;
+}
+
+static SnippetsConfig*
+get_applicable (Entry                     *entry,
+                const SnippetsFileTypeSet *document)
+{
+  GList *list;
+
+  for (list = entry->configs; list != NULL; list = g_list_next (list))
+    {
+      if (is_applicable (list->data, document))
+        return list->data;
+    }
+
+  return NULL;
+}
+
+static gboolean
+is_applicable (SnippetsConfig            *config,
+               const SnippetsFileTypeSet *document)
+{
+  return snippets_file_types_intersect (snippets_config_get_file_type_set (config), 
+                                        document);
+}
+
+static gint
+compare_entries (Entry *a,
+                 Entry *b)
+{
+  return strcmp (a->trigger, b->trigger);
+}
+
+/*
+ * Never equal, so that the search lands in front of every trigger that
+ * is not less than the prefix.
+ */
+static gint
+compare_prefix (Entry *a,
+                Entry *b,
+                Entry *probe)
+{
+  if (a == probe)
+    return strcmp (a->trigger, b->trigger) <= 0 ? -1 : 1;
+  return strcmp (a->trigger, b->trigger) < 0 ? -1 : 1;
+}
+
+static gint
+compare_ranks (SnippetsConfig **a,
+               SnippetsConfig **b)
+{
+  const gchar *trigger_a = snippets_config_get_trigger (*a);
+  const gchar *trigger_b = snippets_config_get_trigger (*b);
+  gsize length_a = strlen (trigger_a);
+  gsize length_b = strlen (trigger_b);
+
+  if (length_a != length_b)
+    return length_a < length_b ? -1 : 1;
+
+  return strcmp (trigger_a, trigger_b);
+}
+
+/*
+ * Which snippet comes first when several share a trigger, so that it
+ * never depends on where they are in the library. Snippets limited to
+ * some contexts come before the ones that are not, then the ones for
+ * fewer file types, and after that it is down to the names. Snippets
+ * alike in all of that are told apart by their ids, which never change.
+ */
+static gint
+compare_priority (SnippetsConfig *a,
+                  SnippetsConfig *b)
+{
+  gboolean contexts_a;
+  gboolean contexts_b;
+  guint count_a;
+  guint count_b;
+  guint64 id_a;
+  guint64 id_b;
+  gint result;
+
+  contexts_a = codeslayer_utils_has_text (snippets_config_get_contexts (a));
+  contexts_b = codeslayer_utils_has_text (snippets_config_get_contexts (b));
+  if (contexts_a != contexts_b)
+    return contexts_a ? -1 : 1;
+
+  count_a = snippets_file_types_count (snippets_config_get_file_type_set (a));
+  count_b = snippets_file_types_count (snippets_config_get_file_type_set (b));
+  if (count_a != count_b)
+    return count_a < count_b ? -1 : 1;
+
+  result = g_strcmp0 (snippets_config_get_name (a), snippets_config_get_name (b));
+  if (result != 0)
+    return result;
+
+  result = g_strcmp0 (snippets_config_get_file_types (a), 
+                      snippets_config_get_file_types (b));
+  if (result != 0)
+    return result;
+
+  result = g_strcmp0 (snippets_config_get_contexts (a), 
+                      snippets_config_get_contexts (b));
+  if (result != 0)
+    return result;
+
+  id_a = snippets_config_get_id (a);
+  id_b = snippets_config_get_id (b);
+  if (id_a != id_b)
+    return id_a < id_b ? -1 : 1;
+
+  return 0;
+}
+
+static void
+add_conflicts (Entry          *entry,
+               SnippetsConfig *config,
+               GArray         *conflicts)
+{
+  GList *winners;
+  GList *losers;
+
+  for (winners = entry->configs; winners != NULL; winners = g_list_next (winners))
+    {
+      for (losers = winners->next; losers != NULL; losers = g_list_next (losers))
+        {
+          SnippetsConflict conflict;
+
+          if (config != NULL && config != winners->data && config != losers->data)
+            continue;
+
+          if (!is_conflict (winners->data, losers->data, &conflict.shadowed))
+            continue;
+
+          conflict.winner = winners->data;
+          conflict.loser = losers->data;
+          g_array_append_val (conflicts, conflict);
+        }
+    }
+}
+
+/*
+ * Two snippets conflict when some file takes both of them. Different
+ * contexts are taken to keep them apart. The loser is shadowed when the
+ * winner takes every file it does in the same contexts, so it can only
+ * ever be picked by hand.
+ */
+static gboolean
+is_conflict (SnippetsConfig *winner,
+             SnippetsConfig *loser,
+             gboolean       *shadowed)
+{
+  const SnippetsFileTypeSet *winner_set;
+  const SnippetsFileTypeSet *loser_set;
+  const gchar *winner_contexts;
+  const gchar *loser_contexts;
+  gboolean has_winner_contexts;
+  gboolean has_loser_contexts;
+
+  winner_set = snippets_config_get_file_type_set (winner);
+  loser_set = snippets_config_get_file_type_set (loser);
+  if (!snippets_file_types_intersect (winner_set, loser_set))
+    return FALSE;
+
+  winner_contexts = snippets_config_get_contexts (winner);
+  loser_contexts = snippets_config_get_contexts (loser);
+  has_winner_contexts = codeslayer_utils_has_text (winner_contexts);
+  has_loser_contexts = codeslayer_utils_has_text (loser_contexts);
+
+  if (has_winner_contexts && has_loser_contexts &&
+      g_strcmp0 (winner_contexts, loser_contexts) != 0)
+    return FALSE;
+
+  *shadowed = has_winner_contexts == has_loser_contexts &&
+              snippets_file_types_contains (winner_set, loser_set);
+
+  return TRUE;
+}
+
+static gint
+compare_conflicts (SnippetsConflict *a,
+                   SnippetsConflict *b)
+{
+  return strcmp (snippets_config_get_trigger (a->winner), 
+                 snippets_config_get_trigger (b->winner));
+}
+
+static void
+entry_free (Entry *entry)
+{
+  g_list_free (entry->configs);
+  g_free (entry->trigger);
+  g_slice_free (Entry, entry);
+}
+
+static gboolean
+add_pattern (SnippetsIndex  *index,
+             SnippetsConfig *config)
+{
+  SnippetsIndexPrivate *priv;
+  Pattern *pattern;
+  GRegex *regex;
+  GError *error = NULL;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+  
+  if (g_list_find_custom (priv->patterns, config, (GCompareFunc) compare_patterns) != NULL)
+    return FALSE;
+    
+  if (has_group_reference (snippets_config_get_trigger (config)))
+    {
+      g_warning ("snippet pattern %s refers to a group by number or calls one, use a named back reference\n", 
+                 snippets_config_get_trigger (config));
+      return FALSE;
+    }
+
+  regex = g_regex_new (snippets_config_get_trigger (config), 0, 0, &error);
+  if (regex == NULL)
+    {
+      g_warning ("could not compile snippet pattern %s: %s\n", 
+                 snippets_config_get_trigger (config), error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+  
+  pattern = g_slice_new (Pattern);
+  pattern->config = config;
+  pattern->n_groups = g_regex_get_capture_count (regex);
+  g_regex_unref (regex);
+
+  priv->patterns = g_list_append (priv->patterns, pattern);
+  g_hash_table_remove_all (priv->alternations);
+  
+  return TRUE;
+}
+
+static gboolean
+remove_pattern (SnippetsIndex  *index,
+                SnippetsConfig *config)
+{
+  SnippetsIndexPrivate *priv;
+  GList *list;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  list = g_list_find_custom (priv->patterns, config, (GCompareFunc) compare_patterns);
+  if (list == NULL)
+    return FALSE;
+    
+  g_slice_free (Pattern, list->data);
+  priv->patterns = g_list_delete_link (priv->patterns, list);
+  g_hash_table_remove_all (priv->alternations);
+  
+  return TRUE;
+}
+
+/*
+ * Wrapping a pattern in the alternation shifts the numbers of its groups
+ * and puts other patterns around it. A back reference by number such as
+ * \1 or \g{-1}, a call such as (?1), (?-1), (?&name), (?P>name) or
+ * \g<1>, or a recursion through (?R) would then reach into some other
+ * pattern. Named back references are fine. Character classes and \Q..\E
+ * are skipped, a \1 in there is not a reference.
+ */
+static gboolean
+has_group_reference (const gchar *pattern)
+{
+  const gchar *p = pattern;
+
+  while (*p != '\0')
+    {
+      if (p[0] == '\\' && p[1] == 'Q')
+        {
+          const gchar *end = strstr (p + 2, "\\E");
+          if (end == NULL)
+            return FALSE;
+          p = end + 2;
+        }
+      else if (p[0] == '\\')
+        {
+          if (p[1] >= '1' && p[1] <= '9')
+            return TRUE;
+
+          if (p[1] == 'g')
+            {
+              const gchar *number = p + 2;
+              if (*number == '<' || *number == '\'')
+                return TRUE;
+              if (*number == '{')
+                number++;
+              if (*number == '-' || *number == '+' || g_ascii_isdigit (*number))
+                return TRUE;
+            }
+
+          p += p[1] != '\0' ? 2 : 1;
+        }
+      else if (p[0] == '(' && p[1] == '?')
+        {
+          const gchar *call = p + 2;
+          if (*call == 'R' || *call == '&' || g_ascii_isdigit (*call) ||
+              ((*call == '-' || *call == '+') && g_ascii_isdigit (call[1])) ||
+              (call[0] == 'P' && call[1] == '>'))
+            return TRUE;
+          p += 2;
+        }
+      else if (p[0] == '[')
+        {
+          /* a ] right at the start of a class is one of its characters */
+          p++;
+          if (*p == '^')
+            p++;
+          if (*p == ']')
+            p++;
+
+          while (*p != '\0' && *p != ']')
+            {
+              if (p[0] == '[' && p[1] == ':')
+                {
+                  const gchar *end = strstr (p + 2, ":]");
+                  p = end != NULL ? end + 2 : p + 1;
+                }
+              else if (p[0] == '\\' && p[1] != '\0')
+                {
+                  p += 2;
+                }
+              else
+                {
+                  p++;
+                }
+            }
+
+          if (*p == ']')
+            p++;
+        }
+      else
+        {
+          p++;
+        }
+    }
+
+  return FALSE;
+}
+
+/*
+ * Each pattern is wrapped in a group of its own so that we can tell which
+ * one matched, its groups follow right behind. The whole is compiled with
+ * G_REGEX_OPTIMIZE once per set of file types and then kept until the
+ * patterns change, so the number of them stays with the file types in use
+ * rather than with the files opened.
+ */
+static Alternation*
+get_alternation (SnippetsIndex *index,
+                 const gchar   *file_path)
+{
+  SnippetsIndexPrivate *priv;
+  const SnippetsFileTypeSet *document;
+  Alternation *alternation;
+  GString *source;
+  GList *list;
+  gint group = 1;
+
+  priv = SNIPPETS_INDEX_GET_PRIVATE (index);
+
+  document = get_document (index, file_path);
+
+  alternation = g_hash_table_lookup (priv->alternations, document);
+  if (alternation != NULL)
+    return alternation;
+
+  alternation = g_slice_new0 (Alternation);
+  alternation->patterns = g_ptr_array_new ();
+  alternation->groups = g_array_new (FALSE, FALSE, sizeof (gint));
+  
+  source = g_string_new ("(?:");
+
+  for (list = priv->patterns; list != NULL; list = g_list_next (list))
+    {
+      Pattern *pattern = list->data;
+      
+      if (!is_applicable (pattern->config, document))
+        continue;
+        
+      if (alternation->patterns->len > 0)
+        g_string_append_c (source, '|');
+        
+      g_string_append_c (source, '(');
+      g_string_append (source, snippets_config_get_trigger (pattern->config));
+      g_string_append_c (source, ')');
+      
+      g_ptr_array_add (alternation->patterns, pattern);
+      g_array_append_val (alternation->groups, group);
+      group += pattern->n_groups + 1;
+    }
+    
+  g_string_append (source, ")$");
+    
+  if (alternation->patterns->len > 0)
+    {
+      GError *error = NULL;
+      alternation->regex = g_regex_new (source->str, G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES, 
+                                        0, &error);
+      if (error != NULL)
+        {
+          g_warning ("could not compile snippet patterns: %s\n", error->message);
+          g_error_free (error);
+        }
+    }
+  
+  g_string_free (source, TRUE);
+  g_hash_table_insert (priv->alternations, snippets_file_types_copy (document), alternation);
+
+  return alternation;
+}
+
+static void
+alternation_free (Alternation *alternation)
+{
+  if (alternation->regex != NULL)
+    g_regex_unref (alternation->regex);
+  g_ptr_array_free (alternation->patterns, TRUE);
+  g_array_free (alternation->groups, TRUE);
+  g_slice_free (Alternation, alternation);
+}
+
+static gint
+compare_patterns (Pattern        *pattern,
+                  SnippetsConfig *config)
+{
+  return pattern->config == config ? 0 : 1;
+}
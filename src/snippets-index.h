@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_INDEX_H__
+#define	__SNIPPETS_INDEX_H__
+
+#include <gtk/gtk.h>
+#include "snippets-config.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_INDEX_TYPE            (snippets_index_get_type ())
+#define SNIPPETS_INDEX(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_INDEX_TYPE, SnippetsIndex))
+#define SNIPPETS_INDEX_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_INDEX_TYPE, SnippetsIndexClass))
+#define IS_SNIPPETS_INDEX(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_INDEX_TYPE))
+#define IS_SNIPPETS_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_INDEX_TYPE))
+
+typedef struct _SnippetsIndex SnippetsIndex;
+typedef struct _SnippetsIndexClass SnippetsIndexClass;
+typedef struct _SnippetsConflict SnippetsConflict;
+
+struct _SnippetsIndex
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsIndexClass
+{
+  GObjectClass parent_class;
+};
+
+struct _SnippetsConflict
+{
+  SnippetsConfig *winner;
+  SnippetsConfig *loser;
+  gboolean        shadowed;
+};
+
+GType snippets_index_get_type (void) G_GNUC_CONST;
+
+SnippetsIndex*   snippets_index_new            (void);
+
+void             snippets_index_add            (SnippetsIndex  *index,
+                                                SnippetsConfig *config);
+void             snippets_index_remove         (SnippetsIndex  *index,
+                                                SnippetsConfig *config);
+SnippetsConfig*  snippets_index_lookup         (SnippetsIndex  *index,
+                                                const gchar    *trigger,
+                                                const gchar    *file_path);
+void             snippets_index_lookup_trigger (SnippetsIndex  *index,
+                                                const gchar    *trigger,
+                                                GPtrArray      *results);
+void             snippets_index_lookup_all     (SnippetsIndex  *index,
+                                                const gchar    *trigger,
+                                                const gchar    *file_path,
+                                                GPtrArray      *results);
+GList*           snippets_index_lookup_prefix  (SnippetsIndex  *index,
+                                                const gchar    *prefix,
+                                                const gchar    *file_path,
+                                                guint           limit);
+SnippetsConfig*  snippets_index_lookup_fuzzy   (SnippetsIndex  *index,
+                                                const gchar    *word,
+                                                const gchar    *file_path);
+SnippetsConfig*  snippets_index_lookup_pattern (SnippetsIndex  *index,
+                                                const gchar    *text,
+                                                const gchar    *file_path,
+                                                gint           *match_start,
+                                                gchar        ***groups);
+GArray*          snippets_index_get_conflicts  (SnippetsIndex  *index,
+                                                SnippetsConfig *config);
+const SnippetsFileTypeSet* snippets_index_get_file_types (SnippetsIndex *index,
+                                                          const gchar   *file_path);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_INDEX_H__ */
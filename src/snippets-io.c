@@ -0,0 +1,2203 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+#include <codeslayer/codeslayer-utils.h>
+#include "snippets-io.h"
+#include "snippets-config.h"
+
+#define LIBRARY_VERSION 2
+#define READ_BUFFER_SIZE 65536
+#define MIN_SNIPPET_SIZE 10
+#define FILE_TYPES_COMMENT "# file_types: "
+#define IMPORT_CHUNK_SIZE 500
+
+/* the columns of language_file_types */
+#define LANGUAGE_ULTISNIPS 0
+#define LANGUAGE_VSCODE 1
+#define LANGUAGE_TEXTMATE 2
+#define LANGUAGE_FILE_TYPES 3
+
+typedef struct
+{
+  GFunc     func;
+  gpointer  data;
+  GList    *configs;
+  guint     length;
+  guint     count;
+} Import;
+
+static SnippetsConfig* load_snippet (xmlNode           *node,
+                                     GHashTable        *bodies,
+                                     GError           **error);
+static GHashTable* load_bodies      (xmlNode           *root);
+static gboolean write_library       (xmlDoc            *doc,
+                                     const gchar       *file_path,
+                                     GError           **error);
+static void save_bodies             (xmlNode           *root,
+                                     GList             *configs,
+                                     GHashTable        *bodies);
+static void save_snippet            (xmlNode           *root,
+                                     SnippetsConfig    *config,
+                                     GChecksum         *checksum,
+                                     GHashTable        *bodies);
+static void save_attribute          (xmlNode           *node,
+                                     GChecksum         *checksum,
+                                     const gchar       *name,
+                                     const gchar       *value);
+static guint get_number             (xmlNode           *node,
+                                     const gchar       *name,
+                                     guint              fallback);
+static guint parse_number           (xmlChar           *value,
+                                     guint              fallback);
+static void add_import              (Import            *import,
+                                     SnippetsConfig    *config);
+static void flush_import            (Import            *import);
+static void import_jsonl            (GDataInputStream  *data_stream,
+                                     Import            *import,
+                                     GError           **error);
+static void import_ultisnips        (GDataInputStream  *data_stream,
+                                     const gchar       *file_path,
+                                     Import            *import,
+                                     GError           **error);
+static void import_vscode           (GInputStream      *stream,
+                                     const gchar       *file_path,
+                                     Import            *import,
+                                     GError           **error);
+static void import_textmate         (const gchar       *file_path,
+                                     Import            *import,
+                                     GError           **error);
+static gchar* read_textmate_string  (xmlTextReader     *reader);
+static gboolean export_jsonl        (GOutputStream     *stream,
+                                     GList             *configs,
+                                     GError           **error);
+static gboolean export_ultisnips    (GOutputStream     *stream,
+                                     GList             *configs,
+                                     GError           **error);
+static gboolean export_vscode       (GOutputStream     *stream,
+                                     GList             *configs,
+                                     GError           **error);
+static gboolean export_textmate     (GOutputStream     *stream,
+                                     GList             *configs,
+                                     GError           **error);
+static SnippetsConfig* parse_jsonl  (const gchar       *line);
+static SnippetsConfig* parse_vscode_entry (const gchar *entry,
+                                           const gchar *file_types);
+static gboolean parse_json_string   (const gchar      **cursor,
+                                     GString           *string);
+static gboolean parse_json_text     (const gchar      **cursor,
+                                     GString           *string,
+                                     GString           *scratch);
+static void skip_json_value         (const gchar      **cursor);
+static void append_json_string      (GString           *string,
+                                     const gchar       *text);
+static void append_xml_string       (GString           *string,
+                                     const gchar       *text);
+static SnippetsConfig* parse_ultisnips_header (const gchar *line,
+                                               const gchar *file_types);
+static gint get_endsnippet_escapes  (const gchar       *line,
+                                     gsize              length);
+static gchar* get_ultisnips_file_types (const gchar    *file_path);
+static gchar* get_vscode_file_types (const gchar       *file_path);
+static gchar* get_scope_file_types  (const gchar       *scope,
+                                     gint               column);
+static const gchar* get_language    (const gchar       *file_types,
+                                     gint               column);
+static const gchar* lookup_language (const gchar       *name,
+                                     gsize              length,
+                                     gint               column);
+static gboolean is_ultisnips        (const gchar       *file_path);
+static gboolean is_vscode           (const gchar       *file_path);
+static gboolean is_textmate         (const gchar       *file_path);
+
+/*
+ * The common languages by the names UltiSnips (vim file types), VS Code
+ * (language ids) and TextMate (scopes) give them.
+ */
+static const gchar *language_file_types[][4] = {
+  { "c", "c", "source.c", ".c,.h" },
+  { "cpp", "cpp", "source.c++", ".cpp,.cc,.cxx,.hpp,.hh,.h" },
+  { "cs", "csharp", "source.cs", ".cs" },
+  { "java", "java", "source.java", ".java" },
+  { "javascript", "javascript", "source.js", ".js" },
+  { "python", "python", "source.python", ".py" },
+  { "ruby", "ruby", "source.ruby", ".rb" },
+  { "perl", "perl", "source.perl", ".pl,.pm" },
+  { "sh", "shellscript", "source.shell", ".sh" },
+  { "html", "html", "text.html", ".html,.htm" },
+  { "xml", "xml", "text.xml", ".xml" },
+  { "make", "makefile", "source.makefile", "Makefile,.mk,.am" },
+  { NULL, NULL, NULL, NULL }
+};
+
+/*
+ * The library is kept as snippets.xml. The root carries the version of
+ * the format, the number of snippets and a hash of their content, so a
+ * reader can size things up front and tell whether anything built from
+ * the file is stale without reading the snippets. Files from before
+ * the version was written count as version 1.
+ *
+ * Since version 2 every snippet has an id attribute, 16 hex digits that
+ * stay with it across saves, the snippets of a version 1 file get new
+ * ones. A body used by more than one snippet is written once in a body
+ * element under the root, keyed by the SHA-256 of its text, and the
+ * snippets name it through a body-ref attribute. A reference that does
+ * not resolve fails the load rather than leaving the snippet empty.
+ *
+ * A file from a newer version is read as far as it can be, but it is
+ * never written over, see snippets_io_save.
+ */
+GList*
+snippets_io_load (const gchar  *file_path,
+                  GError      **error)
+{
+  GList *configs = NULL;
+  GPtrArray *loaded;
+  GHashTable *bodies;
+  xmlDoc *doc;
+  xmlNode *root;
+  xmlNode *node;
+  GStatBuf buf;
+  guint version;
+  guint count;
+  guint i;
+
+  doc = xmlReadFile (file_path, NULL, XML_PARSE_NONET);
+  if (doc == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, 
+                   "could not parse %s", file_path);
+      return NULL;
+    }
+
+  root = xmlDocGetRootElement (doc);
+  if (root == NULL || xmlStrcmp (root->name, BAD_CAST "snippets") != 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, 
+                   "%s is not a snippets library", file_path);
+      xmlFreeDoc (doc);
+      return NULL;
+    }
+
+  version = get_number (root, "version", 1);
+  if (version > LIBRARY_VERSION)
+    g_warning ("snippets file %s is from a newer version, changes will not be saved to it\n", 
+               file_path);
+
+  /* a count the file is too small to hold is not trusted */
+  count = get_number (root, "count", 0);
+  if (g_stat (file_path, &buf) == 0)
+    count = (guint) MIN ((goffset) count, (goffset) buf.st_size / MIN_SNIPPET_SIZE);
+  else
+    count = 0;
+
+  loaded = g_ptr_array_sized_new (count);
+
+  bodies = load_bodies (root);
+
+  /* only the snippets right under the root, nothing nested any deeper */
+  for (node = root->children; node != NULL; node = node->next)
+    {
+      SnippetsConfig *config;
+
+      if (node->type != XML_ELEMENT_NODE || 
+          xmlStrcmp (node->name, BAD_CAST "snippet") != 0)
+        continue;
+
+      config = load_snippet (node, bodies, error);
+      if (config == NULL)
+        {
+          g_ptr_array_foreach (loaded, (GFunc) g_object_unref, NULL);
+          g_ptr_array_set_size (loaded, 0);
+          break;
+        }
+
+      g_ptr_array_add (loaded, config);
+    }
+
+  g_hash_table_destroy (bodies);
+  xmlFreeDoc (doc);
+
+  for (i = loaded->len; i > 0; i--)
+    configs = g_list_prepend (configs, g_ptr_array_index (loaded, i - 1));
+
+  g_ptr_array_free (loaded, TRUE);
+
+  return configs;
+}
+
+gboolean
+snippets_io_save (const gchar  *file_path,
+                  GList        *configs,
+                  GError      **error)
+{
+  GChecksum *checksum;
+  GHashTable *bodies;
+  xmlDoc *doc;
+  xmlNode *root;
+  gchar *number;
+  gchar *hash = NULL;
+  guint version = 0;
+  guint count = 0;
+  gboolean unchanged;
+  gboolean result = TRUE;
+  GList *list;
+
+  if (g_file_test (file_path, G_FILE_TEST_EXISTS) &&
+      snippets_io_read_header (file_path, &version, NULL, &hash, NULL) &&
+      version > LIBRARY_VERSION)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, 
+                   "%s is from a newer version and would lose what this one does not know", 
+                   file_path);
+      g_free (hash);
+      return FALSE;
+    }
+
+  doc = xmlNewDoc (BAD_CAST "1.0");
+  root = xmlNewNode (NULL, BAD_CAST "snippets");
+  xmlDocSetRootElement (doc, root);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  bodies = g_hash_table_new (g_str_hash, g_str_equal);
+
+  number = g_strdup_printf ("%d", LIBRARY_VERSION);
+  xmlNewProp (root, BAD_CAST "version", BAD_CAST number);
+  g_free (number);
+
+  save_bodies (root, configs, bodies);
+
+  for (list = configs; list != NULL; list = g_list_next (list), count++)
+    save_snippet (root, list->data, checksum, bodies);
+
+  number = g_strdup_printf ("%u", count);
+  xmlNewProp (root, BAD_CAST "count", BAD_CAST number);
+  xmlNewProp (root, BAD_CAST "hash", BAD_CAST g_checksum_get_string (checksum));
+  g_free (number);
+
+  /* nothing to write when the file already holds the same snippets */
+  unchanged = version == LIBRARY_VERSION && 
+              g_strcmp0 (hash, g_checksum_get_string (checksum)) == 0;
+
+  if (!unchanged)
+    result = write_library (doc, file_path, error);
+
+  g_hash_table_destroy (bodies);
+  g_checksum_free (checksum);
+  xmlFreeDoc (doc);
+  g_free (hash);
+
+  return result;
+}
+
+/*
+ * Written next to the library and then renamed over it, so that a crash
+ * or a full disk halfway through leaves the old library as it was.
+ */
+static gboolean
+write_library (xmlDoc       *doc,
+               const gchar  *file_path,
+               GError      **error)
+{
+  gchar *temp_path;
+  gint fd;
+
+  temp_path = g_strconcat (file_path, ".XXXXXX", NULL);
+
+  fd = g_mkstemp_full (temp_path, O_RDWR, 0666);
+  if (fd == -1)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno), 
+                   "could not create a file next to %s: %s", file_path, 
+                   g_strerror (errno));
+      g_free (temp_path);
+      return FALSE;
+    }
+  g_close (fd, NULL);
+
+  if (xmlSaveFormatFileEnc (temp_path, doc, "UTF-8", 1) < 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, 
+                   "could not write %s", temp_path);
+      g_unlink (temp_path);
+      g_free (temp_path);
+      return FALSE;
+    }
+
+  if (g_rename (temp_path, file_path) != 0)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno), 
+                   "could not replace %s: %s", file_path, g_strerror (errno));
+      g_unlink (temp_path);
+      g_free (temp_path);
+      return FALSE;
+    }
+
+  g_free (temp_path);
+  return TRUE;
+}
+
+/*
+ * Reads only as far as the root of the library, so the version, count
+ * and hash can be had without parsing any of the snippets. Any of them
+ * can be NULL, and the hash is NULL for files written without one.
+ */
+gboolean
+snippets_io_read_header (const gchar  *file_path,
+                         guint        *version,
+                         guint        *count,
+                         gchar       **hash,
+                         GError      **error)
+{
+  xmlTextReader *reader;
+  gboolean result = FALSE;
+  gint status;
+
+  reader = xmlReaderForFile (file_path, NULL, XML_PARSE_NONET);
+  if (reader == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, 
+                   "could not open %s", file_path);
+      return FALSE;
+    }
+
+  do
+    status = xmlTextReaderRead (reader);
+  while (status == 1 && xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT);
+
+  if (status == 1 && 
+      xmlStrcmp (xmlTextReaderConstLocalName (reader), BAD_CAST "snippets") == 0)
+    {
+      if (version != NULL)
+        *version = parse_number (xmlTextReaderGetAttribute (reader, BAD_CAST "version"), 1);
+      if (count != NULL)
+        *count = parse_number (xmlTextReaderGetAttribute (reader, BAD_CAST "count"), 0);
+      if (hash != NULL)
+        {
+          xmlChar *value = xmlTextReaderGetAttribute (reader, BAD_CAST "hash");
+          *hash = value != NULL ? g_strdup ((gchar*) value) : NULL;
+          xmlFree (value);
+        }
+      result = TRUE;
+    }
+  else
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, 
+                   "%s is not a snippets library", file_path);
+    }
+
+  xmlFreeTextReader (reader);
+
+  return result;
+}
+
+/*
+ * The snippets are handed to func as they are read, IMPORT_CHUNK_SIZE at
+ * a time, in a list that func takes over along with the configs in it.
+ * Returns how many were handed over, which is more than none when the
+ * file broke off with an error partway through.
+ */
+guint
+snippets_io_import (const gchar  *file_path,
+                    GFunc         func,
+                    gpointer      data,
+                    GError      **error)
+{
+  GFile *file;
+  GFileInputStream *stream;
+  GDataInputStream *data_stream;
+  Import import = { func, data, NULL, 0, 0 };
+
+  if (is_textmate (file_path))
+    {
+      import_textmate (file_path, &import, error);
+      flush_import (&import);
+      return import.count;
+    }
+
+  file = g_file_new_for_path (file_path);
+  stream = g_file_read (file, NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return 0;
+
+  data_stream = g_data_input_stream_new (G_INPUT_STREAM (stream));
+  g_buffered_input_stream_set_buffer_size (G_BUFFERED_INPUT_STREAM (data_stream),
+                                           READ_BUFFER_SIZE);
+  g_data_input_stream_set_newline_type (data_stream, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+  if (is_ultisnips (file_path))
+    import_ultisnips (data_stream, file_path, &import, error);
+  else if (is_vscode (file_path))
+    import_vscode (G_INPUT_STREAM (data_stream), file_path, &import, error);
+  else
+    import_jsonl (data_stream, &import, error);
+
+  flush_import (&import);
+
+  g_object_unref (data_stream);
+  g_object_unref (stream);
+
+  return import.count;
+}
+
+gboolean
+snippets_io_export (const gchar  *file_path,
+                    GList        *configs,
+                    GError      **error)
+{
+  GFile *file;
+  GFileOutputStream *stream;
+  gboolean result;
+
+  file = g_file_new_for_path (file_path);
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return FALSE;
+
+  if (is_ultisnips (file_path))
+    result = export_ultisnips (G_OUTPUT_STREAM (stream), configs, error);
+  else if (is_vscode (file_path))
+    result = export_vscode (G_OUTPUT_STREAM (stream), configs, error);
+  else if (is_textmate (file_path))
+    result = export_textmate (G_OUTPUT_STREAM (stream), configs, error);
+  else
+    result = export_jsonl (G_OUTPUT_STREAM (stream), configs, error);
+
+  if (result)
+    result = g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, error);
+
+  g_object_unref (stream);
+
+  return result;
+}
+
+static SnippetsConfig*
+load_snippet (xmlNode     *node,
+              GHashTable  *bodies,
+              GError     **error)
+{
+  SnippetsConfig *config;
+  xmlAttr *attribute;
+  xmlChar *text;
+  xmlChar *ref;
+
+  config = snippets_config_new ();
+
+  for (attribute = node->properties; attribute != NULL; attribute = attribute->next)
+    {
+      const gchar *name = (const gchar*) attribute->name;
+      xmlChar *value;
+
+      value = xmlNodeGetContent ((xmlNode*) attribute);
+
+      if (g_strcmp0 (name, "id") == 0)
+        snippets_config_set_id (config, g_ascii_strtoull ((gchar*) value, NULL, 16));
+      else if (g_strcmp0 (name, "file_types") == 0)
+        snippets_config_set_file_types (config, (gchar*) value);
+      else if (g_strcmp0 (name, "name") == 0)
+        snippets_config_set_name (config, (gchar*) value);
+      else if (g_strcmp0 (name, "trigger") == 0)
+        snippets_config_set_trigger (config, (gchar*) value);
+      else if (g_strcmp0 (name, "contexts") == 0)
+        snippets_config_set_contexts (config, (gchar*) value);
+      else if (g_strcmp0 (name, "pattern") == 0)
+        snippets_config_set_pattern (config, g_strcmp0 ((gchar*) value, "true") == 0);
+      else if (g_strcmp0 (name, "body-ref") != 0)
+        snippets_config_add_extra (config, name, value != NULL ? (gchar*) value : "");
+
+      xmlFree (value);
+    }
+
+  ref = xmlGetProp (node, BAD_CAST "body-ref");
+  if (ref != NULL)
+    {
+      const gchar *shared = g_hash_table_lookup (bodies, ref);
+
+      if (shared == NULL)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, 
+                       "snippet body %s is missing", (gchar*) ref);
+          g_object_unref (config);
+          xmlFree (ref);
+          return NULL;
+        }
+
+      snippets_config_set_text (config, shared);
+      xmlFree (ref);
+      return config;
+    }
+
+  text = xmlNodeGetContent (node);
+  snippets_config_set_text (config, (gchar*) text);
+  xmlFree (text);
+
+  return config;
+}
+
+/*
+ * The shared bodies by their digest, the text is owned by the table.
+ */
+static GHashTable*
+load_bodies (xmlNode *root)
+{
+  GHashTable *bodies;
+  xmlNode *node;
+
+  bodies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  for (node = root->children; node != NULL; node = node->next)
+    {
+      xmlChar *digest;
+      xmlChar *text;
+
+      if (node->type != XML_ELEMENT_NODE || 
+          xmlStrcmp (node->name, BAD_CAST "body") != 0)
+        continue;
+
+      digest = xmlGetProp (node, BAD_CAST "digest");
+      if (digest == NULL)
+        continue;
+
+      text = xmlNodeGetContent (node);
+      g_hash_table_insert (bodies, g_strdup ((gchar*) digest), 
+                           g_strdup (text != NULL ? (gchar*) text : ""));
+      xmlFree (text);
+      xmlFree (digest);
+    }
+
+  return bodies;
+}
+
+/*
+ * Writes every body that more than one snippet uses, once and ahead of
+ * the snippets. The digests come from the configs, which share a body
+ * whenever their text is the same, so nothing has to be hashed here.
+ * The table ends up holding the digests of the bodies written.
+ */
+static void
+save_bodies (xmlNode    *root,
+             GList      *configs,
+             GHashTable *bodies)
+{
+  GHashTable *uses;
+  GString *scratch;
+  GList *list;
+
+  uses = g_hash_table_new (g_str_hash, g_str_equal);
+  scratch = g_string_new (NULL);
+
+  for (list = configs; list != NULL; list = g_list_next (list))
+    {
+      const gchar *digest = snippets_config_get_digest (list->data);
+      if (digest != NULL)
+        g_hash_table_insert (uses, (gpointer) digest, 
+                             GUINT_TO_POINTER (GPOINTER_TO_UINT (g_hash_table_lookup (uses, digest)) + 1));
+    }
+
+  for (list = configs; list != NULL; list = g_list_next (list))
+    {
+      const gchar *digest = snippets_config_get_digest (list->data);
+      const gchar *text;
+      xmlNode *node;
+
+      if (digest == NULL || GPOINTER_TO_UINT (g_hash_table_lookup (uses, digest)) < 2 ||
+          g_hash_table_contains (bodies, digest))
+        continue;
+
+      text = snippets_config_get_text (list->data, scratch);
+      if (*text == '\0')
+        continue;
+
+      node = xmlNewChild (root, NULL, BAD_CAST "body", NULL);
+      xmlNewProp (node, BAD_CAST "digest", BAD_CAST digest);
+
+      /* CDATA cannot hold its own terminator, such text is escaped instead */
+      if (strstr (text, "]]>") != NULL)
+        xmlAddChild (node, xmlNewText (BAD_CAST text));
+      else
+        xmlAddChild (node, xmlNewCDataBlock (root->doc, BAD_CAST text, strlen (text)));
+
+      g_hash_table_add (bodies, (gpointer) digest);
+    }
+
+  g_string_free (scratch, TRUE);
+  g_hash_table_destroy (uses);
+}
+
+/*
+ * Everything written also goes into the checksum, each value closed off
+ * with a nul so that moving text from one field to the next shows up.
+ */
+static void
+save_snippet (xmlNode        *root,
+              SnippetsConfig *config,
+              GChecksum      *checksum,
+              GHashTable     *bodies)
+{
+  const GPtrArray *extras;
+  const gchar *digest;
+  const gchar *text;
+  GString *scratch;
+  xmlNode *node;
+  gchar *id;
+  guint i;
+
+  node = xmlNewChild (root, NULL, BAD_CAST "snippet", NULL);
+
+  id = g_strdup_printf ("%016" G_GINT64_MODIFIER "x", snippets_config_get_id (config));
+  save_attribute (node, checksum, "id", id);
+  g_free (id);
+
+  save_attribute (node, checksum, "file_types", snippets_config_get_file_types (config));
+  save_attribute (node, checksum, "name", snippets_config_get_name (config));
+  save_attribute (node, checksum, "trigger", snippets_config_get_trigger (config));
+
+  if (codeslayer_utils_has_text (snippets_config_get_contexts (config)))
+    save_attribute (node, checksum, "contexts", snippets_config_get_contexts (config));
+
+  if (snippets_config_get_pattern (config))
+    save_attribute (node, checksum, "pattern", "true");
+
+  extras = snippets_config_get_extras (config);
+  for (i = 0; extras != NULL && i + 1 < extras->len; i += 2)
+    save_attribute (node, checksum, g_ptr_array_index (extras, i), 
+                    g_ptr_array_index (extras, i + 1));
+
+  digest = snippets_config_get_digest (config);
+
+  /* the hash covers the body through its digest, shared or not */
+  g_checksum_update (checksum, (const guchar*) (digest != NULL ? digest : ""), -1);
+  g_checksum_update (checksum, (const guchar*) "", 1);
+
+  if (digest != NULL && g_hash_table_contains (bodies, digest))
+    {
+      xmlNewProp (node, BAD_CAST "body-ref", BAD_CAST digest);
+      return;
+    }
+
+  scratch = g_string_new (NULL);
+  text = snippets_config_get_text (config, scratch);
+
+  if (text == NULL || *text == '\0')
+    {
+      g_string_free (scratch, TRUE);
+      return;
+    }
+
+  /* CDATA cannot hold its own terminator, such text is escaped instead */
+  if (strstr (text, "]]>") != NULL)
+    xmlAddChild (node, xmlNewText (BAD_CAST text));
+  else
+    xmlAddChild (node, xmlNewCDataBlock (root->doc, BAD_CAST text, strlen (text)));
+
+  g_string_free (scratch, TRUE);
+}
+
+static void
+save_attribute (xmlNode     *node,
+                GChecksum   *checksum,
+                const gchar *name,
+                const gchar *value)
+{
+  if (value == NULL)
+    value = "";
+
+  xmlNewProp (node, BAD_CAST name, BAD_CAST value);
+
+  g_checksum_update (checksum, (const guchar*) name, -1);
+  g_checksum_update (checksum, (const guchar*) "=", 1);
+  g_checksum_update (checksum, (const guchar*) value, -1);
+  g_checksum_update (checksum, (const guchar*) "", 1);
+}
+
+static guint
+get_number (xmlNode     *node,
+            const gchar *name,
+            guint        fallback)
+{
+  return parse_number (xmlGetProp (node, BAD_CAST name), fallback);
+}
+
+static guint
+parse_number (xmlChar *value,
+              guint    fallback)
+{
+  guint number = fallback;
+
+  if (value != NULL)
+    {
+      number = (guint) g_ascii_strtoull ((gchar*) value, NULL, 10);
+      xmlFree (value);
+    }
+
+  return number;
+}
+
+static void
+add_import (Import         *import,
+            SnippetsConfig *config)
+{
+  import->configs = g_list_prepend (import->configs, config);
+  import->length++;
+  import->count++;
+
+  if (import->length == IMPORT_CHUNK_SIZE)
+    flush_import (import);
+}
+
+static void
+flush_import (Import *import)
+{
+  if (import->configs == NULL)
+    return;
+
+  import->func (g_list_reverse (import->configs), import->data);
+  import->configs = NULL;
+  import->length = 0;
+}
+
+static void
+import_jsonl (GDataInputStream  *data_stream,
+              Import            *import,
+              GError           **error)
+{
+  gchar *line;
+
+  while ((line = g_data_input_stream_read_line (data_stream, NULL, NULL, error)) != NULL)
+    {
+      SnippetsConfig *config;
+
+      if (g_utf8_validate (line, -1, NULL))
+        {
+          config = parse_jsonl (line);
+          if (config != NULL)
+            add_import (import, config);
+        }
+
+      g_free (line);
+    }
+}
+
+static SnippetsConfig*
+parse_jsonl (const gchar *line)
+{
+  SnippetsConfig *config;
+  const gchar *cursor;
+  GString *key;
+  GString *value;
+  gboolean has_text = FALSE;
+
+  cursor = line;
+  while (g_ascii_isspace (*cursor))
+    cursor++;
+
+  if (*cursor != '{')
+    return NULL;
+  cursor++;
+
+  config = snippets_config_new ();
+  key = g_string_new (NULL);
+  value = g_string_new (NULL);
+
+  while (TRUE)
+    {
+      while (g_ascii_isspace (*cursor) || *cursor == ',')
+        cursor++;
+
+      if (*cursor == '}' || *cursor == '\0')
+        break;
+
+      if (!parse_json_string (&cursor, key))
+        break;
+
+      while (g_ascii_isspace (*cursor))
+        cursor++;
+      if (*cursor != ':')
+        break;
+      cursor++;
+      while (g_ascii_isspace (*cursor))
+        cursor++;
+
+      if (*cursor != '"')
+        {
+          if (g_strcmp0 (key->str, "pattern") == 0)
+            snippets_config_set_pattern (config, g_str_has_prefix (cursor, "true"));
+          skip_json_value (&cursor);
+          continue;
+        }
+
+      if (!parse_json_string (&cursor, value))
+        break;
+
+      if (g_strcmp0 (key->str, "file_types") == 0)
+        snippets_config_set_file_types (config, value->str);
+      else if (g_strcmp0 (key->str, "name") == 0)
+        snippets_config_set_name (config, value->str);
+      else if (g_strcmp0 (key->str, "trigger") == 0)
+        snippets_config_set_trigger (config, value->str);
+      else if (g_strcmp0 (key->str, "text") == 0)
+        {
+          snippets_config_set_text (config, value->str);
+          has_text = TRUE;
+        }
+      else if (g_strcmp0 (key->str, "contexts") == 0)
+        snippets_config_set_contexts (config, value->str);
+    }
+
+  g_string_free (key, TRUE);
+  g_string_free (value, TRUE);
+
+  if (snippets_config_get_trigger (config) == NULL || !has_text)
+    {
+      g_object_unref (config);
+      return NULL;
+    }
+
+  if (snippets_config_get_file_types (config) == NULL)
+    snippets_config_set_file_types (config, "");
+  if (snippets_config_get_name (config) == NULL)
+    snippets_config_set_name (config, snippets_config_get_trigger (config));
+
+  return config;
+}
+
+static gboolean
+parse_json_string (const gchar **cursor,
+                   GString      *string)
+{
+  const gchar *p = *cursor;
+
+  g_string_truncate (string, 0);
+
+  if (*p != '"')
+    return FALSE;
+  p++;
+
+  while (*p != '"')
+    {
+      if (*p == '\0')
+        return FALSE;
+
+      if (*p != '\\')
+        {
+          g_string_append_c (string, *p);
+          p++;
+          continue;
+        }
+
+      p++;
+      switch (*p)
+        {
+        case 'n': g_string_append_c (string, '\n'); break;
+        case 't': g_string_append_c (string, '\t'); break;
+        case 'r': g_string_append_c (string, '\r'); break;
+        case 'b': g_string_append_c (string, '\b'); break;
+        case 'f': g_string_append_c (string, '\f'); break;
+        case 'u':
+          {
+            gunichar c = 0;
+            gint i;
+
+            for (i = 1; i <= 4; i++)
+              {
+                if (!g_ascii_isxdigit (p[i]))
+                  return FALSE;
+                c = (c << 4) | g_ascii_xdigit_value (p[i]);
+              }
+            p += 4;
+
+            /* a high surrogate should be followed by its low half */
+            if (c >= 0xD800 && c <= 0xDBFF && p[1] == '\\' && p[2] == 'u')
+              {
+                gunichar low = 0;
+
+                for (i = 3; i <= 6; i++)
+                  {
+                    if (!g_ascii_isxdigit (p[i]))
+                      return FALSE;
+                    low = (low << 4) | g_ascii_xdigit_value (p[i]);
+                  }
+
+                if (low >= 0xDC00 && low <= 0xDFFF)
+                  {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                  }
+              }
+
+            /* the text is kept NUL terminated, so a NUL cannot be in it */
+            if (c == 0)
+              return FALSE;
+
+            if (g_unichar_validate (c))
+              g_string_append_unichar (string, c);
+          }
+          break;
+        case '\0':
+          return FALSE;
+        default:
+          g_string_append_c (string, *p);
+          break;
+        }
+      p++;
+    }
+
+  *cursor = p + 1;
+  return TRUE;
+}
+
+static void
+skip_json_value (const gchar **cursor)
+{
+  const gchar *p = *cursor;
+  gint depth = 0;
+
+  while (*p != '\0')
+    {
+      if (*p == '"')
+        {
+          p++;
+          while (*p != '\0' && *p != '"')
+            {
+              if (*p == '\\' && p[1] != '\0')
+                p++;
+              p++;
+            }
+          if (*p == '\0')
+            break;
+        }
+      else if (*p == '{' || *p == '[')
+        {
+          depth++;
+        }
+      else if (*p == '}' || *p == ']')
+        {
+          if (depth == 0)
+            break;
+          depth--;
+        }
+      else if (*p == ',' && depth == 0)
+        {
+          break;
+        }
+      p++;
+    }
+
+  *cursor = p;
+}
+
+/*
+ * A VS Code snippets file is a single object, so it is read in blocks
+ * and cut into its members as they go by: once the value of one has
+ * closed, the member is parsed on its own with the JSONL parser's string
+ * reading, and only one snippet is held at a time. Comments, which VS
+ * Code allows, are dropped on the way.
+ */
+static void
+import_vscode (GInputStream  *stream,
+               const gchar   *file_path,
+               Import        *import,
+               GError       **error)
+{
+  GString *entry;
+  gchar *buffer;
+  gchar *default_file_types;
+  gssize length;
+  gint depth = 0;
+  gboolean in_string = FALSE;
+  gboolean escaped = FALSE;
+  gboolean line_comment = FALSE;
+  gboolean block_comment = FALSE;
+  gboolean slash = FALSE;
+  gboolean star = FALSE;
+  guint skipped = 0;
+
+  default_file_types = get_vscode_file_types (file_path);
+  entry = g_string_sized_new (1024);
+  buffer = g_malloc (READ_BUFFER_SIZE);
+
+  while ((length = g_input_stream_read (stream, buffer, READ_BUFFER_SIZE, NULL, error)) > 0)
+    {
+      gssize i;
+
+      for (i = 0; i < length; i++)
+        {
+          gchar c = buffer[i];
+
+          if (line_comment)
+            {
+              line_comment = c != '\n';
+              continue;
+            }
+
+          if (block_comment)
+            {
+              block_comment = !(star && c == '/');
+              star = c == '*';
+              continue;
+            }
+
+          if (in_string)
+            {
+              if (escaped)
+                escaped = FALSE;
+              else if (c == '\\')
+                escaped = TRUE;
+              else if (c == '"')
+                in_string = FALSE;
+              if (depth > 0)
+                g_string_append_c (entry, c);
+              continue;
+            }
+
+          if (slash)
+            {
+              slash = FALSE;
+              line_comment = c == '/';
+              block_comment = c == '*';
+              star = FALSE;
+              if (line_comment || block_comment)
+                continue;
+            }
+
+          switch (c)
+            {
+            case '/':
+              slash = TRUE;
+              break;
+            case '"':
+              in_string = TRUE;
+              if (depth > 0)
+                g_string_append_c (entry, c);
+              break;
+            case '{':
+            case '[':
+              if (depth > 0)
+                g_string_append_c (entry, c);
+              depth++;
+              break;
+            case '}':
+            case ']':
+              if (depth > 0)
+                depth--;
+              if (depth > 0)
+                g_string_append_c (entry, c);
+              if (depth == 1 && c == '}')
+                {
+                  SnippetsConfig *config = NULL;
+
+                  if (g_utf8_validate (entry->str, entry->len, NULL))
+                    config = parse_vscode_entry (entry->str, default_file_types);
+                  else
+                    skipped++;
+
+                  if (config != NULL)
+                    add_import (import, config);
+                  g_string_truncate (entry, 0);
+                }
+              break;
+            case ',':
+              /* whatever was not a snippet ends at the next member */
+              if (depth == 1)
+                g_string_truncate (entry, 0);
+              else if (depth > 1)
+                g_string_append_c (entry, c);
+              break;
+            default:
+              if (depth > 0)
+                g_string_append_c (entry, c);
+              break;
+            }
+        }
+    }
+
+  if (skipped > 0)
+    g_warning ("skipped %u snippets of %s that are not valid UTF-8\n", skipped, file_path);
+
+  g_free (buffer);
+  g_free (default_file_types);
+  g_string_free (entry, TRUE);
+}
+
+/*
+ * One member of a VS Code snippets file, its name then an object with
+ * the prefix and body, either of which can be an array. Only the first
+ * prefix becomes the trigger. The file types written by the export win
+ * over the scope, which wins over the language the file is named after.
+ */
+static SnippetsConfig*
+parse_vscode_entry (const gchar *entry,
+                    const gchar *file_types)
+{
+  SnippetsConfig *config;
+  const gchar *cursor;
+  GString *key;
+  GString *value;
+  GString *scratch;
+  gchar *scope = NULL;
+  gboolean has_text = FALSE;
+  gboolean has_file_types = FALSE;
+
+  key = g_string_new (NULL);
+
+  cursor = entry;
+  while (g_ascii_isspace (*cursor))
+    cursor++;
+
+  if (!parse_json_string (&cursor, key))
+    {
+      g_string_free (key, TRUE);
+      return NULL;
+    }
+
+  while (g_ascii_isspace (*cursor))
+    cursor++;
+  if (*cursor == ':')
+    cursor++;
+  while (g_ascii_isspace (*cursor))
+    cursor++;
+
+  if (*cursor != '{')
+    {
+      g_string_free (key, TRUE);
+      return NULL;
+    }
+  cursor++;
+
+  config = snippets_config_new ();
+  snippets_config_set_name (config, key->str);
+
+  value = g_string_new (NULL);
+  scratch = g_string_new (NULL);
+
+  while (TRUE)
+    {
+      while (g_ascii_isspace (*cursor) || *cursor == ',')
+        cursor++;
+
+      if (*cursor == '}' || *cursor == '\0')
+        break;
+
+      if (!parse_json_string (&cursor, key))
+        break;
+
+      while (g_ascii_isspace (*cursor))
+        cursor++;
+      if (*cursor != ':')
+        break;
+      cursor++;
+      while (g_ascii_isspace (*cursor))
+        cursor++;
+
+      if (*cursor != '"' && *cursor != '[')
+        {
+          skip_json_value (&cursor);
+          continue;
+        }
+
+      if (!parse_json_text (&cursor, value, scratch))
+        break;
+
+      if (g_strcmp0 (key->str, "prefix") == 0)
+        {
+          gchar *newline = strchr (value->str, '\n');
+          if (newline != NULL)
+            g_string_truncate (value, newline - value->str);
+          if (value->len > 0)
+            snippets_config_set_trigger (config, value->str);
+        }
+      else if (g_strcmp0 (key->str, "body") == 0)
+        {
+          snippets_config_set_text (config, value->str);
+          has_text = TRUE;
+        }
+      else if (g_strcmp0 (key->str, "scope") == 0)
+        {
+          g_free (scope);
+          scope = g_strdup (value->str);
+        }
+      else if (g_strcmp0 (key->str, "file_types") == 0)
+        {
+          snippets_config_set_file_types (config, value->str);
+          has_file_types = TRUE;
+        }
+    }
+
+  if (!has_file_types)
+    {
+      if (scope != NULL)
+        {
+          gchar *scope_file_types = get_scope_file_types (scope, LANGUAGE_VSCODE);
+          snippets_config_set_file_types (config, scope_file_types);
+          g_free (scope_file_types);
+        }
+      else
+        {
+          snippets_config_set_file_types (config, file_types);
+        }
+    }
+
+  g_free (scope);
+  g_string_free (scratch, TRUE);
+  g_string_free (value, TRUE);
+  g_string_free (key, TRUE);
+
+  if (snippets_config_get_trigger (config) == NULL || !has_text)
+    {
+      g_object_unref (config);
+      return NULL;
+    }
+
+  return config;
+}
+
+/*
+ * A string, or an array of strings that are joined as lines.
+ */
+static gboolean
+parse_json_text (const gchar **cursor,
+                 GString      *string,
+                 GString      *scratch)
+{
+  const gchar *p = *cursor;
+  gboolean first = TRUE;
+
+  if (*p == '"')
+    return parse_json_string (cursor, string);
+
+  g_string_truncate (string, 0);
+
+  if (*p != '[')
+    return FALSE;
+  p++;
+
+  while (TRUE)
+    {
+      while (g_ascii_isspace (*p))
+        p++;
+
+      if (*p == ']')
+        break;
+
+      if (!parse_json_string (&p, scratch))
+        return FALSE;
+
+      if (!first)
+        g_string_append_c (string, '\n');
+      g_string_append_len (string, scratch->str, scratch->len);
+      first = FALSE;
+
+      while (g_ascii_isspace (*p))
+        p++;
+      if (*p == ',')
+        p++;
+    }
+
+  *cursor = p + 1;
+  return TRUE;
+}
+
+static void
+import_ultisnips (GDataInputStream  *data_stream,
+                  const gchar       *file_path,
+                  Import            *import,
+                  GError           **error)
+{
+  SnippetsConfig *config = NULL;
+  GString *text;
+  gchar *default_file_types;
+  gchar *file_types = NULL;
+  gchar *line;
+  gboolean skipping = FALSE;
+  guint skipped = 0;
+
+  default_file_types = get_ultisnips_file_types (file_path);
+  text = g_string_new (NULL);
+
+  /*
+   * The library has to stay valid UTF-8, a snippet with a line that is
+   * not is skipped as a whole up to its endsnippet.
+   */
+  while ((line = g_data_input_stream_read_line (data_stream, NULL, NULL, error)) != NULL)
+    {
+      gboolean valid = g_utf8_validate (line, -1, NULL);
+
+      if (config != NULL || skipping)
+        {
+          gint escapes = get_endsnippet_escapes (line, strlen (line));
+
+          if (escapes == 0)
+            {
+              if (config != NULL)
+                {
+                  if (text->len > 0)
+                    g_string_truncate (text, text->len - 1);
+                  snippets_config_set_text (config, text->str);
+                  add_import (import, config);
+                  config = NULL;
+                }
+              skipping = FALSE;
+            }
+          else if (!valid)
+            {
+              if (config != NULL)
+                {
+                  g_object_unref (config);
+                  config = NULL;
+                  skipped++;
+                }
+              skipping = TRUE;
+            }
+          else if (config != NULL)
+            {
+              /* an escaped endsnippet in the body loses one backslash */
+              g_string_append (text, escapes > 0 ? line + 1 : line);
+              g_string_append_c (text, '\n');
+            }
+        }
+      else if (g_str_has_prefix (line, FILE_TYPES_COMMENT))
+        {
+          g_free (file_types);
+          file_types = NULL;
+          if (valid)
+            file_types = g_strstrip (g_strdup (line + strlen (FILE_TYPES_COMMENT)));
+        }
+      else if (g_str_has_prefix (line, "snippet "))
+        {
+          if (valid)
+            config = parse_ultisnips_header (line + strlen ("snippet "),
+                                             file_types != NULL ? file_types : default_file_types);
+          else
+            skipped++;
+          skipping = !valid;
+          g_string_truncate (text, 0);
+          g_free (file_types);
+          file_types = NULL;
+        }
+
+      g_free (line);
+    }
+
+  /* an unterminated snippet at the end of the file is dropped */
+  if (config != NULL)
+    g_object_unref (config);
+
+  if (skipped > 0)
+    g_warning ("skipped %u snippets of %s that are not valid UTF-8\n", skipped, file_path);
+
+  g_free (file_types);
+  g_free (default_file_types);
+  g_string_free (text, TRUE);
+}
+
+static SnippetsConfig*
+parse_ultisnips_header (const gchar *line,
+                        const gchar *file_types)
+{
+  SnippetsConfig *config;
+  const gchar *start;
+  const gchar *end;
+  gchar *trigger;
+  gchar *name = NULL;
+  gboolean pattern = FALSE;
+  gboolean quoted = FALSE;
+
+  while (g_ascii_isspace (*line))
+    line++;
+
+  if (*line == '\0')
+    return NULL;
+
+  /* a trigger with spaces in it is wrapped in quotes */
+  if (*line == '"' && strchr (line + 1, '"') != NULL)
+    {
+      start = line + 1;
+      end = strchr (start, '"');
+      trigger = g_strndup (start, end - start);
+      line = end + 1;
+      quoted = TRUE;
+    }
+  else
+    {
+      start = line;
+      end = line;
+      while (*end != '\0' && !g_ascii_isspace (*end))
+        end++;
+      trigger = g_strndup (start, end - start);
+      line = end;
+    }
+
+  while (g_ascii_isspace (*line))
+    line++;
+
+  if (*line == '"')
+    {
+      start = line + 1;
+      end = strrchr (start, '"');
+      if (end != NULL)
+        {
+          name = g_strndup (start, end - start);
+          line = end + 1;
+        }
+    }
+
+  /* the r option makes the trigger a regular expression between delimiters */
+  if (name != NULL && strchr (line, 'r') != NULL)
+    {
+      gsize length = strlen (trigger);
+      pattern = TRUE;
+      if (!quoted && length > 2 && trigger[0] == trigger[length - 1] && 
+          !g_ascii_isalnum (trigger[0]))
+        {
+          memmove (trigger, trigger + 1, length - 2);
+          trigger[length - 2] = '\0';
+        }
+    }
+
+  config = snippets_config_new ();
+  snippets_config_set_file_types (config, file_types);
+  snippets_config_set_trigger (config, trigger);
+  snippets_config_set_name (config, name != NULL ? name : trigger);
+  snippets_config_set_pattern (config, pattern);
+
+  g_free (trigger);
+  g_free (name);
+
+  return config;
+}
+
+/*
+ * TextMate keeps each snippet in a property list of its own, a dict at
+ * the root. The export writes a whole library as an array of them, so
+ * both are read, a snippet dict at a time through the xml reader.
+ */
+static void
+import_textmate (const gchar  *file_path,
+                 Import       *import,
+                 GError      **error)
+{
+  xmlTextReader *reader;
+  gchar *key = NULL;
+  gchar *content = NULL;
+  gchar *name = NULL;
+  gchar *trigger = NULL;
+  gchar *scope = NULL;
+  gchar *file_types = NULL;
+  gint snippet_depth = -1;
+  gint status;
+
+  reader = xmlReaderForFile (file_path, NULL, XML_PARSE_NONET);
+  if (reader == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, 
+                   "could not open %s", file_path);
+      return;
+    }
+
+  while ((status = xmlTextReaderRead (reader)) == 1)
+    {
+      const xmlChar *element = xmlTextReaderConstLocalName (reader);
+      gint type = xmlTextReaderNodeType (reader);
+      gint depth = xmlTextReaderDepth (reader);
+      gchar **field = NULL;
+
+      if (snippet_depth < 0)
+        {
+          if (type == XML_READER_TYPE_ELEMENT && 
+              xmlStrcmp (element, BAD_CAST "dict") == 0 &&
+              !xmlTextReaderIsEmptyElement (reader))
+            snippet_depth = depth;
+          continue;
+        }
+
+      if (type == XML_READER_TYPE_END_ELEMENT && depth == snippet_depth)
+        {
+          if (trigger != NULL && content != NULL)
+            {
+              SnippetsConfig *config;
+              gchar *scope_file_types = NULL;
+
+              if (file_types == NULL && scope != NULL)
+                scope_file_types = get_scope_file_types (scope, LANGUAGE_TEXTMATE);
+
+              config = snippets_config_new ();
+              snippets_config_set_file_types (config, file_types != NULL ? file_types :
+                                              scope_file_types != NULL ? scope_file_types : "");
+              snippets_config_set_trigger (config, trigger);
+              snippets_config_set_name (config, name != NULL ? name : trigger);
+              snippets_config_set_text (config, content);
+              add_import (import, config);
+
+              g_free (scope_file_types);
+            }
+
+          g_free (key);
+          g_free (content);
+          g_free (name);
+          g_free (trigger);
+          g_free (scope);
+          g_free (file_types);
+          key = content = name = trigger = scope = file_types = NULL;
+          snippet_depth = -1;
+          continue;
+        }
+
+      if (type != XML_READER_TYPE_ELEMENT || depth != snippet_depth + 1)
+        continue;
+
+      if (xmlStrcmp (element, BAD_CAST "key") == 0)
+        {
+          g_free (key);
+          key = read_textmate_string (reader);
+          continue;
+        }
+
+      /* a value that is not a string is passed over along with its key */
+      if (xmlStrcmp (element, BAD_CAST "string") == 0)
+        {
+          if (g_strcmp0 (key, "content") == 0)
+            field = &content;
+          else if (g_strcmp0 (key, "name") == 0)
+            field = &name;
+          else if (g_strcmp0 (key, "tabTrigger") == 0)
+            field = &trigger;
+          else if (g_strcmp0 (key, "scope") == 0)
+            field = &scope;
+          else if (g_strcmp0 (key, "file_types") == 0)
+            field = &file_types;
+        }
+
+      if (field != NULL)
+        {
+          g_free (*field);
+          *field = read_textmate_string (reader);
+        }
+
+      g_free (key);
+      key = NULL;
+    }
+
+  if (status < 0)
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, 
+                 "%s is not a valid property list", file_path);
+
+  g_free (key);
+  g_free (content);
+  g_free (name);
+  g_free (trigger);
+  g_free (scope);
+  g_free (file_types);
+
+  xmlFreeTextReader (reader);
+}
+
+static gchar*
+read_textmate_string (xmlTextReader *reader)
+{
+  xmlChar *value;
+  gchar *result;
+
+  value = xmlTextReaderReadString (reader);
+  result = g_strdup (value != NULL ? (gchar*) value : "");
+  xmlFree (value);
+
+  return result;
+}
+
+static gchar*
+get_ultisnips_file_types (const gchar *file_path)
+{
+  const gchar *file_types;
+  gchar *basename;
+  gchar *result;
+  gchar *dot;
+  gchar *dash;
+
+  basename = g_path_get_basename (file_path);
+
+  dot = strrchr (basename, '.');
+  if (dot != NULL)
+    *dot = '\0';
+
+  /* python_django.snippets and python-django.snippets are both python */
+  dash = strpbrk (basename, "_-");
+  if (dash != NULL)
+    *dash = '\0';
+
+  file_types = lookup_language (basename, strlen (basename), LANGUAGE_ULTISNIPS);
+  if (file_types != NULL)
+    result = g_strdup (file_types);
+  else
+    result = g_strconcat (".", basename, NULL);
+
+  g_free (basename);
+
+  return result;
+}
+
+/*
+ * VS Code keeps the snippets of a language in <language id>.json, those
+ * in *.code-snippets name their languages in a scope of their own.
+ */
+static gchar*
+get_vscode_file_types (const gchar *file_path)
+{
+  gchar *basename;
+  gchar *file_types;
+
+  if (!g_str_has_suffix (file_path, ".json"))
+    return g_strdup ("");
+
+  basename = g_path_get_basename (file_path);
+  basename[strlen (basename) - strlen (".json")] = '\0';
+  file_types = get_scope_file_types (basename, LANGUAGE_VSCODE);
+  g_free (basename);
+
+  return file_types;
+}
+
+/*
+ * A scope is a comma separated list of language ids (VS Code) or scope
+ * selectors (TextMate). A selector matches a language through any of
+ * its leading parts, text.html.basic is text.html. A language that is
+ * not known is taken to be its own extension, like source.go is .go.
+ */
+static gchar*
+get_scope_file_types (const gchar *scope,
+                      gint         column)
+{
+  GString *file_types;
+  gchar **parts;
+  gint i;
+
+  file_types = g_string_new (NULL);
+  parts = g_strsplit (scope, ",", -1);
+
+  for (i = 0; parts[i] != NULL; i++)
+    {
+      const gchar *start = parts[i];
+      const gchar *end;
+      const gchar *found;
+      const gchar *dot;
+      gsize length;
+
+      while (g_ascii_isspace (*start))
+        start++;
+      end = start;
+      while (*end != '\0' && !g_ascii_isspace (*end))
+        end++;
+
+      length = end - start;
+      if (length == 0)
+        continue;
+
+      found = lookup_language (start, length, column);
+      while (found == NULL && column == LANGUAGE_TEXTMATE &&
+             (dot = g_strrstr_len (start, length, ".")) != NULL)
+        {
+          length = dot - start;
+          found = lookup_language (start, length, column);
+        }
+
+      if (file_types->len > 0)
+        g_string_append_c (file_types, ',');
+
+      if (found != NULL)
+        {
+          g_string_append (file_types, found);
+          continue;
+        }
+
+      if (column == LANGUAGE_TEXTMATE && (dot = memchr (start, '.', end - start)) != NULL)
+        {
+          start = dot + 1;
+          dot = memchr (start, '.', end - start);
+          if (dot != NULL)
+            end = dot;
+        }
+      g_string_append_c (file_types, '.');
+      g_string_append_len (file_types, start, end - start);
+    }
+
+  g_strfreev (parts);
+
+  return g_string_free (file_types, FALSE);
+}
+
+/*
+ * The name the column gives to the language with exactly these file
+ * types, or NULL when they are not one of the languages known.
+ */
+static const gchar*
+get_language (const gchar *file_types,
+              gint         column)
+{
+  gint i;
+
+  for (i = 0; language_file_types[i][0] != NULL; i++)
+    {
+      if (g_strcmp0 (file_types, language_file_types[i][LANGUAGE_FILE_TYPES]) == 0)
+        return language_file_types[i][column];
+    }
+
+  return NULL;
+}
+
+static const gchar*
+lookup_language (const gchar *name,
+                 gsize        length,
+                 gint         column)
+{
+  gint i;
+
+  for (i = 0; language_file_types[i][0] != NULL; i++)
+    {
+      const gchar *language = language_file_types[i][column];
+      if (strlen (language) == length && strncmp (name, language, length) == 0)
+        return language_file_types[i][LANGUAGE_FILE_TYPES];
+    }
+
+  return NULL;
+}
+
+/*
+ * UltiSnips has no escape for a body line that would end the snippet,
+ * so the export puts a backslash in front of one and the import takes
+ * it off again. Returns how many backslashes lead up to the endsnippet,
+ * or -1 when the line is anything else.
+ */
+static gint
+get_endsnippet_escapes (const gchar *line,
+                        gsize        length)
+{
+  const gchar *end = line + length;
+  const gchar *p = line;
+
+  while (end > line && g_ascii_isspace (end[-1]))
+    end--;
+  while (p < end && *p == '\\')
+    p++;
+
+  if ((gsize) (end - p) != strlen ("endsnippet") || 
+      strncmp (p, "endsnippet", end - p) != 0)
+    return -1;
+
+  return p - line;
+}
+
+static gboolean
+export_jsonl (GOutputStream  *stream,
+              GList          *configs,
+              GError        **error)
+{
+  GString *line;
+  GString *scratch;
+  gboolean result = TRUE;
+
+  line = g_string_sized_new (1024);
+  scratch = g_string_new (NULL);
+
+  while (configs != NULL && result)
+    {
+      SnippetsConfig *config = configs->data;
+
+      g_string_assign (line, "{\"file_types\":");
+      append_json_string (line, snippets_config_get_file_types (config));
+      g_string_append (line, ",\"name\":");
+      append_json_string (line, snippets_config_get_name (config));
+      g_string_append (line, ",\"trigger\":");
+      append_json_string (line, snippets_config_get_trigger (config));
+      g_string_append (line, ",\"text\":");
+      append_json_string (line, snippets_config_get_text (config, scratch));
+      if (snippets_config_get_contexts (config) != NULL)
+        {
+          g_string_append (line, ",\"contexts\":");
+          append_json_string (line, snippets_config_get_contexts (config));
+        }
+      if (snippets_config_get_pattern (config))
+        g_string_append (line, ",\"pattern\":true");
+      g_string_append (line, "}\n");
+
+      result = g_output_stream_write_all (stream, line->str, line->len,
+                                          NULL, NULL, error);
+
+      configs = g_list_next (configs);
+    }
+
+  g_string_free (scratch, TRUE);
+  g_string_free (line, TRUE);
+
+  return result;
+}
+
+static void
+append_json_string (GString     *string,
+                    const gchar *text)
+{
+  const gchar *p;
+
+  g_string_append_c (string, '"');
+
+  for (p = text != NULL ? text : ""; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '"': g_string_append (string, "\\\""); break;
+        case '\\': g_string_append (string, "\\\\"); break;
+        case '\n': g_string_append (string, "\\n"); break;
+        case '\t': g_string_append (string, "\\t"); break;
+        case '\r': g_string_append (string, "\\r"); break;
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (string, "\\u%04x", (guchar) *p);
+          else
+            g_string_append_c (string, *p);
+          break;
+        }
+    }
+
+  g_string_append_c (string, '"');
+}
+
+static gboolean
+export_ultisnips (GOutputStream  *stream,
+                  GList          *configs,
+                  GError        **error)
+{
+  GString *snippet;
+  GString *scratch;
+  gboolean result = TRUE;
+
+  snippet = g_string_sized_new (1024);
+  scratch = g_string_new (NULL);
+
+  while (configs != NULL && result)
+    {
+      SnippetsConfig *config = configs->data;
+      const gchar *file_types;
+      const gchar *name;
+      const gchar *trigger;
+      const gchar *text;
+      const gchar *line;
+
+      file_types = snippets_config_get_file_types (config);
+      name = snippets_config_get_name (config);
+      trigger = snippets_config_get_trigger (config);
+      text = snippets_config_get_text (config, scratch);
+
+      if (trigger == NULL || text == NULL)
+        {
+          configs = g_list_next (configs);
+          continue;
+        }
+
+      /* remember the file types so that an import can restore them */
+      g_string_printf (snippet, "%s%s\n", FILE_TYPES_COMMENT,
+                       file_types != NULL ? file_types : "");
+
+      if (snippets_config_get_pattern (config))
+        g_string_append_printf (snippet, "snippet \"%s\" \"%s\" r\n", trigger,
+                                name != NULL ? name : trigger);
+      else if (strpbrk (trigger, " \t") != NULL)
+        g_string_append_printf (snippet, "snippet \"%s\" \"%s\"\n", trigger,
+                                name != NULL ? name : trigger);
+      else
+        g_string_append_printf (snippet, "snippet %s \"%s\"\n", trigger,
+                                name != NULL ? name : trigger);
+
+      line = text;
+      while (TRUE)
+        {
+          const gchar *end = strchr (line, '\n');
+          gsize length = end != NULL ? (gsize) (end - line) : strlen (line);
+
+          if (get_endsnippet_escapes (line, length) >= 0)
+            g_string_append_c (snippet, '\\');
+          g_string_append_len (snippet, line, length);
+
+          if (end == NULL)
+            break;
+          g_string_append_c (snippet, '\n');
+          line = end + 1;
+        }
+
+      /* the importer drops the newline in front of endsnippet */
+      if (text[0] != '\0')
+        g_string_append_c (snippet, '\n');
+      g_string_append (snippet, "endsnippet\n\n");
+
+      result = g_output_stream_write_all (stream, snippet->str, snippet->len,
+                                          NULL, NULL, error);
+
+      configs = g_list_next (configs);
+    }
+
+  g_string_free (scratch, TRUE);
+  g_string_free (snippet, TRUE);
+
+  return result;
+}
+
+/*
+ * The names are the keys of the object, so a name that is taken gets a
+ * number after it. The file types go along in a member VS Code passes
+ * over, for an import to restore them. VS Code has no triggers that are
+ * regular expressions, those snippets are left out.
+ */
+static gboolean
+export_vscode (GOutputStream  *stream,
+               GList          *configs,
+               GError        **error)
+{
+  GHashTable *names;
+  GString *entry;
+  GString *scratch;
+  gboolean first = TRUE;
+  gboolean result;
+  guint skipped = 0;
+
+  names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  entry = g_string_sized_new (1024);
+  scratch = g_string_new (NULL);
+
+  result = g_output_stream_write_all (stream, "{", 1, NULL, NULL, error);
+
+  for (; configs != NULL && result; configs = g_list_next (configs))
+    {
+      SnippetsConfig *config = configs->data;
+      const gchar *file_types;
+      const gchar *name;
+      const gchar *trigger;
+      const gchar *text;
+      const gchar *language;
+      gchar *key;
+      guint number = 1;
+
+      file_types = snippets_config_get_file_types (config);
+      name = snippets_config_get_name (config);
+      trigger = snippets_config_get_trigger (config);
+      text = snippets_config_get_text (config, scratch);
+
+      if (trigger == NULL || text == NULL)
+        continue;
+
+      if (snippets_config_get_pattern (config))
+        {
+          skipped++;
+          continue;
+        }
+
+      if (name == NULL)
+        name = trigger;
+
+      key = g_strdup (name);
+      while (g_hash_table_contains (names, key))
+        {
+          g_free (key);
+          key = g_strdup_printf ("%s (%u)", name, ++number);
+        }
+      g_hash_table_add (names, key);
+
+      g_string_assign (entry, first ? "\n  " : ",\n  ");
+      append_json_string (entry, key);
+      g_string_append (entry, ": {\n    \"prefix\": ");
+      append_json_string (entry, trigger);
+      g_string_append (entry, ",\n    \"body\": ");
+      append_json_string (entry, text);
+      g_string_append (entry, ",\n    \"description\": ");
+      append_json_string (entry, name);
+
+      language = get_language (file_types, LANGUAGE_VSCODE);
+      if (language != NULL)
+        {
+          g_string_append (entry, ",\n    \"scope\": ");
+          append_json_string (entry, language);
+        }
+
+      g_string_append (entry, ",\n    \"file_types\": ");
+      append_json_string (entry, file_types);
+      g_string_append (entry, "\n  }");
+
+      result = g_output_stream_write_all (stream, entry->str, entry->len,
+                                          NULL, NULL, error);
+      first = FALSE;
+    }
+
+  if (result)
+    result = g_output_stream_write_all (stream, "\n}\n", 3, NULL, NULL, error);
+
+  if (skipped > 0)
+    g_warning ("left out %u pattern snippets that VS Code cannot trigger\n", skipped);
+
+  g_hash_table_destroy (names);
+  g_string_free (scratch, TRUE);
+  g_string_free (entry, TRUE);
+
+  return result;
+}
+
+/*
+ * The library goes out as an array of snippet dicts. TextMate wants a
+ * uuid for each, it is made from the id so that it stays the same from
+ * one export to the next. Pattern snippets are left out as for VS Code.
+ */
+static gboolean
+export_textmate (GOutputStream  *stream,
+                 GList          *configs,
+                 GError        **error)
+{
+  GString *snippet;
+  GString *scratch;
+  gboolean result;
+  guint skipped = 0;
+
+  snippet = g_string_sized_new (1024);
+  scratch = g_string_new (NULL);
+
+  g_string_assign (snippet, 
+                   "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                   "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+                   "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+                   "<plist version=\"1.0\">\n"
+                   "<array>\n");
+  result = g_output_stream_write_all (stream, snippet->str, snippet->len,
+                                      NULL, NULL, error);
+
+  for (; configs != NULL && result; configs = g_list_next (configs))
+    {
+      SnippetsConfig *config = configs->data;
+      const gchar *file_types;
+      const gchar *name;
+      const gchar *trigger;
+      const gchar *text;
+      const gchar *language;
+      guint64 id;
+
+      file_types = snippets_config_get_file_types (config);
+      name = snippets_config_get_name (config);
+      trigger = snippets_config_get_trigger (config);
+      text = snippets_config_get_text (config, scratch);
+
+      if (trigger == NULL || text == NULL)
+        continue;
+
+      if (snippets_config_get_pattern (config))
+        {
+          skipped++;
+          continue;
+        }
+
+      g_string_assign (snippet, "\t<dict>\n\t\t<key>content</key>\n\t\t<string>");
+      append_xml_string (snippet, text);
+      g_string_append (snippet, "</string>\n\t\t<key>name</key>\n\t\t<string>");
+      append_xml_string (snippet, name != NULL ? name : trigger);
+      g_string_append (snippet, "</string>\n");
+
+      language = get_language (file_types, LANGUAGE_TEXTMATE);
+      if (language != NULL)
+        g_string_append_printf (snippet, "\t\t<key>scope</key>\n\t\t<string>%s</string>\n", 
+                                language);
+
+      g_string_append (snippet, "\t\t<key>tabTrigger</key>\n\t\t<string>");
+      append_xml_string (snippet, trigger);
+      g_string_append (snippet, "</string>\n\t\t<key>file_types</key>\n\t\t<string>");
+      append_xml_string (snippet, file_types);
+
+      id = snippets_config_get_id (config);
+      g_string_append_printf (snippet, "</string>\n\t\t<key>uuid</key>\n"
+                              "\t\t<string>%08X-%04X-%04X-0000-000000000000</string>\n"
+                              "\t</dict>\n",
+                              (guint) (id >> 32), (guint) (id >> 16) & 0xFFFF, 
+                              (guint) id & 0xFFFF);
+
+      result = g_output_stream_write_all (stream, snippet->str, snippet->len,
+                                          NULL, NULL, error);
+    }
+
+  if (result)
+    result = g_output_stream_write_all (stream, "</array>\n</plist>\n", 
+                                        strlen ("</array>\n</plist>\n"), 
+                                        NULL, NULL, error);
+
+  if (skipped > 0)
+    g_warning ("left out %u pattern snippets that TextMate cannot trigger\n", skipped);
+
+  g_string_free (scratch, TRUE);
+  g_string_free (snippet, TRUE);
+
+  return result;
+}
+
+/*
+ * The control characters XML cannot hold at all are dropped.
+ */
+static void
+append_xml_string (GString     *string,
+                   const gchar *text)
+{
+  const gchar *p;
+
+  for (p = text != NULL ? text : ""; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '<': g_string_append (string, "&lt;"); break;
+        case '>': g_string_append (string, "&gt;"); break;
+        case '&': g_string_append (string, "&amp;"); break;
+        case '\n':
+        case '\t':
+        case '\r':
+          g_string_append_c (string, *p);
+          break;
+        default:
+          if ((guchar) *p >= 0x20)
+            g_string_append_c (string, *p);
+          break;
+        }
+    }
+}
+
+static gboolean
+is_ultisnips (const gchar *file_path)
+{
+  return g_str_has_suffix (file_path, ".snippets");
+}
+
+static gboolean
+is_vscode (const gchar *file_path)
+{
+  return g_str_has_suffix (file_path, ".code-snippets") ||
+         g_str_has_suffix (file_path, ".json");
+}
+
+static gboolean
+is_textmate (const gchar *file_path)
+{
+  return g_str_has_suffix (file_path, ".tmSnippet");
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_IO_H__
+#define	__SNIPPETS_IO_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Snippet libraries can be moved around as line delimited JSON (*.jsonl),
+ * as UltiSnips files (*.snippets), as VS Code snippets (*.code-snippets
+ * or <language>.json) and as TextMate property lists (*.tmSnippet). All
+ * of them are read and written a snippet at a time, and an import hands
+ * the snippets over in chunks as it goes, so a library never has to be
+ * held in memory as a whole. The library itself is kept as versioned
+ * XML, see snippets_io_load.
+ */
+
+GList*    snippets_io_load    (const gchar  *file_path,
+                               GError       **error);
+gboolean  snippets_io_save    (const gchar  *file_path,
+                               GList        *configs,
+                               GError       **error);
+gboolean  snippets_io_read_header (const gchar  *file_path,
+                                   guint        *version,
+                                   guint        *count,
+                                   gchar        **hash,
+                                   GError       **error);
+guint     snippets_io_import  (const gchar  *file_path,
+                               GFunc         func,
+                               gpointer      data,
+                               GError       **error);
+gboolean  snippets_io_export  (const gchar  *file_path,
+                               GList        *configs,
+                               GError       **error);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_IO_H__ */
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <gdk/gdkkeysyms.h>
+#include <codeslayer/codeslayer.h>
+#include "snippets-menu.h"
+
+static void snippets_menu_class_init  (SnippetsMenuClass *klass);
+static void snippets_menu_init        (SnippetsMenu      *menu);
+static void snippets_menu_finalize    (SnippetsMenu      *menu);
+
+static void add_menu_items            (SnippetsMenu      *menu,
+                                       GtkWidget         *submenu,
+                                       GtkAccelGroup     *accel_group);
+static void expand_selection_action   (SnippetsMenu      *menu);
+static void import_snippets_action    (SnippetsMenu      *menu);
+static void export_snippets_action    (SnippetsMenu      *menu);
+static void export_statistics_action  (SnippetsMenu      *menu);
+static void fuzzy_triggers_action     (SnippetsMenu      *menu);
+static void shell_commands_action     (SnippetsMenu      *menu);
+
+#define SNIPPETS_MENU_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_MENU_TYPE, SnippetsMenuPrivate))
+
+typedef struct _SnippetsMenuPrivate SnippetsMenuPrivate;
+
+struct _SnippetsMenuPrivate
+{
+  GtkWidget *fuzzy_triggers_item;
+  gulong     fuzzy_triggers_id;
+  GtkWidget *shell_commands_item;
+  gulong     shell_commands_id;
+};
+
+enum
+{
+  EXPAND_SELECTION,
+  IMPORT_SNIPPETS,
+  EXPORT_SNIPPETS,
+  EXPORT_STATISTICS,
+  FUZZY_TRIGGERS,
+  SHELL_COMMANDS,
+  LAST_SIGNAL
+};
+
+static guint snippets_menu_signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (SnippetsMenu, snippets_menu, GTK_TYPE_MENU_ITEM)
+
+static void
+snippets_menu_class_init (SnippetsMenuClass *klass)
+{
+  snippets_menu_signals[EXPAND_SELECTION] =
+    g_signal_new ("expand-selection",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsMenuClass, expand_selection),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  snippets_menu_signals[IMPORT_SNIPPETS] =
+    g_signal_new ("import-snippets",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsMenuClass, import_snippets),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  snippets_menu_signals[EXPORT_SNIPPETS] =
+    g_signal_new ("export-snippets",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsMenuClass, export_snippets),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  snippets_menu_signals[EXPORT_STATISTICS] =
+    g_signal_new ("export-statistics",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsMenuClass, export_statistics),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  snippets_menu_signals[FUZZY_TRIGGERS] =
+    g_signal_new ("fuzzy-triggers",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsMenuClass, fuzzy_triggers),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__BOOLEAN, G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
+  snippets_menu_signals[SHELL_COMMANDS] =
+    g_signal_new ("shell-commands",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsMenuClass, shell_commands),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__BOOLEAN, G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) snippets_menu_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsMenuPrivate));
+}
+
+static void
+snippets_menu_init (SnippetsMenu *menu)
+{
+  gtk_menu_item_set_label (GTK_MENU_ITEM (menu), _("Snippets"));
+}
+
+static void
+snippets_menu_finalize (SnippetsMenu *menu)
+{
+  G_OBJECT_CLASS (snippets_menu_parent_class)->finalize (G_OBJECT (menu));
+}
+
+GtkWidget*
+snippets_menu_new (GtkAccelGroup *accel_group)
+{
+  GtkWidget *menu;
+  GtkWidget *submenu;
+
+  menu = g_object_new (snippets_menu_get_type (), NULL);
+
+  submenu = gtk_menu_new ();
+  gtk_menu_item_set_submenu (GTK_MENU_ITEM (menu), submenu);
+
+  add_menu_items (SNIPPETS_MENU (menu), submenu, accel_group);
+
+  return menu;
+}
+
+static void
+add_menu_items (SnippetsMenu  *menu,
+                GtkWidget     *submenu,
+                GtkAccelGroup *accel_group)
+{
+  GtkWidget *expand_selection_item;
+  GtkWidget *separator_item;
+  GtkWidget *import_snippets_item;
+  GtkWidget *export_snippets_item;
+  GtkWidget *export_statistics_item;
+  GtkWidget *settings_separator_item;
+  GtkWidget *fuzzy_triggers_item;
+  GtkWidget *shell_commands_item;
+  SnippetsMenuPrivate *priv;
+
+  priv = SNIPPETS_MENU_GET_PRIVATE (menu);
+
+  expand_selection_item = gtk_menu_item_new_with_label (_("Expand Over Selection"));
+  gtk_widget_add_accelerator (expand_selection_item, "activate",
+                              accel_group, GDK_KEY_space,
+                              GDK_CONTROL_MASK | GDK_SHIFT_MASK, GTK_ACCEL_VISIBLE);
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), expand_selection_item);
+
+  separator_item = gtk_separator_menu_item_new ();
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), separator_item);
+
+  import_snippets_item = gtk_menu_item_new_with_label (_("Import Snippets..."));
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), import_snippets_item);
+
+  export_snippets_item = gtk_menu_item_new_with_label (_("Export Snippets..."));
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), export_snippets_item);
+
+  export_statistics_item = gtk_menu_item_new_with_label (_("Export Statistics"));
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), export_statistics_item);
+
+  settings_separator_item = gtk_separator_menu_item_new ();
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), settings_separator_item);
+
+  fuzzy_triggers_item = gtk_check_menu_item_new_with_label (_("Fuzzy Triggers"));
+  priv->fuzzy_triggers_item = fuzzy_triggers_item;
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), fuzzy_triggers_item);
+
+  shell_commands_item = gtk_check_menu_item_new_with_label (_("Run Shell Commands"));
+  priv->shell_commands_item = shell_commands_item;
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), shell_commands_item);
+
+  g_signal_connect_swapped (G_OBJECT (expand_selection_item), "activate",
+                            G_CALLBACK (expand_selection_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (import_snippets_item), "activate",
+                            G_CALLBACK (import_snippets_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (export_snippets_item), "activate",
+                            G_CALLBACK (export_snippets_action), menu);
+
+  g_signal_connect_swapped (G_OBJECT (export_statistics_item), "activate",
+                            G_CALLBACK (export_statistics_action), menu);
+
+  priv->fuzzy_triggers_id = g_signal_connect_swapped (G_OBJECT (fuzzy_triggers_item), "toggled",
+                                                      G_CALLBACK (fuzzy_triggers_action), menu);
+
+  priv->shell_commands_id = g_signal_connect_swapped (G_OBJECT (shell_commands_item), "toggled",
+                                                      G_CALLBACK (shell_commands_action), menu);
+}
+
+void
+snippets_menu_set_fuzzy_triggers (SnippetsMenu *menu,
+                                  gboolean      fuzzy_triggers)
+{
+  SnippetsMenuPrivate *priv;
+  priv = SNIPPETS_MENU_GET_PRIVATE (menu);
+  g_signal_handler_block (priv->fuzzy_triggers_item, priv->fuzzy_triggers_id);
+  gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (priv->fuzzy_triggers_item), 
+                                  fuzzy_triggers);
+  g_signal_handler_unblock (priv->fuzzy_triggers_item, priv->fuzzy_triggers_id);
+}
+
+void
+snippets_menu_set_shell_commands (SnippetsMenu *menu,
+                                  gboolean      shell_commands)
+{
+  SnippetsMenuPrivate *priv;
+  priv = SNIPPETS_MENU_GET_PRIVATE (menu);
+  g_signal_handler_block (priv->shell_commands_item, priv->shell_commands_id);
+  gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (priv->shell_commands_item), 
+                                  shell_commands);
+  g_signal_handler_unblock (priv->shell_commands_item, priv->shell_commands_id);
+}
+
+static void
+expand_selection_action (SnippetsMenu *menu)
+{
+  g_signal_emit_by_name ((gpointer) menu, "expand-selection");
+}
+
+static void
+import_snippets_action (SnippetsMenu *menu)
+{
+  g_signal_emit_by_name ((gpointer) menu, "import-snippets");
+}
+
+static void
+export_snippets_action (SnippetsMenu *menu)
+{
+  g_signal_emit_by_name ((gpointer) menu, "export-snippets");
+}
+
+static void
+export_statistics_action (SnippetsMenu *menu)
+{
+  g_signal_emit_by_name ((gpointer) menu, "export-statistics");
+}
+
+static void
+fuzzy_triggers_action (SnippetsMenu *menu)
+{
+  SnippetsMenuPrivate *priv;
+  gboolean fuzzy_triggers;
+  
+  priv = SNIPPETS_MENU_GET_PRIVATE (menu);
+  
+  fuzzy_triggers = gtk_check_menu_item_get_active (GTK_CHECK_MENU_ITEM (priv->fuzzy_triggers_item));
+  g_signal_emit_by_name ((gpointer) menu, "fuzzy-triggers", fuzzy_triggers);
+}
+
+static void
+shell_commands_action (SnippetsMenu *menu)
+{
+  SnippetsMenuPrivate *priv;
+  gboolean shell_commands;
+  
+  priv = SNIPPETS_MENU_GET_PRIVATE (menu);
+  
+  shell_commands = gtk_check_menu_item_get_active (GTK_CHECK_MENU_ITEM (priv->shell_commands_item));
+  g_signal_emit_by_name ((gpointer) menu, "shell-commands", shell_commands);
+}
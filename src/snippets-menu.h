@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_MENU_H__
+#define	__SNIPPETS_MENU_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_MENU_TYPE            (snippets_menu_get_type ())
+#define SNIPPETS_MENU(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_MENU_TYPE, SnippetsMenu))
+#define SNIPPETS_MENU_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_MENU_TYPE, SnippetsMenuClass))
+#define IS_SNIPPETS_MENU(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_MENU_TYPE))
+#define IS_SNIPPETS_MENU_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_MENU_TYPE))
+
+typedef struct _SnippetsMenu SnippetsMenu;
+typedef struct _SnippetsMenuClass SnippetsMenuClass;
+
+struct _SnippetsMenu
+{
+  GtkMenuItem parent_instance;
+};
+
+struct _SnippetsMenuClass
+{
+  GtkMenuItemClass parent_class;
+
+  void (*expand_selection) (SnippetsMenu *menu);
+  void (*import_snippets) (SnippetsMenu *menu);
+  void (*export_snippets) (SnippetsMenu *menu);
+  void (*export_statistics) (SnippetsMenu *menu);
+  void (*fuzzy_triggers) (SnippetsMenu *menu,
+                          gboolean      fuzzy_triggers);
+  void (*shell_commands) (SnippetsMenu *menu,
+                          gboolean      shell_commands);
+};
+
+GType snippets_menu_get_type (void) G_GNUC_CONST;
+
+GtkWidget*  snippets_menu_new                 (GtkAccelGroup *accel_group);
+
+void        snippets_menu_set_fuzzy_triggers  (SnippetsMenu  *menu,
+                                               gboolean       fuzzy_triggers);
+void        snippets_menu_set_shell_commands  (SnippetsMenu  *menu,
+                                               gboolean       shell_commands);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_MENU_H__ */
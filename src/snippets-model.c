@@ -0,0 +1,987 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-model.h"
+
+/*
+ * A two level tree of file type groups and their snippets that reads the
+ * names straight from the configs. Groups are kept sorted by collation key
+ * as they are added. The snippets under a group are only given collation
+ * keys and sorted the first time the group is opened, until then they are
+ * an unordered list that nothing outside the model can see. Each config
+ * can be found again by its row, and each group by its file type set.
+ * The arrays hold the rows without owning them, so that a row can be
+ * taken out and put back elsewhere when it is renamed.
+ */
+
+typedef struct _Group Group;
+typedef struct _Child Child;
+
+struct _Group
+{
+  gchar               *file_types;
+  SnippetsFileTypeSet *set;
+  gchar               *key;
+  GPtrArray           *children;
+  gboolean             materialized;
+  guint                position;
+};
+
+struct _Child
+{
+  SnippetsConfig *config;
+  gchar          *key;
+  Group          *group;
+  guint           position;
+};
+
+static void snippets_model_class_init       (SnippetsModelClass *klass);
+static void snippets_model_init             (SnippetsModel      *model);
+static void snippets_model_finalize         (SnippetsModel      *model);
+static void snippets_model_tree_model_init  (GtkTreeModelIface  *iface);
+
+static GtkTreeModelFlags get_flags          (GtkTreeModel       *tree_model);
+static gint get_n_columns                   (GtkTreeModel       *tree_model);
+static GType get_column_type                (GtkTreeModel       *tree_model,
+                                             gint                column);
+static gboolean get_iter                    (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter,
+                                             GtkTreePath        *path);
+static GtkTreePath* get_path                (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter);
+static void get_value                       (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter,
+                                             gint                column,
+                                             GValue             *value);
+static gboolean iter_next                   (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter);
+static gboolean iter_children               (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter,
+                                             GtkTreeIter        *parent);
+static gboolean iter_has_child              (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter);
+static gint iter_n_children                 (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter);
+static gboolean iter_nth_child              (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter,
+                                             GtkTreeIter        *parent,
+                                             gint                n);
+static gboolean iter_parent                 (GtkTreeModel       *tree_model,
+                                             GtkTreeIter        *iter,
+                                             GtkTreeIter        *child);
+
+static void fill_iter                       (SnippetsModel      *model,
+                                             GtkTreeIter        *iter,
+                                             Group              *group,
+                                             Child              *child);
+static void materialize                     (Group              *group);
+static gint compare_children                (Child             **a,
+                                             Child             **b);
+static guint find_group_position            (GPtrArray          *groups,
+                                             const gchar        *key);
+static guint find_child_position            (GPtrArray          *children,
+                                             const gchar        *key);
+static void insert_index                    (GPtrArray          *array,
+                                             guint               index,
+                                             gpointer            data);
+static void renumber_groups                 (GPtrArray          *groups,
+                                             guint               from);
+static void renumber_children               (GPtrArray          *children,
+                                             guint               from);
+static void move_group                      (SnippetsModel      *model,
+                                             Group              *group);
+static void move_child                      (SnippetsModel      *model,
+                                             Child              *child);
+static void emit_reordered                  (SnippetsModel      *model,
+                                             GtkTreePath        *path,
+                                             GtkTreeIter        *iter,
+                                             guint               length,
+                                             guint               old_position,
+                                             guint               new_position);
+static gchar* get_collate_key               (const gchar        *text);
+static void group_free                      (Group              *group);
+static Group* find_duplicate_group          (SnippetsModel      *model,
+                                             Group              *group);
+static void merge_group                     (SnippetsModel      *model,
+                                             Group              *group,
+                                             Group              *target);
+static void forget_children                 (SnippetsModel      *model,
+                                             Group              *group);
+static void child_free                      (Child              *child);
+
+#define SNIPPETS_MODEL_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_MODEL_TYPE, SnippetsModelPrivate))
+
+typedef struct _SnippetsModelPrivate SnippetsModelPrivate;
+
+struct _SnippetsModelPrivate
+{
+  GPtrArray  *groups;
+  GHashTable *rows;
+  gint        stamp;
+};
+
+G_DEFINE_TYPE_WITH_CODE (SnippetsModel, snippets_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+                                                snippets_model_tree_model_init))
+
+static void
+snippets_model_class_init (SnippetsModelClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_model_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsModelPrivate));
+}
+
+static void
+snippets_model_tree_model_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = get_flags;
+  iface->get_n_columns = get_n_columns;
+  iface->get_column_type = get_column_type;
+  iface->get_iter = get_iter;
+  iface->get_path = get_path;
+  iface->get_value = get_value;
+  iface->iter_next = iter_next;
+  iface->iter_children = iter_children;
+  iface->iter_has_child = iter_has_child;
+  iface->iter_n_children = iter_n_children;
+  iface->iter_nth_child = iter_nth_child;
+  iface->iter_parent = iter_parent;
+}
+
+static void
+snippets_model_init (SnippetsModel *model)
+{
+  SnippetsModelPrivate *priv;
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+  priv->groups = g_ptr_array_new ();
+  priv->rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->stamp = g_random_int ();
+}
+
+static void
+snippets_model_finalize (SnippetsModel *model)
+{
+  SnippetsModelPrivate *priv;
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+  g_ptr_array_foreach (priv->groups, (GFunc) group_free, NULL);
+  g_ptr_array_free (priv->groups, TRUE);
+  g_hash_table_destroy (priv->rows);
+  G_OBJECT_CLASS (snippets_model_parent_class)->finalize (G_OBJECT (model));
+}
+
+SnippetsModel*
+snippets_model_new (void)
+{
+  return SNIPPETS_MODEL (g_object_new (snippets_model_get_type (), NULL));
+}
+
+void
+snippets_model_append_group (SnippetsModel *model,
+                             const gchar   *file_types,
+                             GtkTreeIter   *iter)
+{
+  SnippetsModelPrivate *priv;
+  GtkTreePath *path;
+  GtkTreeIter group_iter;
+  Group *group;
+  guint position;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  group = g_slice_new0 (Group);
+  group->file_types = g_strdup (file_types);
+  group->set = snippets_file_types_intern (file_types);
+  group->key = get_collate_key (file_types);
+  group->children = g_ptr_array_new ();
+
+  position = find_group_position (priv->groups, group->key);
+  insert_index (priv->groups, position, group);
+  renumber_groups (priv->groups, position);
+
+  fill_iter (model, &group_iter, group, NULL);
+  path = get_path (GTK_TREE_MODEL (model), &group_iter);
+  gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &group_iter);
+  gtk_tree_path_free (path);
+
+  if (iter != NULL)
+    *iter = group_iter;
+}
+
+/*
+ * Only a group that has been opened has its snippets in order, anything
+ * added to the others is simply put on the end. Asking for the iter of the
+ * new row puts the group in order since a row has to have a position.
+ */
+void
+snippets_model_append_config (SnippetsModel  *model,
+                              GtkTreeIter    *parent,
+                              SnippetsConfig *config,
+                              GtkTreeIter    *iter)
+{
+  SnippetsModelPrivate *priv;
+  GtkTreePath *path;
+  GtkTreeIter child_iter;
+  Group *group;
+  Child *child;
+
+  g_return_if_fail (parent != NULL && parent->user_data2 == NULL);
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  group = parent->user_data;
+
+  child = g_slice_new0 (Child);
+  child->config = config;
+  child->group = group;
+  g_hash_table_insert (priv->rows, config, child);
+
+  if (group->materialized)
+    {
+      guint position;
+
+      child->key = get_collate_key (snippets_config_get_name (config));
+      position = find_child_position (group->children, child->key);
+      insert_index (group->children, position, child);
+      renumber_children (group->children, position);
+
+      fill_iter (model, &child_iter, group, child);
+      path = get_path (GTK_TREE_MODEL (model), &child_iter);
+      gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &child_iter);
+      gtk_tree_path_free (path);
+    }
+  else
+    {
+      child->position = group->children->len;
+      g_ptr_array_add (group->children, child);
+    }
+
+  if (group->children->len == 1)
+    {
+      path = get_path (GTK_TREE_MODEL (model), parent);
+      gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model), path, parent);
+      gtk_tree_path_free (path);
+    }
+
+  if (iter != NULL)
+    {
+      materialize (group);
+      fill_iter (model, iter, group, child);
+    }
+}
+
+void
+snippets_model_remove (SnippetsModel *model,
+                       GtkTreeIter   *iter)
+{
+  SnippetsModelPrivate *priv;
+  GtkTreePath *path;
+  Group *group;
+  Child *child;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  group = iter->user_data;
+  child = iter->user_data2;
+
+  path = get_path (GTK_TREE_MODEL (model), iter);
+
+  if (child != NULL)
+    {
+      guint position = child->position;
+
+      g_hash_table_remove (priv->rows, child->config);
+      g_ptr_array_remove_index (group->children, position);
+      child_free (child);
+      renumber_children (group->children, position);
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+
+      if (group->children->len == 0)
+        {
+          GtkTreeIter parent;
+
+          fill_iter (model, &parent, group, NULL);
+          gtk_tree_path_up (path);
+          gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model), path, &parent);
+        }
+    }
+  else
+    {
+      guint position = group->position;
+
+      forget_children (model, group);
+      g_ptr_array_remove_index (priv->groups, position);
+      group_free (group);
+      renumber_groups (priv->groups, position);
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+    }
+
+  gtk_tree_path_free (path);
+}
+
+void
+snippets_model_clear (SnippetsModel *model)
+{
+  SnippetsModelPrivate *priv;
+  GtkTreePath *path;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  g_hash_table_remove_all (priv->rows);
+
+  while (priv->groups->len > 0)
+    {
+      group_free (g_ptr_array_remove_index (priv->groups, priv->groups->len - 1));
+      path = gtk_tree_path_new_from_indices (priv->groups->len, -1);
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+      gtk_tree_path_free (path);
+    }
+}
+
+gboolean
+snippets_model_find_config (SnippetsModel  *model,
+                            SnippetsConfig *config,
+                            GtkTreeIter    *iter)
+{
+  SnippetsModelPrivate *priv;
+  Child *child;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  child = g_hash_table_lookup (priv->rows, config);
+  if (child == NULL)
+    return FALSE;
+
+  if (iter != NULL)
+    fill_iter (model, iter, child->group, child);
+
+  return TRUE;
+}
+
+gboolean
+snippets_model_find_group (SnippetsModel             *model,
+                           const SnippetsFileTypeSet *set,
+                           GtkTreeIter               *iter)
+{
+  SnippetsModelPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  for (i = 0; i < priv->groups->len; i++)
+    {
+      Group *group = g_ptr_array_index (priv->groups, i);
+      if (snippets_file_types_equal (group->set, set))
+        {
+          fill_iter (model, iter, group, NULL);
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/*
+ * Renaming a group hands the new file types down to all of its snippets,
+ * renaming a snippet renames the config itself. A group renamed to the
+ * file types of another is merged into that one, the iter is then set to
+ * the group that is left.
+ */
+void
+snippets_model_set_text (SnippetsModel *model,
+                         GtkTreeIter   *iter,
+                         const gchar   *text)
+{
+  GtkTreePath *path;
+  GtkTreeIter changed;
+  Group *group;
+  Child *child;
+
+  group = iter->user_data;
+  child = iter->user_data2;
+
+  if (child != NULL)
+    {
+      snippets_config_set_name (child->config, text);
+      if (group->materialized)
+        {
+          g_free (child->key);
+          child->key = get_collate_key (text);
+          move_child (model, child);
+        }
+    }
+  else
+    {
+      Group *target;
+      guint i;
+
+      g_free (group->file_types);
+      group->file_types = g_strdup (text);
+      snippets_file_types_free (group->set);
+      group->set = snippets_file_types_intern (text);
+
+      target = find_duplicate_group (model, group);
+      if (target != NULL)
+        {
+          merge_group (model, group, target);
+          fill_iter (model, iter, target, NULL);
+          return;
+        }
+
+      for (i = 0; i < group->children->len; i++)
+        {
+          Child *group_child = g_ptr_array_index (group->children, i);
+          snippets_config_set_file_types (group_child->config, text);
+        }
+
+      g_free (group->key);
+      group->key = get_collate_key (text);
+      move_group (model, group);
+    }
+
+  fill_iter (model, &changed, group, child);
+  path = get_path (GTK_TREE_MODEL (model), &changed);
+  gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &changed);
+  gtk_tree_path_free (path);
+
+  *iter = changed;
+}
+
+static GtkTreeModelFlags
+get_flags (GtkTreeModel *tree_model)
+{
+  return 0;
+}
+
+static gint
+get_n_columns (GtkTreeModel *tree_model)
+{
+  return SNIPPETS_MODEL_COLUMNS;
+}
+
+static GType
+get_column_type (GtkTreeModel *tree_model,
+                 gint          column)
+{
+  switch (column)
+    {
+    case SNIPPETS_MODEL_TEXT:
+      return G_TYPE_STRING;
+    case SNIPPETS_MODEL_CONFIGURATION:
+      return G_TYPE_POINTER;
+    }
+
+  return G_TYPE_INVALID;
+}
+
+static gboolean
+get_iter (GtkTreeModel *tree_model,
+          GtkTreeIter  *iter,
+          GtkTreePath  *path)
+{
+  SnippetsModelPrivate *priv;
+  Group *group;
+  gint *indices;
+  gint depth;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (tree_model);
+
+  indices = gtk_tree_path_get_indices (path);
+  depth = gtk_tree_path_get_depth (path);
+
+  if (depth < 1 || depth > 2 || indices[0] < 0 || indices[0] >= (gint) priv->groups->len)
+    return FALSE;
+
+  group = g_ptr_array_index (priv->groups, indices[0]);
+
+  if (depth == 1)
+    {
+      fill_iter (SNIPPETS_MODEL (tree_model), iter, group, NULL);
+      return TRUE;
+    }
+
+  if (indices[1] < 0 || indices[1] >= (gint) group->children->len)
+    return FALSE;
+
+  materialize (group);
+  fill_iter (SNIPPETS_MODEL (tree_model), iter, group,
+             g_ptr_array_index (group->children, indices[1]));
+
+  return TRUE;
+}
+
+static GtkTreePath*
+get_path (GtkTreeModel *tree_model,
+          GtkTreeIter  *iter)
+{
+  GtkTreePath *path;
+  Group *group;
+  Child *child;
+
+  group = iter->user_data;
+  child = iter->user_data2;
+
+  path = gtk_tree_path_new ();
+  gtk_tree_path_append_index (path, group->position);
+
+  if (child != NULL)
+    gtk_tree_path_append_index (path, child->position);
+
+  return path;
+}
+
+static void
+get_value (GtkTreeModel *tree_model,
+           GtkTreeIter  *iter,
+           gint          column,
+           GValue       *value)
+{
+  Group *group;
+  Child *child;
+
+  group = iter->user_data;
+  child = iter->user_data2;
+
+  g_value_init (value, get_column_type (tree_model, column));
+
+  switch (column)
+    {
+    case SNIPPETS_MODEL_TEXT:
+      if (child != NULL)
+        g_value_set_string (value, snippets_config_get_name (child->config));
+      else
+        g_value_set_string (value, group->file_types);
+      break;
+    case SNIPPETS_MODEL_CONFIGURATION:
+      g_value_set_pointer (value, child != NULL ? child->config : NULL);
+      break;
+    }
+}
+
+static gboolean
+iter_next (GtkTreeModel *tree_model,
+           GtkTreeIter  *iter)
+{
+  SnippetsModelPrivate *priv;
+  Group *group;
+  Child *child;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (tree_model);
+
+  group = iter->user_data;
+  child = iter->user_data2;
+
+  if (child != NULL)
+    {
+      if (child->position + 1 >= group->children->len)
+        return FALSE;
+      iter->user_data2 = g_ptr_array_index (group->children, child->position + 1);
+      return TRUE;
+    }
+
+  if (group->position + 1 >= priv->groups->len)
+    return FALSE;
+
+  iter->user_data = g_ptr_array_index (priv->groups, group->position + 1);
+  return TRUE;
+}
+
+static gboolean
+iter_children (GtkTreeModel *tree_model,
+               GtkTreeIter  *iter,
+               GtkTreeIter  *parent)
+{
+  return iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+iter_has_child (GtkTreeModel *tree_model,
+                GtkTreeIter  *iter)
+{
+  return iter_n_children (tree_model, iter) > 0;
+}
+
+static gint
+iter_n_children (GtkTreeModel *tree_model,
+                 GtkTreeIter  *iter)
+{
+  SnippetsModelPrivate *priv;
+  Group *group;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (tree_model);
+
+  if (iter == NULL)
+    return priv->groups->len;
+
+  if (iter->user_data2 != NULL)
+    return 0;
+
+  group = iter->user_data;
+  return group->children->len;
+}
+
+static gboolean
+iter_nth_child (GtkTreeModel *tree_model,
+                GtkTreeIter  *iter,
+                GtkTreeIter  *parent,
+                gint          n)
+{
+  SnippetsModelPrivate *priv;
+  Group *group;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (tree_model);
+
+  if (parent == NULL)
+    {
+      if (n < 0 || n >= (gint) priv->groups->len)
+        return FALSE;
+      fill_iter (SNIPPETS_MODEL (tree_model), iter,
+                 g_ptr_array_index (priv->groups, n), NULL);
+      return TRUE;
+    }
+
+  if (parent->user_data2 != NULL)
+    return FALSE;
+
+  group = parent->user_data;
+
+  if (n < 0 || n >= (gint) group->children->len)
+    return FALSE;
+
+  materialize (group);
+  fill_iter (SNIPPETS_MODEL (tree_model), iter, group,
+             g_ptr_array_index (group->children, n));
+
+  return TRUE;
+}
+
+static gboolean
+iter_parent (GtkTreeModel *tree_model,
+             GtkTreeIter  *iter,
+             GtkTreeIter  *child)
+{
+  if (child->user_data2 == NULL)
+    return FALSE;
+
+  fill_iter (SNIPPETS_MODEL (tree_model), iter, child->user_data, NULL);
+  return TRUE;
+}
+
+static void
+fill_iter (SnippetsModel *model,
+           GtkTreeIter   *iter,
+           Group         *group,
+           Child         *child)
+{
+  SnippetsModelPrivate *priv;
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+  iter->stamp = priv->stamp;
+  iter->user_data = group;
+  iter->user_data2 = child;
+  iter->user_data3 = NULL;
+}
+
+static void
+materialize (Group *group)
+{
+  guint i;
+
+  if (group->materialized)
+    return;
+
+  for (i = 0; i < group->children->len; i++)
+    {
+      Child *child = g_ptr_array_index (group->children, i);
+      child->key = get_collate_key (snippets_config_get_name (child->config));
+    }
+
+  g_ptr_array_sort (group->children, (GCompareFunc) compare_children);
+  renumber_children (group->children, 0);
+
+  group->materialized = TRUE;
+}
+
+static gint
+compare_children (Child **a,
+                  Child **b)
+{
+  return strcmp ((*a)->key, (*b)->key);
+}
+
+static guint
+find_group_position (GPtrArray   *groups,
+                     const gchar *key)
+{
+  guint low = 0;
+  guint high = groups->len;
+
+  while (low < high)
+    {
+      guint middle = (low + high) / 2;
+      Group *group = g_ptr_array_index (groups, middle);
+      if (strcmp (group->key, key) <= 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return low;
+}
+
+static guint
+find_child_position (GPtrArray   *children,
+                     const gchar *key)
+{
+  guint low = 0;
+  guint high = children->len;
+
+  while (low < high)
+    {
+      guint middle = (low + high) / 2;
+      Child *child = g_ptr_array_index (children, middle);
+      if (strcmp (child->key, key) <= 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return low;
+}
+
+static void
+insert_index (GPtrArray *array,
+              guint      index,
+              gpointer   data)
+{
+  g_ptr_array_add (array, NULL);
+  memmove (&array->pdata[index + 1], &array->pdata[index],
+           (array->len - 1 - index) * sizeof (gpointer));
+  array->pdata[index] = data;
+}
+
+static void
+renumber_groups (GPtrArray *groups,
+                 guint      from)
+{
+  guint i;
+  for (i = from; i < groups->len; i++)
+    ((Group*) g_ptr_array_index (groups, i))->position = i;
+}
+
+static void
+renumber_children (GPtrArray *children,
+                   guint      from)
+{
+  guint i;
+  for (i = from; i < children->len; i++)
+    ((Child*) g_ptr_array_index (children, i))->position = i;
+}
+
+static void
+move_group (SnippetsModel *model,
+            Group         *group)
+{
+  SnippetsModelPrivate *priv;
+  GtkTreePath *path;
+  guint old_position;
+  guint new_position;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  old_position = group->position;
+  g_ptr_array_remove_index (priv->groups, old_position);
+
+  new_position = find_group_position (priv->groups, group->key);
+  insert_index (priv->groups, new_position, group);
+  renumber_groups (priv->groups, MIN (old_position, new_position));
+
+  if (old_position == new_position)
+    return;
+
+  path = gtk_tree_path_new ();
+  emit_reordered (model, path, NULL, priv->groups->len, old_position, new_position);
+  gtk_tree_path_free (path);
+}
+
+static void
+move_child (SnippetsModel *model,
+            Child         *child)
+{
+  GtkTreePath *path;
+  GtkTreeIter parent;
+  Group *group;
+  guint old_position;
+  guint new_position;
+
+  group = child->group;
+
+  old_position = child->position;
+  g_ptr_array_remove_index (group->children, old_position);
+
+  new_position = find_child_position (group->children, child->key);
+  insert_index (group->children, new_position, child);
+  renumber_children (group->children, MIN (old_position, new_position));
+
+  if (old_position == new_position)
+    return;
+
+  fill_iter (model, &parent, group, NULL);
+  path = get_path (GTK_TREE_MODEL (model), &parent);
+  emit_reordered (model, path, &parent, group->children->len, old_position, new_position);
+  gtk_tree_path_free (path);
+}
+
+static void
+emit_reordered (SnippetsModel *model,
+                GtkTreePath   *path,
+                GtkTreeIter   *iter,
+                guint          length,
+                guint          old_position,
+                guint          new_position)
+{
+  gint *new_order;
+  guint i;
+
+  new_order = g_new (gint, length);
+
+  for (i = 0; i < length; i++)
+    new_order[i] = i;
+
+  new_order[new_position] = old_position;
+
+  if (new_position < old_position)
+    for (i = new_position + 1; i <= old_position; i++)
+      new_order[i] = i - 1;
+  else
+    for (i = old_position; i < new_position; i++)
+      new_order[i] = i + 1;
+
+  gtk_tree_model_rows_reordered (GTK_TREE_MODEL (model), path, iter, new_order);
+
+  g_free (new_order);
+}
+
+static gchar*
+get_collate_key (const gchar *text)
+{
+  return g_utf8_collate_key (text != NULL ? text : "", -1);
+}
+
+static void
+group_free (Group *group)
+{
+  g_ptr_array_foreach (group->children, (GFunc) child_free, NULL);
+  g_ptr_array_free (group->children, TRUE);
+  g_free (group->file_types);
+  snippets_file_types_free (group->set);
+  g_free (group->key);
+  g_slice_free (Group, group);
+}
+
+static Group*
+find_duplicate_group (SnippetsModel *model,
+                      Group         *group)
+{
+  SnippetsModelPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  for (i = 0; i < priv->groups->len; i++)
+    {
+      Group *other = g_ptr_array_index (priv->groups, i);
+      if (other != group && snippets_file_types_equal (other->set, group->set))
+        return other;
+    }
+
+  return NULL;
+}
+
+/*
+ * The group row goes, which takes its children out of the view with it,
+ * and the snippets are appended to the target one by one so that it can
+ * place them and tell the view. They take on the file types as the target
+ * spells them.
+ */
+static void
+merge_group (SnippetsModel *model,
+             Group         *group,
+             Group         *target)
+{
+  SnippetsModelPrivate *priv;
+  GtkTreeIter target_iter;
+  GtkTreePath *path;
+  GPtrArray *configs;
+  guint position;
+  guint i;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  configs = g_ptr_array_sized_new (group->children->len);
+  for (i = 0; i < group->children->len; i++)
+    {
+      Child *child = g_ptr_array_index (group->children, i);
+      g_ptr_array_add (configs, child->config);
+    }
+
+  position = group->position;
+  path = gtk_tree_path_new_from_indices (position, -1);
+
+  forget_children (model, group);
+  g_ptr_array_remove_index (priv->groups, position);
+  group_free (group);
+  renumber_groups (priv->groups, position);
+  gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), path);
+  gtk_tree_path_free (path);
+
+  fill_iter (model, &target_iter, target, NULL);
+
+  for (i = 0; i < configs->len; i++)
+    {
+      SnippetsConfig *config = g_ptr_array_index (configs, i);
+      snippets_config_set_file_types (config, target->file_types);
+      snippets_model_append_config (model, &target_iter, config, NULL);
+    }
+
+  g_ptr_array_free (configs, TRUE);
+}
+
+static void
+forget_children (SnippetsModel *model,
+                 Group         *group)
+{
+  SnippetsModelPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_MODEL_GET_PRIVATE (model);
+
+  for (i = 0; i < group->children->len; i++)
+    {
+      Child *child = g_ptr_array_index (group->children, i);
+      g_hash_table_remove (priv->rows, child->config);
+    }
+}
+
+static void
+child_free (Child *child)
+{
+  g_free (child->key);
+  g_slice_free (Child, child);
+}
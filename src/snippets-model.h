@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_MODEL_H__
+#define	__SNIPPETS_MODEL_H__
+
+#include <gtk/gtk.h>
+#include "snippets-config.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_MODEL_TYPE            (snippets_model_get_type ())
+#define SNIPPETS_MODEL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_MODEL_TYPE, SnippetsModel))
+#define SNIPPETS_MODEL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_MODEL_TYPE, SnippetsModelClass))
+#define IS_SNIPPETS_MODEL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_MODEL_TYPE))
+#define IS_SNIPPETS_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_MODEL_TYPE))
+
+typedef struct _SnippetsModel SnippetsModel;
+typedef struct _SnippetsModelClass SnippetsModelClass;
+
+struct _SnippetsModel
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsModelClass
+{
+  GObjectClass parent_class;
+};
+
+enum
+{
+  SNIPPETS_MODEL_TEXT = 0,
+  SNIPPETS_MODEL_CONFIGURATION,
+  SNIPPETS_MODEL_COLUMNS
+};
+
+GType snippets_model_get_type (void) G_GNUC_CONST;
+
+SnippetsModel*  snippets_model_new            (void);
+
+void            snippets_model_append_group   (SnippetsModel  *model,
+                                               const gchar    *file_types,
+                                               GtkTreeIter    *iter);
+void            snippets_model_append_config  (SnippetsModel  *model,
+                                               GtkTreeIter    *parent,
+                                               SnippetsConfig *config,
+                                               GtkTreeIter    *iter);
+void            snippets_model_remove         (SnippetsModel  *model,
+                                               GtkTreeIter    *iter);
+void            snippets_model_clear          (SnippetsModel  *model);
+gboolean        snippets_model_find_config    (SnippetsModel  *model,
+                                               SnippetsConfig *config,
+                                               GtkTreeIter    *iter);
+gboolean        snippets_model_find_group     (SnippetsModel             *model,
+                                               const SnippetsFileTypeSet *set,
+                                               GtkTreeIter               *iter);
+void            snippets_model_set_text       (SnippetsModel  *model,
+                                               GtkTreeIter    *iter,
+                                               const gchar    *text);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_MODEL_H__ */
@@ -18,6 +18,7 @@
 
 #include <codeslayer/codeslayer.h>
 #include "snippets-engine.h"
+#include "snippets-menu.h"
 #include <gdk/gdkkeysyms.h>
 #include <gtk/gtk.h>
 #include <gmodule.h>
@@ -28,18 +29,26 @@ G_MODULE_EXPORT void deactivate        (CodeSlayer       *codeslayer);
 G_MODULE_EXPORT void configure         (CodeSlayer       *codeslayer);
 
 static SnippetsEngine *engine;
+static GtkWidget *menu;
 
 G_MODULE_EXPORT void
 activate (CodeSlayer *codeslayer)
 {
-  engine = snippets_engine_new (codeslayer);
+  GtkAccelGroup *accel_group;
+  accel_group = codeslayer_get_menu_bar_accel_group (codeslayer);
+  menu = snippets_menu_new (accel_group);
+  
+  engine = snippets_engine_new (codeslayer, menu);
   snippets_engine_load_configs (engine);
+  
+  codeslayer_add_to_menu_bar (codeslayer, GTK_MENU_ITEM (menu));
 }
 
 G_MODULE_EXPORT void 
 deactivate (CodeSlayer *codeslayer)
 {
   g_object_unref (engine);
+  codeslayer_remove_from_menu_bar (codeslayer, GTK_MENU_ITEM (menu));
 }
 
 G_MODULE_EXPORT void 
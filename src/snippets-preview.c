@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <gdk/gdkkeysyms.h>
+#include "snippets-preview.h"
+
+/*
+ * A popup that lists the snippets sharing a trigger next to what the
+ * selected one expands to. Every rendering is kept in a source buffer of
+ * its own per snippet and language, so stepping through the list only
+ * swaps buffers and each snippet is highlighted once. The renderings of
+ * a language are found by the id of the snippet, which outlives the
+ * config when the config is replaced by an edited copy.
+ */
+
+typedef struct
+{
+  guint64          id;
+  GtkSourceBuffer *buffer;
+  gchar           *file_path;
+  guint            stamp;
+  gboolean         rendered;
+} Rendering;
+
+static void snippets_preview_class_init  (SnippetsPreviewClass *klass);
+static void snippets_preview_init        (SnippetsPreview      *preview);
+static void snippets_preview_finalize    (SnippetsPreview      *preview);
+
+static void add_content                  (SnippetsPreview      *preview);
+static void select_row_action            (GtkTreeSelection     *selection,
+                                          SnippetsPreview      *preview);
+static gboolean focus_out_action         (SnippetsPreview      *preview);
+static GtkSourceBuffer* get_rendering    (SnippetsPreview      *preview,
+                                          SnippetsConfig       *config);
+static void move_selection               (SnippetsPreview      *preview,
+                                          gboolean              forward);
+static void activate_selection           (SnippetsPreview      *preview);
+static void cancel                       (SnippetsPreview      *preview);
+static void position_window              (SnippetsPreview      *preview,
+                                          GtkTextView          *text_view);
+static void rendering_free               (Rendering            *rendering);
+
+#define SNIPPETS_PREVIEW_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_PREVIEW_TYPE, SnippetsPreviewPrivate))
+
+typedef struct _SnippetsPreviewPrivate SnippetsPreviewPrivate;
+
+struct _SnippetsPreviewPrivate
+{
+  GtkWidget            *tree;
+  GtkListStore         *store;
+  GtkWidget            *source_view;
+  GHashTable           *renderings;
+  GHashTable           *language_renderings;
+  GString              *scratch;
+  GString              *output;
+  GtkTextView          *text_view;
+  GtkSourceLanguage    *language;
+  GtkSourceStyleScheme *style_scheme;
+  gchar                *file_path;
+  gulong                focus_out_id;
+  gulong                button_press_id;
+};
+
+enum
+{
+  NAME = 0,
+  CONFIGURATION,
+  COLUMNS
+};
+
+enum
+{
+  CONFIG_ACTIVATED,
+  LAST_SIGNAL
+};
+
+static guint snippets_preview_signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (SnippetsPreview, snippets_preview, GTK_TYPE_WINDOW)
+
+static void
+snippets_preview_class_init (SnippetsPreviewClass *klass)
+{
+  snippets_preview_signals[CONFIG_ACTIVATED] =
+    g_signal_new ("config-activated",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsPreviewClass, config_activated),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) snippets_preview_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsPreviewPrivate));
+}
+
+static void
+snippets_preview_init (SnippetsPreview *preview)
+{
+  SnippetsPreviewPrivate *priv;
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+  priv->renderings = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, 
+                                            (GDestroyNotify) g_hash_table_destroy);
+  priv->language_renderings = NULL;
+  priv->scratch = g_string_new (NULL);
+  priv->output = g_string_new (NULL);
+  priv->text_view = NULL;
+  priv->file_path = NULL;
+}
+
+static void
+snippets_preview_finalize (SnippetsPreview *preview)
+{
+  SnippetsPreviewPrivate *priv;
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+  if (priv->text_view != NULL)
+    {
+      g_signal_handler_disconnect (priv->text_view, priv->focus_out_id);
+      g_signal_handler_disconnect (priv->text_view, priv->button_press_id);
+    }
+  g_hash_table_destroy (priv->renderings);
+  g_string_free (priv->scratch, TRUE);
+  g_string_free (priv->output, TRUE);
+  g_object_unref (priv->store);
+  g_free (priv->file_path);
+  G_OBJECT_CLASS (snippets_preview_parent_class)->finalize (G_OBJECT (preview));
+}
+
+GtkWidget*
+snippets_preview_new (void)
+{
+  GtkWidget *preview;
+  preview = g_object_new (snippets_preview_get_type (), "type", GTK_WINDOW_POPUP, NULL);
+  add_content (SNIPPETS_PREVIEW (preview));
+  return preview;
+}
+
+static void
+add_content (SnippetsPreview *preview)
+{
+  SnippetsPreviewPrivate *priv;
+  GtkWidget *frame;
+  GtkWidget *hbox;
+  GtkWidget *tree;
+  GtkListStore *store;
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *renderer;
+  GtkTreeSelection *selection;
+  GtkWidget *source_view;
+  GtkWidget *tree_window;
+  GtkWidget *source_window;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  frame = gtk_frame_new (NULL);
+  gtk_frame_set_shadow_type (GTK_FRAME (frame), GTK_SHADOW_OUT);
+  hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+
+  /* the snippets */
+
+  tree = gtk_tree_view_new ();
+  priv->tree = tree;
+
+  store = gtk_list_store_new (COLUMNS, G_TYPE_STRING, G_TYPE_POINTER);
+  priv->store = store;
+
+  gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (tree), FALSE);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (tree), GTK_TREE_MODEL (store));
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (tree));
+  gtk_tree_selection_set_mode (selection, GTK_SELECTION_BROWSE);
+
+  column = gtk_tree_view_column_new ();
+  renderer = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, renderer, FALSE);
+  gtk_tree_view_column_set_attributes (column, renderer, "text", NAME, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (tree), column);
+
+  tree_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (tree_window),
+                                  GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+  gtk_container_add (GTK_CONTAINER (tree_window), tree);
+  gtk_widget_set_size_request (tree_window, 150, 200);
+
+  g_signal_connect (G_OBJECT (selection), "changed",
+                    G_CALLBACK (select_row_action), preview);
+
+  /* the rendering */
+
+  source_view = gtk_source_view_new ();
+  priv->source_view = source_view;
+
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (source_view), FALSE);
+  gtk_text_view_set_cursor_visible (GTK_TEXT_VIEW (source_view), FALSE);
+
+  source_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (source_window),
+                                  GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+  gtk_container_add (GTK_CONTAINER (source_window), source_view);
+  gtk_widget_set_size_request (source_window, 400, 200);
+
+  /* pack everything in */
+
+  gtk_box_pack_start (GTK_BOX (hbox), tree_window, FALSE, FALSE, 0);
+  gtk_box_pack_start (GTK_BOX (hbox), source_window, TRUE, TRUE, 0);
+  gtk_container_add (GTK_CONTAINER (frame), hbox);
+  gtk_container_add (GTK_CONTAINER (preview), frame);
+}
+
+void
+snippets_preview_show (SnippetsPreview         *preview,
+                       GtkTextView             *text_view,
+                       GList                   *configs,
+                       SnippetsTemplateContext *context)
+{
+  SnippetsPreviewPrivate *priv;
+  GtkTextBuffer *buffer;
+  GtkTreeSelection *selection;
+  GtkTreeIter iter;
+  PangoFontDescription *font_description;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  cancel (preview);
+
+  priv->text_view = text_view;
+
+  buffer = gtk_text_view_get_buffer (text_view);
+  priv->language = gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (buffer));
+  
+  /* the languages stay loaded for as long as the program runs */
+  priv->language_renderings = g_hash_table_lookup (priv->renderings, priv->language);
+  if (priv->language_renderings == NULL)
+    {
+      priv->language_renderings = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, 
+                                                         (GDestroyNotify) rendering_free);
+      g_hash_table_insert (priv->renderings, priv->language, priv->language_renderings);
+    }
+    
+  priv->style_scheme = gtk_source_buffer_get_style_scheme (GTK_SOURCE_BUFFER (buffer));
+
+  g_free (priv->file_path);
+  priv->file_path = g_strdup (context->file_path);
+
+  font_description = pango_context_get_font_description (gtk_widget_get_pango_context (GTK_WIDGET (text_view)));
+  gtk_widget_override_font (priv->source_view, font_description);
+
+  gtk_list_store_clear (priv->store);
+
+  while (configs != NULL)
+    {
+      SnippetsConfig *config = configs->data;
+      gtk_list_store_append (priv->store, &iter);
+      gtk_list_store_set (priv->store, &iter,
+                          NAME, snippets_config_get_name (config),
+                          CONFIGURATION, config, -1);
+      configs = g_list_next (configs);
+    }
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree));
+  if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->store), &iter))
+    gtk_tree_selection_select_iter (selection, &iter);
+
+  priv->focus_out_id = g_signal_connect_swapped (G_OBJECT (text_view), "focus-out-event",
+                                                 G_CALLBACK (focus_out_action), preview);
+  priv->button_press_id = g_signal_connect_swapped (G_OBJECT (text_view), "button-press-event",
+                                                    G_CALLBACK (focus_out_action), preview);
+
+  position_window (preview, text_view);
+  gtk_widget_show_all (GTK_WIDGET (preview));
+}
+
+/*
+ * Called with every key pressed in the editor. While the popup is up the
+ * arrows move through the snippets, Tab or Return expands the selected one
+ * and Escape closes it. Any other key closes it and is passed on.
+ */
+gboolean
+snippets_preview_key_press (SnippetsPreview *preview,
+                            GdkEventKey     *event)
+{
+  SnippetsPreviewPrivate *priv;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  if (priv->text_view == NULL || event->is_modifier)
+    return FALSE;
+
+  switch (event->keyval)
+    {
+    case GDK_KEY_Up:
+      move_selection (preview, FALSE);
+      return TRUE;
+    case GDK_KEY_Down:
+      move_selection (preview, TRUE);
+      return TRUE;
+    case GDK_KEY_Tab:
+    case GDK_KEY_Return:
+    case GDK_KEY_KP_Enter:
+      activate_selection (preview);
+      return TRUE;
+    case GDK_KEY_Escape:
+      cancel (preview);
+      return TRUE;
+    }
+
+  cancel (preview);
+  return FALSE;
+}
+
+/*
+ * The renderings point at the configs, so they have to go whenever the
+ * configs are replaced.
+ */
+void
+snippets_preview_clear_cache (SnippetsPreview *preview)
+{
+  SnippetsPreviewPrivate *priv;
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+  cancel (preview);
+  gtk_list_store_clear (priv->store);
+  g_hash_table_remove_all (priv->renderings);
+  priv->language_renderings = NULL;
+}
+
+/*
+ * Drops the renderings of a config that is going away, in every language
+ * it was rendered in.
+ */
+void
+snippets_preview_forget (SnippetsPreview *preview,
+                         SnippetsConfig  *config)
+{
+  SnippetsPreviewPrivate *priv;
+  GHashTableIter iter;
+  gpointer value;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  cancel (preview);
+  gtk_list_store_clear (priv->store);
+
+  g_hash_table_iter_init (&iter, priv->renderings);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_hash_table_remove (value, snippets_config_peek_id (config));
+}
+
+static void
+select_row_action (GtkTreeSelection *selection,
+                   SnippetsPreview  *preview)
+{
+  SnippetsPreviewPrivate *priv;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  if (gtk_tree_selection_get_selected (selection, &model, &iter))
+    {
+      SnippetsConfig *config;
+      GtkSourceBuffer *buffer;
+
+      gtk_tree_model_get (model, &iter, CONFIGURATION, &config, -1);
+
+      buffer = get_rendering (preview, config);
+      gtk_text_view_set_buffer (GTK_TEXT_VIEW (priv->source_view), GTK_TEXT_BUFFER (buffer));
+    }
+}
+
+static gboolean
+focus_out_action (SnippetsPreview *preview)
+{
+  cancel (preview);
+  return FALSE;
+}
+
+static GtkSourceBuffer*
+get_rendering (SnippetsPreview *preview,
+               SnippetsConfig  *config)
+{
+  SnippetsPreviewPrivate *priv;
+  Rendering *rendering;
+  guint stamp;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  rendering = g_hash_table_lookup (priv->language_renderings, 
+                                   snippets_config_peek_id (config));
+
+  if (rendering == NULL)
+    {
+      rendering = g_slice_new0 (Rendering);
+      rendering->id = snippets_config_get_id (config);
+      rendering->buffer = gtk_source_buffer_new (NULL);
+      gtk_source_buffer_set_language (rendering->buffer, priv->language);
+      gtk_source_buffer_set_highlight_matching_brackets (rendering->buffer, FALSE);
+      g_hash_table_insert (priv->language_renderings, &rendering->id, rendering);
+    }
+
+  if (priv->style_scheme != NULL && 
+      gtk_source_buffer_get_style_scheme (rendering->buffer) != priv->style_scheme)
+    gtk_source_buffer_set_style_scheme (rendering->buffer, priv->style_scheme);
+
+  stamp = snippets_config_get_expansion_stamp (config);
+
+  /* 
+   * the file variables are the only thing that differs within a language,
+   * the text is only looked at again once the snippet or one it includes
+   * was edited
+   */
+  if (!rendering->rendered || rendering->stamp != stamp ||
+      g_strcmp0 (rendering->file_path, priv->file_path) != 0)
+    {
+      SnippetsTemplateContext context;
+
+      context.file_path = priv->file_path;
+      context.matches = NULL;
+      context.selection = NULL;
+      context.cache = NULL;
+      context.commands = NULL;
+      snippets_template_render_to (snippets_config_get_expansion (config, priv->scratch), 
+                                   &context, NULL, priv->output);
+      gtk_text_buffer_set_text (GTK_TEXT_BUFFER (rendering->buffer), 
+                                priv->output->str, priv->output->len);
+
+      g_free (rendering->file_path);
+      rendering->file_path = g_strdup (priv->file_path);
+      rendering->stamp = stamp;
+      rendering->rendered = TRUE;
+    }
+
+  return rendering->buffer;
+}
+
+static void
+move_selection (SnippetsPreview *preview,
+                gboolean         forward)
+{
+  SnippetsPreviewPrivate *priv;
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  GtkTreePath *path;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree));
+  if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+    return;
+
+  path = gtk_tree_model_get_path (model, &iter);
+
+  if (forward)
+    gtk_tree_path_next (path);
+  else
+    gtk_tree_path_prev (path);
+
+  if (gtk_tree_model_get_iter (model, &iter, path))
+    {
+      gtk_tree_selection_select_iter (selection, &iter);
+      gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (priv->tree), path, NULL, FALSE, 0, 0);
+    }
+
+  gtk_tree_path_free (path);
+}
+
+static void
+activate_selection (SnippetsPreview *preview)
+{
+  SnippetsPreviewPrivate *priv;
+  GtkTreeSelection *selection;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  SnippetsConfig *config = NULL;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree));
+  if (gtk_tree_selection_get_selected (selection, &model, &iter))
+    gtk_tree_model_get (model, &iter, CONFIGURATION, &config, -1);
+
+  cancel (preview);
+
+  if (config != NULL)
+    g_signal_emit_by_name ((gpointer) preview, "config-activated", config);
+}
+
+static void
+cancel (SnippetsPreview *preview)
+{
+  SnippetsPreviewPrivate *priv;
+
+  priv = SNIPPETS_PREVIEW_GET_PRIVATE (preview);
+
+  if (priv->text_view == NULL)
+    return;
+
+  g_signal_handler_disconnect (priv->text_view, priv->focus_out_id);
+  g_signal_handler_disconnect (priv->text_view, priv->button_press_id);
+  priv->text_view = NULL;
+
+  gtk_widget_hide (GTK_WIDGET (preview));
+}
+
+/*
+ * Put the popup just below the cursor, in screen coordinates.
+ */
+static void
+position_window (SnippetsPreview *preview,
+                 GtkTextView     *text_view)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GdkRectangle location;
+  gint window_x;
+  gint window_y;
+  gint origin_x;
+  gint origin_y;
+
+  buffer = gtk_text_view_get_buffer (text_view);
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+
+  gtk_text_view_get_iter_location (text_view, &iter, &location);
+  gtk_text_view_buffer_to_window_coords (text_view, GTK_TEXT_WINDOW_WIDGET,
+                                         location.x, location.y + location.height,
+                                         &window_x, &window_y);
+
+  gdk_window_get_origin (gtk_widget_get_window (GTK_WIDGET (text_view)), &origin_x, &origin_y);
+
+  gtk_window_set_screen (GTK_WINDOW (preview), gtk_widget_get_screen (GTK_WIDGET (text_view)));
+  gtk_window_move (GTK_WINDOW (preview), origin_x + window_x, origin_y + window_y);
+}
+
+static void
+rendering_free (Rendering *rendering)
+{
+  g_object_unref (rendering->buffer);
+  g_free (rendering->file_path);
+  g_slice_free (Rendering, rendering);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_PREVIEW_H__
+#define	__SNIPPETS_PREVIEW_H__
+
+#include <gtk/gtk.h>
+#include <codeslayer/codeslayer.h>
+#include "snippets-config.h"
+#include "snippets-template.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_PREVIEW_TYPE            (snippets_preview_get_type ())
+#define SNIPPETS_PREVIEW(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_PREVIEW_TYPE, SnippetsPreview))
+#define SNIPPETS_PREVIEW_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_PREVIEW_TYPE, SnippetsPreviewClass))
+#define IS_SNIPPETS_PREVIEW(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_PREVIEW_TYPE))
+#define IS_SNIPPETS_PREVIEW_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_PREVIEW_TYPE))
+
+typedef struct _SnippetsPreview SnippetsPreview;
+typedef struct _SnippetsPreviewClass SnippetsPreviewClass;
+
+struct _SnippetsPreview
+{
+  GtkWindow parent_instance;
+};
+
+struct _SnippetsPreviewClass
+{
+  GtkWindowClass parent_class;
+
+  void (*config_activated) (SnippetsPreview *preview,
+                            SnippetsConfig  *config);
+};
+
+GType snippets_preview_get_type (void) G_GNUC_CONST;
+
+GtkWidget*  snippets_preview_new          (void);
+
+void        snippets_preview_show         (SnippetsPreview         *preview,
+                                           GtkTextView             *text_view,
+                                           GList                   *configs,
+                                           SnippetsTemplateContext *context);
+gboolean    snippets_preview_key_press    (SnippetsPreview         *preview,
+                                           GdkEventKey             *event);
+void        snippets_preview_clear_cache  (SnippetsPreview         *preview);
+void        snippets_preview_forget       (SnippetsPreview         *preview,
+                                           SnippetsConfig          *config);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_PREVIEW_H__ */
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-provider.h"
+#include "snippets-template.h"
+#include "snippets-text.h"
+
+/*
+ * Offers the snippets whose trigger starts with the word being typed. The
+ * lookup is put off to an idle so that populate returns straight away, and
+ * the proposals are kept per set of file types the document matches and
+ * prefix, so that typing the same prefix again in any file that matches
+ * the same snippets costs nothing. The cache goes whenever the index
+ * changes.
+ */
+
+#define PROPOSALS_LIMIT 50
+#define CACHE_SIZE 256
+
+static void snippets_provider_class_init      (SnippetsProviderClass            *klass);
+static void snippets_provider_init            (SnippetsProvider                 *provider);
+static void snippets_provider_finalize        (SnippetsProvider                 *provider);
+static void snippets_provider_completion_init (GtkSourceCompletionProviderIface *iface);
+
+static gchar* get_name                        (GtkSourceCompletionProvider      *completion_provider);
+static void populate                          (GtkSourceCompletionProvider      *completion_provider,
+                                               GtkSourceCompletionContext       *context);
+static GtkWidget* get_info_widget             (GtkSourceCompletionProvider      *completion_provider,
+                                               GtkSourceCompletionProposal      *proposal);
+static void update_info                       (GtkSourceCompletionProvider      *completion_provider,
+                                               GtkSourceCompletionProposal      *proposal,
+                                               GtkSourceCompletionInfo          *info);
+static gboolean get_start_iter                (GtkSourceCompletionProvider      *completion_provider,
+                                               GtkSourceCompletionContext       *context,
+                                               GtkSourceCompletionProposal      *proposal,
+                                               GtkTextIter                      *iter);
+static gboolean activate_proposal             (GtkSourceCompletionProvider      *completion_provider,
+                                               GtkSourceCompletionProposal      *proposal,
+                                               GtkTextIter                      *iter);
+
+static gboolean populate_idle                 (SnippetsProvider                 *provider);
+static void cancel_populate                   (SnippetsProvider                 *provider);
+static GList* get_proposals                   (SnippetsProvider                 *provider,
+                                               const gchar                      *prefix,
+                                               const gchar                      *file_path);
+static gchar* get_cache_key                   (const SnippetsFileTypeSet        *set,
+                                               const gchar                      *prefix);
+static const gchar* get_file_path             (SnippetsProvider                 *provider);
+static void proposals_free                    (GList                            *proposals);
+static gboolean proposals_match               (const gchar                      *key,
+                                               GList                            *proposals,
+                                               const gchar                      *trigger);
+
+#define SNIPPETS_PROVIDER_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_PROVIDER_TYPE, SnippetsProviderPrivate))
+
+typedef struct _SnippetsProviderPrivate SnippetsProviderPrivate;
+
+struct _SnippetsProviderPrivate
+{
+  CodeSlayer                 *codeslayer;
+  SnippetsIndex              *index;
+  GHashTable                 *proposals;
+  GtkSourceCompletionContext *context;
+  gulong                      cancelled_id;
+  guint                       idle_id;
+  GtkWidget                  *info_view;
+};
+
+enum
+{
+  CONFIG_ACTIVATED,
+  LAST_SIGNAL
+};
+
+static guint snippets_provider_signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE_WITH_CODE (SnippetsProvider, snippets_provider, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (GTK_SOURCE_TYPE_COMPLETION_PROVIDER,
+                                                snippets_provider_completion_init))
+
+static void
+snippets_provider_class_init (SnippetsProviderClass *klass)
+{
+  snippets_provider_signals[CONFIG_ACTIVATED] =
+    g_signal_new ("config-activated",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+                  G_STRUCT_OFFSET (SnippetsProviderClass, config_activated),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+  G_OBJECT_CLASS (klass)->finalize = (GObjectFinalizeFunc) snippets_provider_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsProviderPrivate));
+}
+
+static void
+snippets_provider_completion_init (GtkSourceCompletionProviderIface *iface)
+{
+  iface->get_name = get_name;
+  iface->populate = populate;
+  iface->get_info_widget = get_info_widget;
+  iface->update_info = update_info;
+  iface->get_start_iter = get_start_iter;
+  iface->activate_proposal = activate_proposal;
+}
+
+static void
+snippets_provider_init (SnippetsProvider *provider)
+{
+  SnippetsProviderPrivate *priv;
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+  priv->index = NULL;
+  priv->context = NULL;
+  priv->idle_id = 0;
+  priv->proposals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) proposals_free);
+  priv->info_view = g_object_ref_sink (gtk_source_view_new ());
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (priv->info_view), FALSE);
+  gtk_text_view_set_cursor_visible (GTK_TEXT_VIEW (priv->info_view), FALSE);
+}
+
+static void
+snippets_provider_finalize (SnippetsProvider *provider)
+{
+  SnippetsProviderPrivate *priv;
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+  cancel_populate (provider);
+  if (priv->index != NULL)
+    g_object_unref (priv->index);
+  g_hash_table_destroy (priv->proposals);
+  g_object_unref (priv->info_view);
+  G_OBJECT_CLASS (snippets_provider_parent_class)->finalize (G_OBJECT (provider));
+}
+
+SnippetsProvider*
+snippets_provider_new (CodeSlayer *codeslayer)
+{
+  SnippetsProviderPrivate *priv;
+  SnippetsProvider *provider;
+
+  provider = SNIPPETS_PROVIDER (g_object_new (snippets_provider_get_type (), NULL));
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+  priv->codeslayer = codeslayer;
+
+  return provider;
+}
+
+/*
+ * Also called when snippets were added to the same index, either way the
+ * proposals we have are out of date.
+ */
+void
+snippets_provider_set_index (SnippetsProvider *provider,
+                             SnippetsIndex    *index)
+{
+  SnippetsProviderPrivate *priv;
+
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  g_object_ref (index);
+  if (priv->index != NULL)
+    g_object_unref (priv->index);
+  priv->index = index;
+
+  g_hash_table_remove_all (priv->proposals);
+}
+
+static gboolean
+proposals_match (const gchar *key,
+                 GList       *proposals,
+                 const gchar *trigger)
+{
+  const gchar *prefix;
+  prefix = strchr (key, '\n') + 1;
+  return g_str_has_prefix (trigger, prefix);
+}
+
+/*
+ * Drops the proposals for every prefix of the trigger, those are the only
+ * ones a snippet with that trigger could have been listed under. 
+ */
+void
+snippets_provider_forget (SnippetsProvider *provider,
+                          const gchar      *trigger)
+{
+  SnippetsProviderPrivate *priv;
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+  g_hash_table_foreach_remove (priv->proposals, (GHRFunc) proposals_match, 
+                               (gpointer) trigger);
+}
+
+static gchar*
+get_name (GtkSourceCompletionProvider *completion_provider)
+{
+  return g_strdup (_("Snippets"));
+}
+
+static void
+populate (GtkSourceCompletionProvider *completion_provider,
+          GtkSourceCompletionContext  *context)
+{
+  SnippetsProvider *provider;
+  SnippetsProviderPrivate *priv;
+
+  provider = SNIPPETS_PROVIDER (completion_provider);
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  cancel_populate (provider);
+
+  priv->context = g_object_ref (context);
+  priv->cancelled_id = g_signal_connect_swapped (G_OBJECT (context), "cancelled",
+                                                 G_CALLBACK (cancel_populate), provider);
+  priv->idle_id = g_idle_add ((GSourceFunc) populate_idle, provider);
+}
+
+static GtkWidget*
+get_info_widget (GtkSourceCompletionProvider *completion_provider,
+                 GtkSourceCompletionProposal *proposal)
+{
+  SnippetsProviderPrivate *priv;
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (completion_provider);
+  return priv->info_view;
+}
+
+static void
+update_info (GtkSourceCompletionProvider *completion_provider,
+             GtkSourceCompletionProposal *proposal,
+             GtkSourceCompletionInfo     *info)
+{
+  SnippetsProvider *provider;
+  SnippetsProviderPrivate *priv;
+  SnippetsTemplateContext context;
+  SnippetsConfig *config;
+  CodeSlayerEditor *editor;
+  GtkTextBuffer *buffer;
+  GString *scratch;
+  gchar *text;
+
+  provider = SNIPPETS_PROVIDER (completion_provider);
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  config = g_object_get_data (G_OBJECT (proposal), "config");
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (priv->info_view));
+
+  editor = codeslayer_get_active_editor (priv->codeslayer);
+  if (editor != NULL)
+    {
+      GtkTextBuffer *editor_buffer;
+      editor_buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor));
+      gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (buffer), 
+                                      gtk_source_buffer_get_language (GTK_SOURCE_BUFFER (editor_buffer)));
+    }
+
+  context.file_path = get_file_path (provider);
+  context.matches = NULL;
+  context.selection = NULL;
+  context.cache = NULL;
+  context.commands = NULL;
+  scratch = g_string_new (NULL);
+  text = snippets_template_render (snippets_config_get_expansion (config, scratch), &context, NULL);
+  gtk_text_buffer_set_text (buffer, text, -1);
+  g_string_free (scratch, TRUE);
+  g_free (text);
+}
+
+static gboolean
+get_start_iter (GtkSourceCompletionProvider *completion_provider,
+                GtkSourceCompletionContext  *context,
+                GtkSourceCompletionProposal *proposal,
+                GtkTextIter                 *iter)
+{
+  gtk_source_completion_context_get_iter (context, iter);
+  snippets_text_move_word_start (iter);
+  return TRUE;
+}
+
+/*
+ * The engine does the expanding, the same way as for Tab.
+ */
+static gboolean
+activate_proposal (GtkSourceCompletionProvider *completion_provider,
+                   GtkSourceCompletionProposal *proposal,
+                   GtkTextIter                 *iter)
+{
+  SnippetsConfig *config;
+  config = g_object_get_data (G_OBJECT (proposal), "config");
+  g_signal_emit_by_name ((gpointer) completion_provider, "config-activated", config);
+  return TRUE;
+}
+
+static gboolean
+populate_idle (SnippetsProvider *provider)
+{
+  SnippetsProviderPrivate *priv;
+  GtkSourceCompletionContext *context;
+  GtkTextIter start;
+  GtkTextIter end;
+  GList *proposals = NULL;
+  gchar *prefix;
+
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  context = g_object_ref (priv->context);
+  priv->idle_id = 0;
+  cancel_populate (provider);
+
+  gtk_source_completion_context_get_iter (context, &end);
+  start = end;
+  snippets_text_move_word_start (&start);
+
+  prefix = gtk_text_iter_get_text (&start, &end);
+
+  if (priv->index != NULL && *prefix != '\0')
+    proposals = get_proposals (provider, prefix, get_file_path (provider));
+
+  gtk_source_completion_context_add_proposals (context, 
+                                               GTK_SOURCE_COMPLETION_PROVIDER (provider), 
+                                               proposals, TRUE);
+
+  g_free (prefix);
+  g_object_unref (context);
+
+  return FALSE;
+}
+
+static void
+cancel_populate (SnippetsProvider *provider)
+{
+  SnippetsProviderPrivate *priv;
+
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  if (priv->idle_id != 0)
+    {
+      g_source_remove (priv->idle_id);
+      priv->idle_id = 0;
+    }
+
+  if (priv->context != NULL)
+    {
+      g_signal_handler_disconnect (priv->context, priv->cancelled_id);
+      g_object_unref (priv->context);
+      priv->context = NULL;
+    }
+}
+
+static GList*
+get_proposals (SnippetsProvider *provider,
+               const gchar      *prefix,
+               const gchar      *file_path)
+{
+  SnippetsProviderPrivate *priv;
+  GList *proposals = NULL;
+  GList *configs;
+  GList *list;
+  gchar *key;
+
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  key = get_cache_key (snippets_index_get_file_types (priv->index, file_path), prefix);
+
+  if (g_hash_table_lookup_extended (priv->proposals, key, NULL, (gpointer*) &proposals))
+    {
+      g_free (key);
+      return proposals;
+    }
+
+  configs = snippets_index_lookup_prefix (priv->index, prefix, file_path, PROPOSALS_LIMIT);
+
+  for (list = configs; list != NULL; list = g_list_next (list))
+    {
+      SnippetsConfig *config = list->data;
+      GtkSourceCompletionItem *item;
+
+      item = gtk_source_completion_item_new (snippets_config_get_trigger (config),
+                                             snippets_config_get_trigger (config),
+                                             NULL, snippets_config_get_name (config));
+      g_object_set_data (G_OBJECT (item), "config", config);
+      proposals = g_list_prepend (proposals, item);
+    }
+
+  g_list_free (configs);
+  proposals = g_list_reverse (proposals);
+
+  if (g_hash_table_size (priv->proposals) >= CACHE_SIZE)
+    g_hash_table_remove_all (priv->proposals);
+
+  g_hash_table_insert (priv->proposals, key, proposals);
+
+  return proposals;
+}
+
+/*
+ * The words of the set in hex, leaving off the clear ones at the end so a
+ * set made before more file types were numbered gives the same key.
+ */
+static gchar*
+get_cache_key (const SnippetsFileTypeSet *set,
+               const gchar               *prefix)
+{
+  GString *key;
+  guint n_words;
+  guint i;
+
+  n_words = set->n_words;
+  while (n_words > 0 && set->words[n_words - 1] == 0)
+    n_words--;
+
+  key = g_string_new (NULL);
+
+  for (i = 0; i < n_words; i++)
+    g_string_append_printf (key, "%016" G_GINT64_MODIFIER "x", set->words[i]);
+
+  g_string_append_c (key, '\n');
+  g_string_append (key, prefix);
+
+  return g_string_free (key, FALSE);
+}
+
+static const gchar*
+get_file_path (SnippetsProvider *provider)
+{
+  SnippetsProviderPrivate *priv;
+  CodeSlayerDocument *document;
+
+  priv = SNIPPETS_PROVIDER_GET_PRIVATE (provider);
+
+  document = codeslayer_get_active_editor_document (priv->codeslayer);
+  if (document == NULL)
+    return NULL;
+
+  return codeslayer_document_get_file_path (document);
+}
+
+static void
+proposals_free (GList *proposals)
+{
+  g_list_foreach (proposals, (GFunc) g_object_unref, NULL);
+  g_list_free (proposals);
+}
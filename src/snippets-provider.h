@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_PROVIDER_H__
+#define	__SNIPPETS_PROVIDER_H__
+
+#include <gtk/gtk.h>
+#include <codeslayer/codeslayer.h>
+#include "snippets-config.h"
+#include "snippets-index.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_PROVIDER_TYPE            (snippets_provider_get_type ())
+#define SNIPPETS_PROVIDER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_PROVIDER_TYPE, SnippetsProvider))
+#define SNIPPETS_PROVIDER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_PROVIDER_TYPE, SnippetsProviderClass))
+#define IS_SNIPPETS_PROVIDER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_PROVIDER_TYPE))
+#define IS_SNIPPETS_PROVIDER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_PROVIDER_TYPE))
+
+typedef struct _SnippetsProvider SnippetsProvider;
+typedef struct _SnippetsProviderClass SnippetsProviderClass;
+
+struct _SnippetsProvider
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsProviderClass
+{
+  GObjectClass parent_class;
+
+  void (*config_activated) (SnippetsProvider *provider,
+                            SnippetsConfig   *config);
+};
+
+GType snippets_provider_get_type (void) G_GNUC_CONST;
+
+SnippetsProvider*  snippets_provider_new        (CodeSlayer       *codeslayer);
+
+void               snippets_provider_set_index  (SnippetsProvider *provider,
+                                                 SnippetsIndex    *index);
+void               snippets_provider_forget     (SnippetsProvider *provider,
+                                                 const gchar      *trigger);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_PROVIDER_H__ */
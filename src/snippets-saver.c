@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "snippets-saver.h"
+#include "snippets-config.h"
+#include "snippets-io.h"
+
+/*
+ * The library is written out on a thread of its own so that a large one
+ * on a slow disk does not hold up the editor. What gets written is a copy
+ * taken when the save was asked for. Saves that come in while one is
+ * being written are folded together, only the last of them is written.
+ */
+
+static void snippets_saver_class_init  (SnippetsSaverClass *klass);
+static void snippets_saver_init        (SnippetsSaver      *saver);
+static void snippets_saver_finalize    (SnippetsSaver      *saver);
+
+static gpointer save_thread            (SnippetsSaver      *saver);
+static void free_configs               (GList              *configs);
+
+#define SNIPPETS_SAVER_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_SAVER_TYPE, SnippetsSaverPrivate))
+
+typedef struct _SnippetsSaverPrivate SnippetsSaverPrivate;
+
+struct _SnippetsSaverPrivate
+{
+  GMutex    mutex;
+  GThread  *thread;
+  gboolean  running;
+  gchar    *file_path;
+  GList    *configs;
+};
+
+G_DEFINE_TYPE (SnippetsSaver, snippets_saver, G_TYPE_OBJECT)
+
+static void
+snippets_saver_class_init (SnippetsSaverClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_saver_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsSaverPrivate));
+}
+
+static void
+snippets_saver_init (SnippetsSaver *saver)
+{
+  SnippetsSaverPrivate *priv;
+  priv = SNIPPETS_SAVER_GET_PRIVATE (saver);
+  g_mutex_init (&priv->mutex);
+  priv->thread = NULL;
+  priv->running = FALSE;
+  priv->file_path = NULL;
+  priv->configs = NULL;
+}
+
+static void
+snippets_saver_finalize (SnippetsSaver *saver)
+{
+  SnippetsSaverPrivate *priv;
+  priv = SNIPPETS_SAVER_GET_PRIVATE (saver);
+  snippets_saver_flush (saver);
+  g_mutex_clear (&priv->mutex);
+  G_OBJECT_CLASS (snippets_saver_parent_class)->finalize (G_OBJECT (saver));
+}
+
+SnippetsSaver*
+snippets_saver_new (void)
+{
+  return SNIPPETS_SAVER (g_object_new (snippets_saver_get_type (), NULL));
+}
+
+/*
+ * Copying is cheap, the configs share their text with the originals. A
+ * save still waiting to be written is dropped in favour of this one.
+ */
+void
+snippets_saver_save (SnippetsSaver *saver,
+                     const gchar   *file_path,
+                     GList         *configs)
+{
+  SnippetsSaverPrivate *priv;
+  GList *snapshot = NULL;
+  GList *superseded;
+  gchar *superseded_path;
+
+  priv = SNIPPETS_SAVER_GET_PRIVATE (saver);
+
+  for (; configs != NULL; configs = g_list_next (configs))
+    snapshot = g_list_prepend (snapshot, snippets_config_copy (configs->data));
+  snapshot = g_list_reverse (snapshot);
+
+  g_mutex_lock (&priv->mutex);
+
+  superseded = priv->configs;
+  superseded_path = priv->file_path;
+  priv->configs = snapshot;
+  priv->file_path = g_strdup (file_path);
+
+  if (!priv->running)
+    {
+      /* a thread that ran out of work only has to be collected */
+      if (priv->thread != NULL)
+        g_thread_join (priv->thread);
+      priv->running = TRUE;
+      priv->thread = g_thread_new ("snippets-saver", (GThreadFunc) save_thread, saver);
+    }
+
+  g_mutex_unlock (&priv->mutex);
+
+  free_configs (superseded);
+  g_free (superseded_path);
+}
+
+/*
+ * Wait for everything asked for so far to be written.
+ */
+void
+snippets_saver_flush (SnippetsSaver *saver)
+{
+  SnippetsSaverPrivate *priv;
+  GThread *thread;
+
+  priv = SNIPPETS_SAVER_GET_PRIVATE (saver);
+
+  g_mutex_lock (&priv->mutex);
+  thread = priv->thread;
+  priv->thread = NULL;
+  g_mutex_unlock (&priv->mutex);
+
+  if (thread != NULL)
+    g_thread_join (thread);
+}
+
+static gpointer
+save_thread (SnippetsSaver *saver)
+{
+  SnippetsSaverPrivate *priv;
+
+  priv = SNIPPETS_SAVER_GET_PRIVATE (saver);
+
+  for (;;)
+    {
+      GError *error = NULL;
+      gchar *file_path;
+      GList *configs;
+
+      g_mutex_lock (&priv->mutex);
+
+      file_path = priv->file_path;
+      configs = priv->configs;
+      priv->file_path = NULL;
+      priv->configs = NULL;
+
+      if (file_path == NULL)
+        {
+          priv->running = FALSE;
+          g_mutex_unlock (&priv->mutex);
+          return NULL;
+        }
+
+      g_mutex_unlock (&priv->mutex);
+
+      if (!snippets_io_save (file_path, configs, &error))
+        {
+          g_warning ("could not save snippets file %s: %s\n", file_path, error->message);
+          g_error_free (error);
+        }
+
+      free_configs (configs);
+      g_free (file_path);
+    }
+}
+
+static void
+free_configs (GList *configs)
+{
+  g_list_foreach (configs, (GFunc) g_object_unref, NULL);
+  g_list_free (configs);
+}
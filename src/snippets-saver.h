@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_SAVER_H__
+#define	__SNIPPETS_SAVER_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_SAVER_TYPE            (snippets_saver_get_type ())
+#define SNIPPETS_SAVER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_SAVER_TYPE, SnippetsSaver))
+#define SNIPPETS_SAVER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_SAVER_TYPE, SnippetsSaverClass))
+#define IS_SNIPPETS_SAVER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_SAVER_TYPE))
+#define IS_SNIPPETS_SAVER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_SAVER_TYPE))
+
+typedef struct _SnippetsSaver SnippetsSaver;
+typedef struct _SnippetsSaverClass SnippetsSaverClass;
+
+struct _SnippetsSaver
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsSaverClass
+{
+  GObjectClass parent_class;
+};
+
+GType snippets_saver_get_type (void) G_GNUC_CONST;
+
+SnippetsSaver*  snippets_saver_new    (void);
+
+void            snippets_saver_save   (SnippetsSaver *saver,
+                                       const gchar   *file_path,
+                                       GList         *configs);
+void            snippets_saver_flush  (SnippetsSaver *saver);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_SAVER_H__ */
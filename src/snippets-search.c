@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-search.h"
+
+/*
+ * Every snippet gets a case folded copy of its name, trigger and text, and
+ * each distinct trigram of that copy is recorded in a posting list. The ids
+ * are only ever handed out in increasing order so the posting lists stay
+ * sorted and can be intersected. Changing or removing a snippet leaves its
+ * old id behind as a dead entry that is skipped, and the whole index is
+ * compacted once the dead entries outnumber the live ones.
+ */
+
+#define COMPACT_MIN_DEAD 1024
+
+typedef struct
+{
+  SnippetsConfig *config;
+  gchar          *haystack;
+  gsize           head_length;
+} Entry;
+
+static void snippets_search_class_init  (SnippetsSearchClass *klass);
+static void snippets_search_init        (SnippetsSearch      *search);
+static void snippets_search_finalize    (SnippetsSearch      *search);
+
+static void add_entry                   (SnippetsSearch      *search,
+                                         Entry               *entry);
+static void kill_entry                  (SnippetsSearch      *search,
+                                         SnippetsConfig      *config);
+static void compact                     (SnippetsSearch      *search);
+static gchar* get_haystack              (SnippetsConfig      *config,
+                                         gsize               *head_length);
+static void get_trigrams                (const gchar         *text,
+                                         GArray              *trigrams);
+static gint compare_trigrams            (gconstpointer        a,
+                                         gconstpointer        b);
+static gint compare_postings            (GArray             **a,
+                                         GArray             **b);
+static gboolean posting_contains        (GArray              *posting,
+                                         guint                id);
+static void entry_free                  (Entry               *entry);
+
+#define SNIPPETS_SEARCH_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_SEARCH_TYPE, SnippetsSearchPrivate))
+
+typedef struct _SnippetsSearchPrivate SnippetsSearchPrivate;
+
+struct _SnippetsSearchPrivate
+{
+  GPtrArray  *entries;
+  GHashTable *configs;
+  GHashTable *postings;
+  GArray     *trigrams;
+  guint       n_dead;
+};
+
+G_DEFINE_TYPE (SnippetsSearch, snippets_search, G_TYPE_OBJECT)
+
+static void
+snippets_search_class_init (SnippetsSearchClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_search_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsSearchPrivate));
+}
+
+static void
+snippets_search_init (SnippetsSearch *search)
+{
+  SnippetsSearchPrivate *priv;
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+  priv->entries = g_ptr_array_new ();
+  priv->configs = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->postings = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, (GDestroyNotify) g_array_unref);
+  priv->trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+}
+
+static void
+snippets_search_finalize (SnippetsSearch *search)
+{
+  SnippetsSearchPrivate *priv;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  g_ptr_array_foreach (priv->entries, (GFunc) entry_free, NULL);
+  g_ptr_array_free (priv->entries, TRUE);
+  g_hash_table_destroy (priv->configs);
+  g_hash_table_destroy (priv->postings);
+  g_array_free (priv->trigrams, TRUE);
+
+  G_OBJECT_CLASS (snippets_search_parent_class)->finalize (G_OBJECT (search));
+}
+
+SnippetsSearch*
+snippets_search_new (void)
+{
+  return SNIPPETS_SEARCH (g_object_new (snippets_search_get_type (), NULL));
+}
+
+void
+snippets_search_add (SnippetsSearch *search,
+                     SnippetsConfig *config)
+{
+  SnippetsSearchPrivate *priv;
+  Entry *entry;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  if (g_hash_table_lookup_extended (priv->configs, config, NULL, NULL))
+    return;
+
+  entry = g_slice_new0 (Entry);
+  entry->config = config;
+  entry->haystack = get_haystack (config, &entry->head_length);
+
+  add_entry (search, entry);
+}
+
+void
+snippets_search_remove (SnippetsSearch *search,
+                        SnippetsConfig *config)
+{
+  kill_entry (search, config);
+  compact (search);
+}
+
+/*
+ * Called once the name, trigger or text of a snippet has been changed.
+ */
+void
+snippets_search_update (SnippetsSearch *search,
+                        SnippetsConfig *config)
+{
+  SnippetsSearchPrivate *priv;
+  Entry *entry;
+  gsize head_length;
+  gchar *haystack;
+  gpointer id;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  if (!g_hash_table_lookup_extended (priv->configs, config, NULL, &id))
+    return;
+
+  haystack = get_haystack (config, &head_length);
+
+  entry = g_ptr_array_index (priv->entries, GPOINTER_TO_UINT (id));
+  if (g_strcmp0 (entry->haystack, haystack) == 0)
+    {
+      g_free (haystack);
+      return;
+    }
+
+  kill_entry (search, config);
+
+  entry = g_slice_new0 (Entry);
+  entry->config = config;
+  entry->haystack = haystack;
+  entry->head_length = head_length;
+
+  add_entry (search, entry);
+  compact (search);
+}
+
+/*
+ * Returns the set of configs whose name, trigger or text contains the
+ * query, ignoring case. Queries shorter than a trigram only look at the
+ * names and triggers, anything longer has to appear in every posting
+ * list of its trigrams before the text itself is checked.
+ */
+GHashTable*
+snippets_search_find (SnippetsSearch *search,
+                      const gchar    *query)
+{
+  SnippetsSearchPrivate *priv;
+  GHashTable *results;
+  GPtrArray *postings;
+  GArray *shortest;
+  gchar *needle;
+  guint i;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  results = g_hash_table_new (g_direct_hash, g_direct_equal);
+  needle = g_utf8_casefold (query, -1);
+
+  if (strlen (needle) < 3)
+    {
+      for (i = 0; i < priv->entries->len; i++)
+        {
+          Entry *entry = g_ptr_array_index (priv->entries, i);
+          if (entry->config != NULL &&
+              g_strstr_len (entry->haystack, entry->head_length, needle) != NULL)
+            g_hash_table_insert (results, entry->config, entry->config);
+        }
+
+      g_free (needle);
+      return results;
+    }
+
+  get_trigrams (needle, priv->trigrams);
+
+  postings = g_ptr_array_sized_new (priv->trigrams->len);
+
+  for (i = 0; i < priv->trigrams->len; i++)
+    {
+      GArray *posting;
+      guint32 trigram;
+
+      trigram = g_array_index (priv->trigrams, guint32, i);
+      posting = g_hash_table_lookup (priv->postings, GUINT_TO_POINTER (trigram));
+
+      if (posting == NULL)
+        {
+          g_ptr_array_free (postings, TRUE);
+          g_free (needle);
+          return results;
+        }
+
+      g_ptr_array_add (postings, posting);
+    }
+
+  g_ptr_array_sort (postings, (GCompareFunc) compare_postings);
+  shortest = g_ptr_array_index (postings, 0);
+
+  for (i = 0; i < shortest->len; i++)
+    {
+      guint id = g_array_index (shortest, guint, i);
+      Entry *entry;
+      guint j;
+
+      entry = g_ptr_array_index (priv->entries, id);
+      if (entry->config == NULL)
+        continue;
+
+      for (j = 1; j < postings->len; j++)
+        {
+          if (!posting_contains (g_ptr_array_index (postings, j), id))
+            break;
+        }
+
+      if (j == postings->len && strstr (entry->haystack, needle) != NULL)
+        g_hash_table_insert (results, entry->config, entry->config);
+    }
+
+  g_ptr_array_free (postings, TRUE);
+  g_free (needle);
+
+  return results;
+}
+
+static void
+add_entry (SnippetsSearch *search,
+           Entry          *entry)
+{
+  SnippetsSearchPrivate *priv;
+  guint id;
+  guint i;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  id = priv->entries->len;
+  g_ptr_array_add (priv->entries, entry);
+  g_hash_table_insert (priv->configs, entry->config, GUINT_TO_POINTER (id));
+
+  get_trigrams (entry->haystack, priv->trigrams);
+
+  for (i = 0; i < priv->trigrams->len; i++)
+    {
+      GArray *posting;
+      guint32 trigram;
+
+      trigram = g_array_index (priv->trigrams, guint32, i);
+      posting = g_hash_table_lookup (priv->postings, GUINT_TO_POINTER (trigram));
+
+      if (posting == NULL)
+        {
+          posting = g_array_new (FALSE, FALSE, sizeof (guint));
+          g_hash_table_insert (priv->postings, GUINT_TO_POINTER (trigram), posting);
+        }
+
+      g_array_append_val (posting, id);
+    }
+}
+
+/*
+ * The entry stays in place with its config cleared, its ids are dropped
+ * from the posting lists the next time the index is compacted.
+ */
+static void
+kill_entry (SnippetsSearch *search,
+            SnippetsConfig *config)
+{
+  SnippetsSearchPrivate *priv;
+  Entry *entry;
+  gpointer id;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  if (!g_hash_table_lookup_extended (priv->configs, config, NULL, &id))
+    return;
+
+  g_hash_table_remove (priv->configs, config);
+
+  entry = g_ptr_array_index (priv->entries, GPOINTER_TO_UINT (id));
+  entry->config = NULL;
+  g_free (entry->haystack);
+  entry->haystack = NULL;
+
+  priv->n_dead++;
+}
+
+static void
+compact (SnippetsSearch *search)
+{
+  SnippetsSearchPrivate *priv;
+  GPtrArray *entries;
+  guint i;
+
+  priv = SNIPPETS_SEARCH_GET_PRIVATE (search);
+
+  if (priv->n_dead < COMPACT_MIN_DEAD || priv->n_dead * 2 < priv->entries->len)
+    return;
+
+  entries = priv->entries;
+
+  priv->entries = g_ptr_array_sized_new (entries->len - priv->n_dead);
+  priv->n_dead = 0;
+  g_hash_table_remove_all (priv->configs);
+  g_hash_table_remove_all (priv->postings);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      Entry *entry = g_ptr_array_index (entries, i);
+      if (entry->config != NULL)
+        add_entry (search, entry);
+      else
+        entry_free (entry);
+    }
+
+  g_ptr_array_free (entries, TRUE);
+}
+
+/*
+ * The name and trigger come first so that short queries can be limited
+ * to them, the newlines keep a match from running across two fields.
+ */
+static gchar*
+get_haystack (SnippetsConfig *config,
+              gsize          *head_length)
+{
+  const gchar *name;
+  const gchar *trigger;
+  const gchar *text;
+  GString *scratch;
+  gchar *joined;
+  gchar *head;
+  gchar *body;
+  gchar *haystack;
+
+  name = snippets_config_get_name (config);
+  trigger = snippets_config_get_trigger (config);
+  scratch = g_string_new (NULL);
+  text = snippets_config_get_text (config, scratch);
+
+  joined = g_strjoin ("\n", name != NULL ? name : "", 
+                      trigger != NULL ? trigger : "", NULL);
+  head = g_utf8_casefold (joined, -1);
+  body = g_utf8_casefold (text != NULL ? text : "", -1);
+  g_string_free (scratch, TRUE);
+
+  *head_length = strlen (head);
+  haystack = g_strjoin ("\n", head, body, NULL);
+
+  g_free (joined);
+  g_free (head);
+  g_free (body);
+
+  return haystack;
+}
+
+static void
+get_trigrams (const gchar *text,
+              GArray      *trigrams)
+{
+  gsize length;
+  gsize i;
+
+  g_array_set_size (trigrams, 0);
+
+  length = strlen (text);
+
+  for (i = 0; i + 2 < length; i++)
+    {
+      guint32 trigram;
+      trigram = ((guchar) text[i] << 16) | ((guchar) text[i + 1] << 8) | (guchar) text[i + 2];
+      g_array_append_val (trigrams, trigram);
+    }
+
+  if (trigrams->len > 1)
+    {
+      guint unique = 1;
+
+      g_array_sort (trigrams, compare_trigrams);
+
+      for (i = 1; i < trigrams->len; i++)
+        {
+          if (g_array_index (trigrams, guint32, i) != g_array_index (trigrams, guint32, unique - 1))
+            g_array_index (trigrams, guint32, unique++) = g_array_index (trigrams, guint32, i);
+        }
+
+      g_array_set_size (trigrams, unique);
+    }
+}
+
+static gint
+compare_trigrams (gconstpointer a,
+                  gconstpointer b)
+{
+  guint32 trigram_a = *(const guint32*) a;
+  guint32 trigram_b = *(const guint32*) b;
+  return trigram_a < trigram_b ? -1 : trigram_a > trigram_b;
+}
+
+static gint
+compare_postings (GArray **a,
+                  GArray **b)
+{
+  return (*a)->len < (*b)->len ? -1 : (*a)->len > (*b)->len;
+}
+
+static gboolean
+posting_contains (GArray *posting,
+                  guint   id)
+{
+  guint low = 0;
+  guint high = posting->len;
+
+  while (low < high)
+    {
+      guint middle = (low + high) / 2;
+      guint value = g_array_index (posting, guint, middle);
+      if (value == id)
+        return TRUE;
+      if (value < id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return FALSE;
+}
+
+static void
+entry_free (Entry *entry)
+{
+  g_free (entry->haystack);
+  g_slice_free (Entry, entry);
+}
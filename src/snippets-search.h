@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_SEARCH_H__
+#define	__SNIPPETS_SEARCH_H__
+
+#include <gtk/gtk.h>
+#include "snippets-config.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_SEARCH_TYPE            (snippets_search_get_type ())
+#define SNIPPETS_SEARCH(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_SEARCH_TYPE, SnippetsSearch))
+#define SNIPPETS_SEARCH_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_SEARCH_TYPE, SnippetsSearchClass))
+#define IS_SNIPPETS_SEARCH(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_SEARCH_TYPE))
+#define IS_SNIPPETS_SEARCH_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_SEARCH_TYPE))
+
+typedef struct _SnippetsSearch SnippetsSearch;
+typedef struct _SnippetsSearchClass SnippetsSearchClass;
+
+struct _SnippetsSearch
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsSearchClass
+{
+  GObjectClass parent_class;
+};
+
+GType snippets_search_get_type (void) G_GNUC_CONST;
+
+SnippetsSearch*  snippets_search_new     (void);
+
+void             snippets_search_add     (SnippetsSearch *search,
+                                          SnippetsConfig *config);
+void             snippets_search_remove  (SnippetsSearch *search,
+                                          SnippetsConfig *config);
+void             snippets_search_update  (SnippetsSearch *search,
+                                          SnippetsConfig *config);
+GHashTable*      snippets_search_find    (SnippetsSearch *search,
+                                          const gchar    *query);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_SEARCH_H__ */
@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <gdk/gdkkeysyms.h>
+#include "snippets-session.h"
+#include "snippets-template.h"
+#include "snippets-text.h"
+
+/*
+ * A session starts when a snippet with tab stops expands and lasts until
+ * the last tab stop is left behind. Tab and Shift+Tab move between the
+ * tab stops, and whatever is typed in one is copied to its mirrors. The
+ * user action opened for the expansion is only closed when the session
+ * ends, so the expansion and every edit made in it undo as one step.
+ */
+
+typedef struct
+{
+  gint         index;
+  gboolean     mirror;
+  GtkTextMark *start;
+  GtkTextMark *end;
+} TabStop;
+
+static void snippets_session_class_init  (SnippetsSessionClass *klass);
+static void snippets_session_init        (SnippetsSession      *session);
+static void snippets_session_finalize    (SnippetsSession      *session);
+
+static void select_tab_stop              (SnippetsSession      *session);
+static void move_tab_stop                (SnippetsSession      *session,
+                                          gint                  step);
+static TabStop* get_tab_stop             (SnippetsSession      *session);
+static gboolean in_tab_stop              (SnippetsSession      *session,
+                                          GtkTextIter          *iter);
+static void changed_action               (SnippetsSession      *session);
+static void mark_set_action              (SnippetsSession      *session,
+                                          GtkTextIter          *iter,
+                                          GtkTextMark          *mark);
+static gint compare_indexes              (gint                 *a,
+                                          gint                 *b);
+
+#define SNIPPETS_SESSION_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_SESSION_TYPE, SnippetsSessionPrivate))
+
+typedef struct _SnippetsSessionPrivate SnippetsSessionPrivate;
+
+struct _SnippetsSessionPrivate
+{
+  GtkTextBuffer *buffer;
+  GArray        *tab_stops;
+  GArray        *order;
+  guint          current;
+  gboolean       active;
+  gboolean       updating;
+  GString       *text;
+  GString       *mirror_text;
+  gulong         changed_id;
+  gulong         mark_set_id;
+  gulong         undo_id;
+  gulong         redo_id;
+};
+
+G_DEFINE_TYPE (SnippetsSession, snippets_session, G_TYPE_OBJECT)
+
+static void
+snippets_session_class_init (SnippetsSessionClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_session_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsSessionPrivate));
+}
+
+static void
+snippets_session_init (SnippetsSession *session)
+{
+  SnippetsSessionPrivate *priv;
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+  priv->tab_stops = g_array_new (FALSE, FALSE, sizeof (TabStop));
+  priv->order = g_array_new (FALSE, FALSE, sizeof (gint));
+  priv->current = 0;
+  priv->active = FALSE;
+  priv->updating = FALSE;
+  priv->text = g_string_new (NULL);
+  priv->mirror_text = g_string_new (NULL);
+}
+
+static void
+snippets_session_finalize (SnippetsSession *session)
+{
+  SnippetsSessionPrivate *priv;
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+  snippets_session_finish (session);
+  g_array_free (priv->tab_stops, TRUE);
+  g_array_free (priv->order, TRUE);
+  g_string_free (priv->text, TRUE);
+  g_string_free (priv->mirror_text, TRUE);
+  g_object_unref (priv->buffer);
+  G_OBJECT_CLASS (snippets_session_parent_class)->finalize (G_OBJECT (session));
+}
+
+/*
+ * The snippet was just put in the buffer at the offset, inside a user
+ * action that is still open. The session takes that user action over.
+ */
+SnippetsSession*
+snippets_session_new (GtkTextBuffer *buffer,
+                      gint           offset,
+                      GArray        *placeholders)
+{
+  SnippetsSessionPrivate *priv;
+  SnippetsSession *session;
+  gboolean has_end = FALSE;
+  guint i;
+
+  session = SNIPPETS_SESSION (g_object_new (snippets_session_get_type (), NULL));
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  priv->buffer = g_object_ref (buffer);
+  priv->active = TRUE;
+
+  for (i = 0; i < placeholders->len; i++)
+    {
+      SnippetsPlaceholder *placeholder;
+      TabStop tab_stop;
+      GtkTextIter start;
+      GtkTextIter end;
+      guint j;
+
+      placeholder = &g_array_index (placeholders, SnippetsPlaceholder, i);
+
+      gtk_text_buffer_get_iter_at_offset (buffer, &start, offset + placeholder->offset);
+      gtk_text_buffer_get_iter_at_offset (buffer, &end, offset + placeholder->offset + placeholder->length);
+
+      tab_stop.index = placeholder->index;
+      tab_stop.mirror = FALSE;
+      tab_stop.start = gtk_text_buffer_create_mark (buffer, NULL, &start, TRUE);
+      tab_stop.end = gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE);
+
+      /* the first tab stop with an index is the one typed in */
+      for (j = 0; j < priv->tab_stops->len; j++)
+        {
+          if (g_array_index (priv->tab_stops, TabStop, j).index == tab_stop.index)
+            tab_stop.mirror = TRUE;
+        }
+
+      g_array_append_val (priv->tab_stops, tab_stop);
+
+      if (tab_stop.mirror)
+        continue;
+
+      if (tab_stop.index == 0)
+        has_end = TRUE;
+      else
+        g_array_append_val (priv->order, tab_stop.index);
+    }
+
+  /* $0 is where we leave off, after all the others */
+  g_array_sort (priv->order, (GCompareFunc) compare_indexes);
+  if (has_end)
+    {
+      gint end_index = 0;
+      g_array_append_val (priv->order, end_index);
+    }
+
+  priv->changed_id = g_signal_connect_swapped (G_OBJECT (buffer), "changed",
+                                               G_CALLBACK (changed_action), session);
+  priv->mark_set_id = g_signal_connect_swapped (G_OBJECT (buffer), "mark-set",
+                                                G_CALLBACK (mark_set_action), session);
+
+  /* the undo manager has to see the user action end before it undoes */
+  priv->undo_id = g_signal_connect_swapped (G_OBJECT (buffer), "undo",
+                                            G_CALLBACK (snippets_session_finish), session);
+  priv->redo_id = g_signal_connect_swapped (G_OBJECT (buffer), "redo",
+                                            G_CALLBACK (snippets_session_finish), session);
+
+  select_tab_stop (session);
+
+  return session;
+}
+
+/*
+ * Tab and Shift+Tab belong to the session while it lasts. Escape, or a
+ * key pressed in some other buffer, ends it.
+ */
+gboolean
+snippets_session_key_press (SnippetsSession *session,
+                            GtkTextBuffer   *buffer,
+                            GdkEventKey     *event)
+{
+  SnippetsSessionPrivate *priv;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  if (!priv->active)
+    return FALSE;
+
+  if (buffer != priv->buffer)
+    {
+      snippets_session_finish (session);
+      return FALSE;
+    }
+
+  switch (event->keyval)
+    {
+    case GDK_KEY_Tab:
+      move_tab_stop (session, event->state & GDK_SHIFT_MASK ? -1 : 1);
+      return TRUE;
+    case GDK_KEY_ISO_Left_Tab:
+      move_tab_stop (session, -1);
+      return TRUE;
+    case GDK_KEY_Escape:
+      snippets_session_finish (session);
+      return FALSE;
+    }
+
+  return FALSE;
+}
+
+gboolean
+snippets_session_is_active (SnippetsSession *session)
+{
+  return SNIPPETS_SESSION_GET_PRIVATE (session)->active;
+}
+
+void
+snippets_session_finish (SnippetsSession *session)
+{
+  SnippetsSessionPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  if (!priv->active)
+    return;
+
+  priv->active = FALSE;
+
+  g_signal_handler_disconnect (priv->buffer, priv->changed_id);
+  g_signal_handler_disconnect (priv->buffer, priv->mark_set_id);
+  g_signal_handler_disconnect (priv->buffer, priv->undo_id);
+  g_signal_handler_disconnect (priv->buffer, priv->redo_id);
+
+  for (i = 0; i < priv->tab_stops->len; i++)
+    {
+      TabStop *tab_stop = &g_array_index (priv->tab_stops, TabStop, i);
+      gtk_text_buffer_delete_mark (priv->buffer, tab_stop->start);
+      gtk_text_buffer_delete_mark (priv->buffer, tab_stop->end);
+    }
+
+  g_array_set_size (priv->tab_stops, 0);
+
+  gtk_text_buffer_end_user_action (priv->buffer);
+}
+
+/*
+ * Select the current tab stop, or finish on $0 with the cursor there.
+ */
+static void
+select_tab_stop (SnippetsSession *session)
+{
+  SnippetsSessionPrivate *priv;
+  TabStop *tab_stop;
+  GtkTextIter start;
+  GtkTextIter end;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  tab_stop = get_tab_stop (session);
+  if (tab_stop == NULL)
+    {
+      snippets_session_finish (session);
+      return;
+    }
+
+  gtk_text_buffer_get_iter_at_mark (priv->buffer, &start, tab_stop->start);
+  gtk_text_buffer_get_iter_at_mark (priv->buffer, &end, tab_stop->end);
+
+  priv->updating = TRUE;
+
+  if (tab_stop->index == 0)
+    gtk_text_buffer_place_cursor (priv->buffer, &start);
+  else
+    gtk_text_buffer_select_range (priv->buffer, &end, &start);
+
+  priv->updating = FALSE;
+
+  if (tab_stop->index == 0)
+    snippets_session_finish (session);
+}
+
+/*
+ * Moving on from the last tab stop, when there is no $0, leaves the
+ * cursor at the end of it and ends the session.
+ */
+static void
+move_tab_stop (SnippetsSession *session,
+               gint             step)
+{
+  SnippetsSessionPrivate *priv;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  if (step < 0)
+    {
+      if (priv->current > 0)
+        priv->current--;
+      select_tab_stop (session);
+      return;
+    }
+
+  if (priv->current + 1 >= priv->order->len)
+    {
+      GtkTextIter iter;
+      gtk_text_buffer_get_iter_at_mark (priv->buffer, &iter, 
+                                        gtk_text_buffer_get_insert (priv->buffer));
+      gtk_text_buffer_place_cursor (priv->buffer, &iter);
+      snippets_session_finish (session);
+      return;
+    }
+
+  priv->current++;
+  select_tab_stop (session);
+}
+
+static TabStop*
+get_tab_stop (SnippetsSession *session)
+{
+  SnippetsSessionPrivate *priv;
+  gint index;
+  guint i;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  if (priv->current >= priv->order->len)
+    return NULL;
+
+  index = g_array_index (priv->order, gint, priv->current);
+
+  for (i = 0; i < priv->tab_stops->len; i++)
+    {
+      TabStop *tab_stop = &g_array_index (priv->tab_stops, TabStop, i);
+      if (tab_stop->index == index && !tab_stop->mirror)
+        return tab_stop;
+    }
+
+  return NULL;
+}
+
+static gboolean
+in_tab_stop (SnippetsSession *session,
+             GtkTextIter     *iter)
+{
+  SnippetsSessionPrivate *priv;
+  guint i;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  for (i = 0; i < priv->tab_stops->len; i++)
+    {
+      TabStop *tab_stop = &g_array_index (priv->tab_stops, TabStop, i);
+      GtkTextIter start;
+      GtkTextIter end;
+
+      gtk_text_buffer_get_iter_at_mark (priv->buffer, &start, tab_stop->start);
+      gtk_text_buffer_get_iter_at_mark (priv->buffer, &end, tab_stop->end);
+
+      if (gtk_text_iter_in_range (iter, &start, &end) || gtk_text_iter_equal (iter, &end))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Copy the current tab stop over its mirrors, those that already read
+ * the same are left alone. This runs on every keystroke in a tab stop,
+ * so the text is read into strings kept on the session.
+ */
+static void
+changed_action (SnippetsSession *session)
+{
+  SnippetsSessionPrivate *priv;
+  TabStop *current;
+  GtkTextIter start;
+  GtkTextIter end;
+  guint i;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  if (priv->updating)
+    return;
+
+  current = get_tab_stop (session);
+  if (current == NULL || current->index == 0)
+    return;
+
+  gtk_text_buffer_get_iter_at_mark (priv->buffer, &start, current->start);
+  gtk_text_buffer_get_iter_at_mark (priv->buffer, &end, current->end);
+  snippets_text_copy (&start, &end, priv->text);
+
+  priv->updating = TRUE;
+
+  for (i = 0; i < priv->tab_stops->len; i++)
+    {
+      TabStop *tab_stop = &g_array_index (priv->tab_stops, TabStop, i);
+
+      if (!tab_stop->mirror || tab_stop->index != current->index)
+        continue;
+
+      gtk_text_buffer_get_iter_at_mark (priv->buffer, &start, tab_stop->start);
+      gtk_text_buffer_get_iter_at_mark (priv->buffer, &end, tab_stop->end);
+      snippets_text_copy (&start, &end, priv->mirror_text);
+
+      if (!g_string_equal (priv->mirror_text, priv->text))
+        {
+          gtk_text_buffer_delete (priv->buffer, &start, &end);
+          gtk_text_buffer_insert (priv->buffer, &start, priv->text->str, priv->text->len);
+        }
+    }
+
+  priv->updating = FALSE;
+}
+
+/*
+ * Moving the cursor out of every tab stop ends the session.
+ */
+static void
+mark_set_action (SnippetsSession *session,
+                 GtkTextIter     *iter,
+                 GtkTextMark     *mark)
+{
+  SnippetsSessionPrivate *priv;
+
+  priv = SNIPPETS_SESSION_GET_PRIVATE (session);
+
+  if (priv->updating || mark != gtk_text_buffer_get_insert (priv->buffer))
+    return;
+
+  if (!in_tab_stop (session, iter))
+    snippets_session_finish (session);
+}
+
+static gint
+compare_indexes (gint *a,
+                 gint *b)
+{
+  return *a - *b;
+}
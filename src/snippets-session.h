@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __SNIPPETS_SESSION_H__
+#define	__SNIPPETS_SESSION_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_SESSION_TYPE            (snippets_session_get_type ())
+#define SNIPPETS_SESSION(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_SESSION_TYPE, SnippetsSession))
+#define SNIPPETS_SESSION_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_SESSION_TYPE, SnippetsSessionClass))
+#define IS_SNIPPETS_SESSION(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_SESSION_TYPE))
+#define IS_SNIPPETS_SESSION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_SESSION_TYPE))
+
+typedef struct _SnippetsSession SnippetsSession;
+typedef struct _SnippetsSessionClass SnippetsSessionClass;
+
+struct _SnippetsSession
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsSessionClass
+{
+  GObjectClass parent_class;
+};
+
+GType snippets_session_get_type (void) G_GNUC_CONST;
+
+SnippetsSession*  snippets_session_new        (GtkTextBuffer   *buffer,
+                                               gint             offset,
+                                               GArray          *placeholders);
+
+gboolean          snippets_session_key_press  (SnippetsSession *session,
+                                               GtkTextBuffer   *buffer,
+                                               GdkEventKey     *event);
+gboolean          snippets_session_is_active  (SnippetsSession *session);
+void              snippets_session_finish     (SnippetsSession *session);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_SESSION_H__ */
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-shell.h"
+
+/*
+ * The commands in a snippet run through /bin/sh in the folder of the
+ * document, while the snippet itself is already in the buffer. A mark
+ * holds the spot and the output goes there once the command is done. A
+ * command that takes too long is killed, and the output of the ones that
+ * may be cached is kept for as long as the editor runs.
+ */
+
+#define COMMAND_TIMEOUT 5
+
+typedef struct
+{
+  SnippetsShell *shell;
+  GtkTextBuffer *buffer;
+  GtkTextMark   *mark;
+  gchar         *command;
+  gboolean       cacheable;
+  GSubprocess   *process;
+  GCancellable  *cancellable;
+  guint          timeout_id;
+} Job;
+
+static void snippets_shell_class_init  (SnippetsShellClass *klass);
+static void snippets_shell_init        (SnippetsShell      *shell);
+static void snippets_shell_finalize    (SnippetsShell      *shell);
+
+static void communicate_action         (GSubprocess        *process,
+                                        GAsyncResult       *result,
+                                        Job                *job);
+static gboolean timeout_action         (Job                *job);
+static void job_free                   (Job                *job);
+
+#define SNIPPETS_SHELL_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_SHELL_TYPE, SnippetsShellPrivate))
+
+typedef struct _SnippetsShellPrivate SnippetsShellPrivate;
+
+struct _SnippetsShellPrivate
+{
+  GHashTable *cache;
+  GList      *jobs;
+};
+
+G_DEFINE_TYPE (SnippetsShell, snippets_shell, G_TYPE_OBJECT)
+
+static void
+snippets_shell_class_init (SnippetsShellClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_shell_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsShellPrivate));
+}
+
+static void
+snippets_shell_init (SnippetsShell *shell)
+{
+  SnippetsShellPrivate *priv;
+  priv = SNIPPETS_SHELL_GET_PRIVATE (shell);
+  priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  priv->jobs = NULL;
+}
+
+/*
+ * The jobs still running are let go of, they clean up after themselves
+ * once the cancelled command comes back.
+ */
+static void
+snippets_shell_finalize (SnippetsShell *shell)
+{
+  SnippetsShellPrivate *priv;
+  GList *list;
+
+  priv = SNIPPETS_SHELL_GET_PRIVATE (shell);
+
+  for (list = priv->jobs; list != NULL; list = g_list_next (list))
+    {
+      Job *job = list->data;
+      job->shell = NULL;
+      g_subprocess_force_exit (job->process);
+      g_cancellable_cancel (job->cancellable);
+    }
+
+  g_list_free (priv->jobs);
+  g_hash_table_destroy (priv->cache);
+
+  G_OBJECT_CLASS (snippets_shell_parent_class)->finalize (G_OBJECT (shell));
+}
+
+SnippetsShell*
+snippets_shell_new (void)
+{
+  return SNIPPETS_SHELL (g_object_new (snippets_shell_get_type (), NULL));
+}
+
+/*
+ * The output of the cacheable commands that already ran, by command.
+ */
+GHashTable*
+snippets_shell_get_cache (SnippetsShell *shell)
+{
+  return SNIPPETS_SHELL_GET_PRIVATE (shell)->cache;
+}
+
+void
+snippets_shell_run (SnippetsShell   *shell,
+                    GtkTextBuffer   *buffer,
+                    GtkTextIter     *iter,
+                    SnippetsCommand *command,
+                    const gchar     *file_path)
+{
+  SnippetsShellPrivate *priv;
+  GSubprocessLauncher *launcher;
+  GSubprocess *process;
+  GError *error = NULL;
+  Job *job;
+
+  priv = SNIPPETS_SHELL_GET_PRIVATE (shell);
+
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE | 
+                                        G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+
+  if (file_path != NULL)
+    {
+      gchar *folder_path = g_path_get_dirname (file_path);
+      g_subprocess_launcher_set_cwd (launcher, folder_path);
+      g_free (folder_path);
+    }
+
+  process = g_subprocess_launcher_spawn (launcher, &error, "/bin/sh", "-c", 
+                                         command->command, NULL);
+  g_object_unref (launcher);
+
+  if (process == NULL)
+    {
+      g_warning ("could not run snippet command %s: %s\n", command->command, error->message);
+      g_error_free (error);
+      return;
+    }
+
+  job = g_slice_new0 (Job);
+  job->shell = shell;
+  job->buffer = g_object_ref (buffer);
+  job->mark = g_object_ref (gtk_text_buffer_create_mark (buffer, NULL, iter, TRUE));
+  job->command = g_strdup (command->command);
+  job->cacheable = command->cacheable;
+  job->process = process;
+  job->cancellable = g_cancellable_new ();
+  job->timeout_id = g_timeout_add_seconds (COMMAND_TIMEOUT, (GSourceFunc) timeout_action, job);
+
+  priv->jobs = g_list_prepend (priv->jobs, job);
+
+  g_subprocess_communicate_utf8_async (process, NULL, job->cancellable,
+                                       (GAsyncReadyCallback) communicate_action, job);
+}
+
+static void
+communicate_action (GSubprocess  *process,
+                    GAsyncResult *result,
+                    Job          *job)
+{
+  GError *error = NULL;
+  gchar *output = NULL;
+
+  if (!g_subprocess_communicate_utf8_finish (process, result, &output, NULL, &error))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("could not read snippet command %s: %s\n", job->command, error->message);
+      g_error_free (error);
+    }
+  else if (job->shell != NULL && g_subprocess_get_successful (process) && output != NULL)
+    {
+      gsize length = strlen (output);
+
+      /* the output is meant to go in line, not to end one */
+      while (length > 0 && (output[length - 1] == '\n' || output[length - 1] == '\r'))
+        output[--length] = '\0';
+
+      if (job->cacheable)
+        {
+          SnippetsShellPrivate *priv;
+          priv = SNIPPETS_SHELL_GET_PRIVATE (job->shell);
+          g_hash_table_insert (priv->cache, g_strdup (job->command), g_strdup (output));
+        }
+
+      if (!gtk_text_mark_get_deleted (job->mark))
+        {
+          GtkTextIter iter;
+          gtk_text_buffer_get_iter_at_mark (job->buffer, &iter, job->mark);
+          gtk_text_buffer_begin_user_action (job->buffer);
+          gtk_text_buffer_insert (job->buffer, &iter, output, length);
+          gtk_text_buffer_end_user_action (job->buffer);
+        }
+    }
+
+  g_free (output);
+  job_free (job);
+}
+
+static gboolean
+timeout_action (Job *job)
+{
+  g_warning ("snippet command %s took too long\n", job->command);
+  job->timeout_id = 0;
+  g_subprocess_force_exit (job->process);
+  g_cancellable_cancel (job->cancellable);
+  return FALSE;
+}
+
+static void
+job_free (Job *job)
+{
+  if (job->timeout_id != 0)
+    g_source_remove (job->timeout_id);
+
+  if (job->shell != NULL)
+    {
+      SnippetsShellPrivate *priv;
+      priv = SNIPPETS_SHELL_GET_PRIVATE (job->shell);
+      priv->jobs = g_list_remove (priv->jobs, job);
+    }
+
+  if (!gtk_text_mark_get_deleted (job->mark))
+    gtk_text_buffer_delete_mark (job->buffer, job->mark);
+
+  g_object_unref (job->mark);
+  g_object_unref (job->buffer);
+  g_object_unref (job->process);
+  g_object_unref (job->cancellable);
+  g_free (job->command);
+  g_slice_free (Job, job);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __SNIPPETS_SHELL_H__
+#define	__SNIPPETS_SHELL_H__
+
+#include <gtk/gtk.h>
+#include "snippets-template.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_SHELL_TYPE            (snippets_shell_get_type ())
+#define SNIPPETS_SHELL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_SHELL_TYPE, SnippetsShell))
+#define SNIPPETS_SHELL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_SHELL_TYPE, SnippetsShellClass))
+#define IS_SNIPPETS_SHELL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_SHELL_TYPE))
+#define IS_SNIPPETS_SHELL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_SHELL_TYPE))
+
+typedef struct _SnippetsShell SnippetsShell;
+typedef struct _SnippetsShellClass SnippetsShellClass;
+
+struct _SnippetsShell
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsShellClass
+{
+  GObjectClass parent_class;
+};
+
+GType snippets_shell_get_type (void) G_GNUC_CONST;
+
+SnippetsShell*  snippets_shell_new        (void);
+
+GHashTable*     snippets_shell_get_cache  (SnippetsShell   *shell);
+void            snippets_shell_run        (SnippetsShell   *shell,
+                                           GtkTextBuffer   *buffer,
+                                           GtkTextIter     *iter,
+                                           SnippetsCommand *command,
+                                           const gchar     *file_path);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_SHELL_H__ */
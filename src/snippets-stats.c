@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-stats.h"
+
+/*
+ * Counts of what expanded and what did not, by snippet and by the file
+ * type of the document. Recording happens on every tab so it is no more
+ * than a lookup and a few atomic adds, the counters of a snippet live on
+ * the config itself. Nothing is saved, the numbers are only written out
+ * when asked for.
+ */
+
+static void snippets_stats_class_init  (SnippetsStatsClass *klass);
+static void snippets_stats_init        (SnippetsStats      *stats);
+static void snippets_stats_finalize    (SnippetsStats      *stats);
+
+static SnippetsCounters* get_file_type_counters (SnippetsStats    *stats,
+                                                 const gchar      *file_path);
+static const gchar* get_file_type      (const gchar        *file_path);
+static void append_row                 (GString            *output,
+                                        const gchar        *scope,
+                                        const gchar        *id,
+                                        const gchar        *file_types,
+                                        const gchar        *trigger,
+                                        const gchar        *name,
+                                        SnippetsCounters   *counters);
+static void append_field               (GString            *output,
+                                        const gchar        *field);
+
+#define SNIPPETS_STATS_GET_PRIVATE(obj) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), SNIPPETS_STATS_TYPE, SnippetsStatsPrivate))
+
+typedef struct _SnippetsStatsPrivate SnippetsStatsPrivate;
+
+struct _SnippetsStatsPrivate
+{
+  GHashTable *file_types;
+};
+
+G_DEFINE_TYPE (SnippetsStats, snippets_stats, G_TYPE_OBJECT)
+
+static void
+snippets_stats_class_init (SnippetsStatsClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = (GObjectFinalizeFunc) snippets_stats_finalize;
+  g_type_class_add_private (klass, sizeof (SnippetsStatsPrivate));
+}
+
+static void
+snippets_stats_init (SnippetsStats *stats)
+{
+  SnippetsStatsPrivate *priv;
+  priv = SNIPPETS_STATS_GET_PRIVATE (stats);
+  priv->file_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+snippets_stats_finalize (SnippetsStats *stats)
+{
+  SnippetsStatsPrivate *priv;
+  priv = SNIPPETS_STATS_GET_PRIVATE (stats);
+  g_hash_table_destroy (priv->file_types);
+  G_OBJECT_CLASS (snippets_stats_parent_class)->finalize (G_OBJECT (stats));
+}
+
+SnippetsStats*
+snippets_stats_new (void)
+{
+  return SNIPPETS_STATS (g_object_new (snippets_stats_get_type (), NULL));
+}
+
+void
+snippets_stats_record_expansion (SnippetsStats  *stats,
+                                 SnippetsConfig *config,
+                                 const gchar    *file_path,
+                                 gsize           inserted)
+{
+  SnippetsCounters *counters;
+
+  counters = snippets_config_get_counters (config);
+  g_atomic_int_inc (&counters->expansions);
+  g_atomic_pointer_add (&counters->inserted, inserted);
+
+  counters = get_file_type_counters (stats, file_path);
+  g_atomic_int_inc (&counters->expansions);
+  g_atomic_pointer_add (&counters->inserted, inserted);
+}
+
+/*
+ * A tab on a trigger that did not expand. With a config it counts for
+ * that snippet, without one for the file type.
+ */
+void
+snippets_stats_record_miss (SnippetsStats  *stats,
+                            SnippetsConfig *config,
+                            const gchar    *file_path)
+{
+  SnippetsCounters *counters;
+
+  if (config != NULL)
+    {
+      counters = snippets_config_get_counters (config);
+      g_atomic_int_inc (&counters->misses);
+      return;
+    }
+
+  counters = get_file_type_counters (stats, file_path);
+  g_atomic_int_inc (&counters->misses);
+}
+
+/*
+ * Written as CSV, a row per file type seen and then a row per snippet.
+ * A snippet row carries the id of the snippet, which stays the same from
+ * one export to the next. The average size is in bytes of text put in
+ * the document.
+ */
+gboolean
+snippets_stats_export (SnippetsStats  *stats,
+                       GList          *configs,
+                       const gchar    *file_path,
+                       GError        **error)
+{
+  SnippetsStatsPrivate *priv;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  GString *output;
+  gboolean result;
+
+  priv = SNIPPETS_STATS_GET_PRIVATE (stats);
+
+  output = g_string_new ("scope,id,file_types,trigger,name,expansions,misses,average_size\n");
+
+  g_hash_table_iter_init (&iter, priv->file_types);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    append_row (output, "file_type", NULL, key, NULL, NULL, value);
+
+  for (; configs != NULL; configs = g_list_next (configs))
+    {
+      SnippetsConfig *config = configs->data;
+      gchar id[17];
+
+      g_snprintf (id, sizeof (id), "%016" G_GINT64_MODIFIER "x", 
+                  snippets_config_get_id (config));
+      append_row (output, "snippet", id,
+                  snippets_config_get_file_types (config),
+                  snippets_config_get_trigger (config),
+                  snippets_config_get_name (config),
+                  snippets_config_get_counters (config));
+    }
+
+  result = g_file_set_contents (file_path, output->str, output->len, error);
+
+  g_string_free (output, TRUE);
+
+  return result;
+}
+
+/*
+ * How many large snippets are kept deflated in memory and the bytes that
+ * saves, as CSV of its own since it is about the library and not about
+ * any one snippet.
+ */
+gboolean
+snippets_stats_export_compression (const gchar  *file_path,
+                                   GError      **error)
+{
+  gchar *output;
+  gboolean result;
+  guint count;
+  gsize saved;
+
+  snippets_config_get_compression (&count, &saved);
+
+  output = g_strdup_printf ("deflated_snippets,bytes_saved\n%u,%" G_GSIZE_FORMAT "\n", 
+                            count, saved);
+  result = g_file_set_contents (file_path, output, -1, error);
+  g_free (output);
+
+  return result;
+}
+
+/*
+ * The key points into the file path, it is only copied the first time
+ * the file type comes up.
+ */
+static SnippetsCounters*
+get_file_type_counters (SnippetsStats *stats,
+                        const gchar   *file_path)
+{
+  SnippetsStatsPrivate *priv;
+  SnippetsCounters *counters;
+  const gchar *file_type;
+
+  priv = SNIPPETS_STATS_GET_PRIVATE (stats);
+
+  file_type = get_file_type (file_path);
+
+  counters = g_hash_table_lookup (priv->file_types, file_type);
+  if (counters == NULL)
+    {
+      counters = g_new0 (SnippetsCounters, 1);
+      g_hash_table_insert (priv->file_types, g_strdup (file_type), counters);
+    }
+
+  return counters;
+}
+
+/*
+ * The extension with its dot, or the whole name of files such as
+ * Makefile that have none.
+ */
+static const gchar*
+get_file_type (const gchar *file_path)
+{
+  const gchar *name;
+  const gchar *extension;
+
+  if (file_path == NULL)
+    return "";
+
+  name = strrchr (file_path, G_DIR_SEPARATOR);
+  name = name != NULL ? name + 1 : file_path;
+
+  extension = strrchr (name, '.');
+
+  return extension != NULL ? extension : name;
+}
+
+static void
+append_row (GString          *output,
+            const gchar      *scope,
+            const gchar      *id,
+            const gchar      *file_types,
+            const gchar      *trigger,
+            const gchar      *name,
+            SnippetsCounters *counters)
+{
+  gint expansions;
+  gsize inserted;
+
+  expansions = g_atomic_int_get (&counters->expansions);
+  inserted = GPOINTER_TO_SIZE (g_atomic_pointer_get (&counters->inserted));
+
+  append_field (output, scope);
+  g_string_append_c (output, ',');
+  append_field (output, id);
+  g_string_append_c (output, ',');
+  append_field (output, file_types);
+  g_string_append_c (output, ',');
+  append_field (output, trigger);
+  g_string_append_c (output, ',');
+  append_field (output, name);
+  g_string_append_printf (output, ",%d,%d,%" G_GSIZE_FORMAT "\n", expansions,
+                          g_atomic_int_get (&counters->misses),
+                          expansions > 0 ? inserted / expansions : 0);
+}
+
+static void
+append_field (GString     *output,
+              const gchar *field)
+{
+  if (field == NULL)
+    return;
+
+  if (strpbrk (field, ",\"\r\n") == NULL)
+    {
+      g_string_append (output, field);
+      return;
+    }
+
+  g_string_append_c (output, '"');
+  for (; *field != '\0'; field++)
+    {
+      if (*field == '"')
+        g_string_append_c (output, '"');
+      g_string_append_c (output, *field);
+    }
+  g_string_append_c (output, '"');
+}
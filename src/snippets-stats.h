@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_STATS_H__
+#define	__SNIPPETS_STATS_H__
+
+#include <gtk/gtk.h>
+#include "snippets-config.h"
+
+G_BEGIN_DECLS
+
+#define SNIPPETS_STATS_TYPE            (snippets_stats_get_type ())
+#define SNIPPETS_STATS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), SNIPPETS_STATS_TYPE, SnippetsStats))
+#define SNIPPETS_STATS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), SNIPPETS_STATS_TYPE, SnippetsStatsClass))
+#define IS_SNIPPETS_STATS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SNIPPETS_STATS_TYPE))
+#define IS_SNIPPETS_STATS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), SNIPPETS_STATS_TYPE))
+
+typedef struct _SnippetsStats SnippetsStats;
+typedef struct _SnippetsStatsClass SnippetsStatsClass;
+
+struct _SnippetsStats
+{
+  GObject parent_instance;
+};
+
+struct _SnippetsStatsClass
+{
+  GObjectClass parent_class;
+};
+
+GType snippets_stats_get_type (void) G_GNUC_CONST;
+
+SnippetsStats*  snippets_stats_new                 (void);
+
+void            snippets_stats_record_expansion    (SnippetsStats   *stats,
+                                                    SnippetsConfig  *config,
+                                                    const gchar     *file_path,
+                                                    gsize            inserted);
+void            snippets_stats_record_miss         (SnippetsStats   *stats,
+                                                    SnippetsConfig  *config,
+                                                    const gchar     *file_path);
+gboolean        snippets_stats_export              (SnippetsStats   *stats,
+                                                    GList           *configs,
+                                                    const gchar     *file_path,
+                                                    GError         **error);
+gboolean        snippets_stats_export_compression  (const gchar     *file_path,
+                                                    GError         **error);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_STATS_H__ */
@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "snippets-template.h"
+
+typedef struct
+{
+  SnippetsTemplateContext *context;
+  GString                 *output;
+  GArray                  *placeholders;
+} Renderer;
+
+static void render_text              (Renderer     *renderer,
+                                      const gchar **cursor,
+                                      gboolean      nested);
+static gboolean render_dollar        (Renderer     *renderer,
+                                      const gchar **cursor);
+static void render_tab_stop          (Renderer     *renderer,
+                                      gint          index);
+static gboolean render_variable      (Renderer     *renderer,
+                                      const gchar  *name,
+                                      gsize         length);
+static gboolean render_match         (Renderer     *renderer,
+                                      gint          index);
+static gboolean render_command       (Renderer     *renderer,
+                                      const gchar  *command,
+                                      gboolean      cacheable);
+static void add_placeholder          (Renderer     *renderer,
+                                      gint          index,
+                                      gsize         start);
+static gint parse_index              (const gchar **cursor);
+
+gchar*
+snippets_template_render (const gchar             *text,
+                          SnippetsTemplateContext *context,
+                          GArray                  *placeholders)
+{
+  GString *output;
+  output = g_string_sized_new (text != NULL ? strlen (text) : 0);
+  snippets_template_render_to (text, context, placeholders, output);
+  return g_string_free (output, FALSE);
+}
+
+/*
+ * Render into a buffer the caller keeps around, so that expanding over
+ * and over does not have to allocate once the buffer has grown.
+ */
+void
+snippets_template_render_to (const gchar             *text,
+                             SnippetsTemplateContext *context,
+                             GArray                  *placeholders,
+                             GString                 *output)
+{
+  Renderer renderer;
+  const gchar *cursor;
+  guint i;
+
+  g_string_truncate (output, 0);
+
+  renderer.context = context;
+  renderer.output = output;
+  renderer.placeholders = placeholders;
+
+  /* mirrored tab stops need the placeholders even if the caller does not */
+  if (placeholders == NULL)
+    renderer.placeholders = g_array_new (FALSE, FALSE, sizeof (SnippetsPlaceholder));
+  else
+    g_array_set_size (placeholders, 0);
+
+  cursor = text != NULL ? text : "";
+  render_text (&renderer, &cursor, FALSE);
+  
+  if (context != NULL && context->commands != NULL)
+    {
+      for (i = 0; i < context->commands->len; i++)
+        {
+          SnippetsCommand *command;
+          command = &g_array_index (context->commands, SnippetsCommand, i);
+          command->offset = g_utf8_pointer_to_offset (renderer.output->str, 
+                                                      renderer.output->str + command->offset);
+        }
+    }
+
+  if (placeholders == NULL)
+    {
+      g_array_free (renderer.placeholders, TRUE);
+      return;
+    }
+
+  /* the placeholders were laid out in bytes, the buffer counts characters */
+  for (i = 0; i < placeholders->len; i++)
+    {
+      SnippetsPlaceholder *placeholder;
+      const gchar *start;
+
+      placeholder = &g_array_index (placeholders, SnippetsPlaceholder, i);
+      start = renderer.output->str + placeholder->offset;
+      placeholder->length = g_utf8_pointer_to_offset (start, start + placeholder->length);
+      placeholder->offset = g_utf8_pointer_to_offset (renderer.output->str, start);
+    }
+}
+
+static void
+render_text (Renderer     *renderer,
+             const gchar **cursor,
+             gboolean      nested)
+{
+  while (**cursor != '\0')
+    {
+      const gchar *text = *cursor;
+
+      if (nested && *text == '}')
+        return;
+
+      if (*text == '\\' && (text[1] == '$' || (nested && text[1] == '}')))
+        {
+          g_string_append_c (renderer->output, text[1]);
+          *cursor += 2;
+          continue;
+        }
+
+      if (*text == '$' && render_dollar (renderer, cursor))
+        continue;
+
+      g_string_append_c (renderer->output, *text);
+      (*cursor)++;
+    }
+}
+
+/*
+ * Handles what follows a dollar sign, returning FALSE when it is not
+ * something we know so the dollar sign is copied like any other text.
+ */
+static gboolean
+render_dollar (Renderer     *renderer,
+               const gchar **cursor)
+{
+  const gchar *text = *cursor + 1;
+
+  if (g_ascii_isdigit (*text))
+    {
+      render_tab_stop (renderer, parse_index (&text));
+      *cursor = text;
+      return TRUE;
+    }
+
+  if (*text != '{')
+    return FALSE;
+
+  text++;
+
+  if (g_ascii_isdigit (*text))
+    {
+      gint index;
+      gsize start;
+
+      index = parse_index (&text);
+
+      if (*text == '}')
+        {
+          render_tab_stop (renderer, index);
+          *cursor = text + 1;
+          return TRUE;
+        }
+
+      if (*text != ':')
+        return FALSE;
+
+      text++;
+      start = renderer->output->len;
+      render_text (renderer, &text, TRUE);
+      add_placeholder (renderer, index, start);
+
+      *cursor = *text == '}' ? text + 1 : text;
+      return TRUE;
+    }
+  else
+    {
+      const gchar *name = text;
+
+      while (g_ascii_isalnum (*text) || *text == '_')
+        text++;
+        
+      if (*text == ':' && text - name == 5 && strncmp (name, "match", 5) == 0)
+        {
+          gint index;
+          
+          text++;
+          if (!g_ascii_isdigit (*text))
+            return FALSE;
+            
+          index = parse_index (&text);
+          if (*text != '}' || !render_match (renderer, index))
+            return FALSE;
+
+          *cursor = text + 1;
+          return TRUE;
+        }
+
+      if (*text == ':' && 
+          ((text - name == 5 && strncmp (name, "shell", 5) == 0) ||
+           (text - name == 10 && strncmp (name, "shell_once", 10) == 0)))
+        {
+          gboolean cacheable = text - name == 10;
+          gboolean rendered;
+          GString *command;
+          
+          command = g_string_new (NULL);
+          
+          for (text++; *text != '}' && *text != '\0'; text++)
+            {
+              if (text[0] == '\\' && text[1] == '}')
+                text++;
+              g_string_append_c (command, *text);
+            }
+          
+          rendered = *text == '}' && render_command (renderer, command->str, cacheable);
+          g_string_free (command, TRUE);
+          
+          if (!rendered)
+            return FALSE;
+
+          *cursor = text + 1;
+          return TRUE;
+        }
+
+      if (*text != '}' || text == name)
+        return FALSE;
+
+      if (!render_variable (renderer, name, text - name))
+        return FALSE;
+
+      *cursor = text + 1;
+      return TRUE;
+    }
+}
+
+/*
+ * A tab stop without a default mirrors the default given to the same
+ * number earlier on, if there was one.
+ */
+static void
+render_tab_stop (Renderer *renderer,
+                 gint      index)
+{
+  gsize start;
+  guint i;
+
+  start = renderer->output->len;
+
+  for (i = 0; i < renderer->placeholders->len; i++)
+    {
+      SnippetsPlaceholder *placeholder;
+      placeholder = &g_array_index (renderer->placeholders, SnippetsPlaceholder, i);
+      if (placeholder->index == index && placeholder->length > 0)
+        {
+          g_string_append_len (renderer->output, 
+                               renderer->output->str + placeholder->offset, 
+                               placeholder->length);
+          break;
+        }
+    }
+
+  add_placeholder (renderer, index, start);
+}
+
+static gboolean
+render_variable (Renderer    *renderer,
+                 const gchar *name,
+                 gsize        length)
+{
+  const gchar *file_path;
+  GDateTime *now;
+  gchar *value = NULL;
+
+  file_path = renderer->context != NULL ? renderer->context->file_path : NULL;
+
+  if (strncmp (name, "file_name", length) == 0 && length == 9)
+    {
+      value = file_path != NULL ? g_path_get_basename (file_path) : g_strdup ("");
+    }
+  else if (strncmp (name, "file_path", length) == 0 && length == 9)
+    {
+      value = g_strdup (file_path != NULL ? file_path : "");
+    }
+  else if (strncmp (name, "file_dir", length) == 0 && length == 8)
+    {
+      value = file_path != NULL ? g_path_get_dirname (file_path) : g_strdup ("");
+    }
+  else if (strncmp (name, "selection", length) == 0 && length == 9)
+    {
+      value = g_strdup (renderer->context != NULL && renderer->context->selection != NULL ? 
+                        renderer->context->selection : "");
+    }
+  else if (strncmp (name, "user", length) == 0 && length == 4)
+    {
+      value = g_strdup (g_get_user_name ());
+    }
+  else if ((strncmp (name, "date", length) == 0 && length == 4) ||
+           (strncmp (name, "time", length) == 0 && length == 4) ||
+           (strncmp (name, "year", length) == 0 && length == 4))
+    {
+      now = g_date_time_new_now_local ();
+      value = g_date_time_format (now, name[0] == 'd' ? "%Y-%m-%d" :
+                                       name[0] == 't' ? "%H:%M:%S" : "%Y");
+      g_date_time_unref (now);
+    }
+
+  if (value == NULL)
+    return FALSE;
+
+  g_string_append (renderer->output, value);
+  g_free (value);
+
+  return TRUE;
+}
+
+/*
+ * A group of the pattern that triggered the snippet, where a group past
+ * the last one is simply empty.
+ */
+static gboolean
+render_match (Renderer *renderer,
+              gint      index)
+{
+  gchar **matches;
+  gint i;
+
+  matches = renderer->context != NULL ? renderer->context->matches : NULL;
+  if (matches == NULL)
+    return FALSE;
+    
+  for (i = 0; i < index && matches[i] != NULL; i++);
+  
+  if (matches[i] != NULL)
+    g_string_append (renderer->output, matches[i]);
+
+  return TRUE;
+}
+
+/*
+ * A command is left for the caller to run where it stands in the text,
+ * unless it may be cached and already ran once. Without anywhere to put
+ * commands, as in a preview, the command text is shown as it is.
+ */
+static gboolean
+render_command (Renderer    *renderer,
+                const gchar *command,
+                gboolean     cacheable)
+{
+  SnippetsCommand pending;
+  SnippetsTemplateContext *context;
+  const gchar *value;
+
+  context = renderer->context;
+  if (context == NULL || context->commands == NULL)
+    return FALSE;
+    
+  if (cacheable && context->cache != NULL)
+    {
+      value = g_hash_table_lookup (context->cache, command);
+      if (value != NULL)
+        {
+          g_string_append (renderer->output, value);
+          return TRUE;
+        }
+    }
+    
+  pending.command = g_strdup (command);
+  pending.cacheable = cacheable;
+  pending.offset = renderer->output->len;
+  g_array_append_val (context->commands, pending);
+
+  return TRUE;
+}
+
+static void
+add_placeholder (Renderer *renderer,
+                 gint      index,
+                 gsize     start)
+{
+  SnippetsPlaceholder placeholder;
+
+  placeholder.index = index;
+  placeholder.offset = start;
+  placeholder.length = renderer->output->len - start;
+  g_array_append_val (renderer->placeholders, placeholder);
+}
+
+static gint
+parse_index (const gchar **cursor)
+{
+  gint index = 0;
+
+  while (g_ascii_isdigit (**cursor))
+    {
+      index = MIN (index * 10 + (**cursor - '0'), G_MAXINT / 10);
+      (*cursor)++;
+    }
+
+  return index;
+}
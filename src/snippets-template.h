@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SNIPPETS_TEMPLATE_H__
+#define	__SNIPPETS_TEMPLATE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Snippet text may hold tab stops written as $1 or ${1:default}, where $0
+ * marks the final cursor position, and variables such as ${file_name}.
+ * The groups of a pattern trigger are there as ${match:1} and so on.
+ * When a snippet is expanded over selected lines, ${selection} is the
+ * line it is being expanded for.
+ * Includes written as ${include:name} are already put in place by then.
+ * The output of a command, ${shell:command}, is filled in once it ran,
+ * and ${shell_once:command} only runs the command once per session.
+ * A dollar sign is kept as is with \$. Anything else that looks like a
+ * variable is left alone so shell and PHP snippets keep their own.
+ */
+
+typedef struct _SnippetsPlaceholder SnippetsPlaceholder;
+typedef struct _SnippetsCommand SnippetsCommand;
+typedef struct _SnippetsTemplateContext SnippetsTemplateContext;
+
+struct _SnippetsPlaceholder
+{
+  gint index;
+  gint offset;
+  gint length;
+};
+
+struct _SnippetsCommand
+{
+  gchar    *command;
+  gboolean  cacheable;
+  gint      offset;
+};
+
+struct _SnippetsTemplateContext
+{
+  const gchar *file_path;
+  gchar      **matches;
+  const gchar *selection;
+  GHashTable  *cache;
+  GArray      *commands;
+};
+
+gchar*  snippets_template_render     (const gchar             *text,
+                                      SnippetsTemplateContext *context,
+                                      GArray                  *placeholders);
+void    snippets_template_render_to  (const gchar             *text,
+                                      SnippetsTemplateContext *context,
+                                      GArray                  *placeholders,
+                                      GString                 *output);
+
+G_END_DECLS
+
+#endif /* __SNIPPETS_TEMPLATE_H__ */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010 - Jeff Johnston
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "snippets-text.h"
+
+/*
+ * Reading the buffer the way the hot paths need it, into strings the
+ * caller keeps so that nothing is allocated once they have grown.
+ */
+
+/*
+ * Replaces what the string held with the text between the iters, the
+ * pixbufs and child widgets left out.
+ */
+void
+snippets_text_copy (const GtkTextIter *start,
+                    const GtkTextIter *end,
+                    GString           *text)
+{
+  GtkTextIter iter;
+  
+  g_string_truncate (text, 0);
+  
+  for (iter = *start; gtk_text_iter_compare (&iter, end) < 0; gtk_text_iter_forward_char (&iter))
+    {
+      gunichar ctext;
+      ctext = gtk_text_iter_get_char (&iter);
+      if (ctext != GTK_TEXT_UNKNOWN_CHAR)
+        g_string_append_unichar (text, ctext);
+    }
+}
+
+/*
+ * Back to the start of the word the iter is at the end of, a word being
+ * letters, digits and underscores.
+ */
+void
+snippets_text_move_word_start (GtkTextIter *iter)
+{
+  GtkTextIter previous;
+  
+  previous = *iter;
+  
+  while (gtk_text_iter_backward_char (&previous))
+    {
+      gunichar ctext;
+      ctext = gtk_text_iter_get_char (&previous);
+      if (!g_ascii_isalnum (ctext) && ctext != '_')
+        break;
+      *iter = previous;
+    }
+}